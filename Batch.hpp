@@ -0,0 +1,93 @@
+#include <atomic>
+#include <thread>
+#include <vector>
+
+// Scoring many positions at once, for example to label training data.
+// The positions are in one contiguous array and the work is split between
+// threads, which take small chunks of it at a time so a few slow positions
+// don't hold up the others. Each position is scored either by the static
+// evaluation or by a fixed depth Search. Each thread has its own pawn table
+// and Search, and the evaluation cache is shared.
+
+	// positions taken by a thread at a time
+#define BATCH_CHUNK 64
+
+// fill _aScore with the score of each position for its side to move, in pawns.
+// _depth 0 means the static evaluation. _nThreads 0 uses every core.
+inline void evaluateBatch(const Position* _aPosition, int* _aScore, const int _nPositions,
+	const int _depth=0, int _nThreads=0)
+{
+	if ( _nThreads <= 0 )
+	{
+		_nThreads = std::thread::hardware_concurrency();
+		if ( _nThreads <= 0 )
+		{
+			_nThreads = 1;
+		}
+	}
+
+	std::atomic <int> nextChunk(0);
+
+	auto worker = [&]()
+	{
+		Search search;
+		while (true)
+		{
+			const int start = nextChunk.fetch_add(BATCH_CHUNK);
+			if ( start >= _nPositions )
+			{
+				return;
+			}
+			const int end = (start+BATCH_CHUNK < _nPositions) ? start+BATCH_CHUNK : _nPositions;
+
+			for (int i=start;i<end;++i)
+			{
+				Position position = _aPosition[i];
+				if ( _depth == 0 )
+				{
+					_aScore[i] = evaluate(position,position.sideToMove);
+				}
+				else
+				{
+					_aScore[i] = search.search(position,_depth);
+				}
+			}
+		}
+	};
+
+	if ( _nThreads == 1 )
+	{
+		worker();
+		return;
+	}
+
+	std::vector <std::thread> vThread;
+	for (int i=0;i<_nThreads;++i)
+	{
+		vThread.emplace_back(worker);
+	}
+	for (auto& thread : vThread)
+	{
+		thread.join();
+	}
+}
+
+// read positions from a file with one FEN per line. Lines which can't be
+// read are skipped. Returns the number of positions added.
+inline int loadFenFile(const std::string& _path, Vector <Position>& _vPosition)
+{
+	std::ifstream file(_path);
+	std::string line;
+	int nAdded = 0;
+
+	while (std::getline(file,line))
+	{
+		Position position;
+		if ( position.setFen(line) )
+		{
+			_vPosition.push(position);
+			++nAdded;
+		}
+	}
+	return nAdded;
+}
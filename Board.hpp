@@ -1,30 +1,25 @@
-#include <Math/Random/RandomLehmer.hpp>
-
 #include <time.h>
 
 // Board store potential substates
 // They should also store previous states for replay and also makes some
 // analysis easier
 
-// Note: getLegalMoves and boardState need serious optimisation. Using them
-// causes huge slowdown in midgame. Calculated values should be cached.
+// The game state itself is a Position, which is plain data. Board adds the
+// tree of substates and the scores used by the search on top of it.
 
 class Board
 {
 	Vector <Board*> vSubstates; // substates if current side moves
 	Vector <Board*> vSubstatesLegal; // same as above but illegal moves removed
-	Vector <Board*> vSubstates2; // substates if opponent moves again
-	Vector <Board*> vSubstatesLegal2; // same as above but illegal moves removed
 	
-	std::string transitionName;
 	int score; // score for this state
 	
 	Board* parent;
 	
 	public:
-	bool sideToMove;
+	Position position;
+	Move lastMove; // the move which led to this state from its parent
 	
-	Piece* aBoard [8][8];
 	char status; // should be calculated whenever a board is generated.
 	int id;
 	static int STATIC_ID;
@@ -32,22 +27,17 @@ class Board
 	
 	bool subsGenerated;
 	
+	GameHistory* history; // positions played before the root of the search
+	
+	// first layer of the neural network for this position, made when the
+	// network first evaluates it.
+	Nnue::Accumulator* accumulator;
+	
 	~Board()
 	{
-		// wipe the board array
-		for (int y=0;y<8;++y)
-		{ 
-			for (int x=0; x<8; ++x)
-			{
-				if ( aBoard[x][y] != 0 )
-				{
-					delete aBoard[x][y];
-				}
-				aBoard[x][y] = 0;
-			}
-		}
 		// recursively delete all substates
 		clearSubs();
+		delete accumulator;
 	}
 	
 	Board(bool _sideToMove = WHITE)
@@ -55,21 +45,17 @@ class Board
 		status=0;
 		score = -1;
 		
-		sideToMove=_sideToMove;
-		// wipe the board array
-		for (int y=0;y<8;++y)
-		{ 
-			for (int x=0; x<8; ++x)
-			{
-				aBoard[x][y] = 0;
-			}
-		}
-		transitionName="";
+		position.clear();
+		position.sideToMove=_sideToMove;
+		position.hash=position.computeHash();
 		
 		id=STATIC_ID++;
 		parent=0;
 		
 		subsGenerated=false;
+		
+		history=0;
+		accumulator=0;
 	}
 	Board(const Board& board) // copy constructor
 	//(this should actually be a shift to substate)
@@ -78,31 +64,18 @@ class Board
 	// but any substates generated.
 	{
 		status=board.status;
-		// I assume the default copy constructor copys the pointers in aBoard,
-		// but doesn't copy the Piece objects.
-		sideToMove=board.sideToMove;
+		score=board.score;
+		
+		// the position is plain data, so this is a straight copy
+		position=board.position;
+		lastMove=board.lastMove;
 		
 		parent=board.parent;
+		history=board.history;
 		
-		// wipe the board array
-		for (int y=0;y<8;++y)
-		{ 
-			for (int x=0; x<8; ++x)
-			{
-				if ( board.aBoard[x][y] != 0 )
-				{
-					// copy Piece
-					aBoard[x][y] = new Piece (*board.aBoard[x][y]);
-				}
-				else
-				{
-					aBoard[x][y] = 0;
-				}
-			}
-		}
+		// a substate's accumulator is built from ours when it's needed
+		accumulator=0;
 		
-		// recursively delete all substates
-		clearSubs();
 		subsGenerated=false;
 		
 		id=STATIC_ID++;
@@ -110,54 +83,34 @@ class Board
 	
 	// Equals operator: Identify identical board states for pruning?
 	// Assignment operator: Copy board state.
-	Board operator=( Board& board)
+	// Substates are not copied, the caller should clear them afterwards
+	// (the board being copied is often one of them).
+	Board& operator=(const Board& board)
 	{
 		status=board.status;
-		sideToMove=board.sideToMove;
-		parent=board.parent;
-		
-		// wipe the board array
-		for (int y=0;y<8;++y)
-		{ 
-			for (int x=0; x<8; ++x)
-			{
-				if ( board.aBoard[x][y] != 0 )
-				{
-					// copy Piece
-					aBoard[x][y] = new Piece (*board.aBoard[x][y]);
-				}
-				else
-				{
-					aBoard[x][y] = 0;
-				}
-			}
-		}
-		id=STATIC_ID++;
+		score=board.score;
+		position=board.position;
+		lastMove=board.lastMove;
 		
-		//vSubstates.clearPtr();
-		//vSubstates2.clearPtr();
+		// we become the state we are copying, and have no parent of our own.
+		// Keeping the parent would point a root state at itself.
+		parent=0;
+		history=board.history;
 		
-		if ( board.vSubstates.size() != 0)
-		{
-			vSubstates = board.vSubstates;
-			vSubstatesLegal = board.vSubstatesLegal;
-		}
-		if ( board.vSubstates2.size() != 0)
+		clearAccumulator();
+		if ( board.accumulator != 0 )
 		{
-			vSubstates2 = board.vSubstates2;
-			vSubstatesLegal2 = board.vSubstatesLegal2;
+			accumulator = new Nnue::Accumulator(*board.accumulator);
 		}
 		
-		// this seems to cause a crash if you are assigning a substate
-		// for now I'll call it after assignment finishes.
-		//clearSubs();
+		id=STATIC_ID++;
 		
-		return board;
+		return *this;
 	}
 
 	std::string getSideToMove()
 	{
-		if (sideToMove==WHITE)
+		if (position.sideToMove==WHITE)
 		{
 			return "WHITE";
 		}
@@ -165,1184 +118,160 @@ class Board
 	}
 
 	// move piece from (x1,y1) to (x2,y2). Return false if invalid move.
-	// if must be the piece's team's turn, and the move should be valid
-	// flipSideToMove needs to be false when moving pieces for castling
+	// it must be the piece's team's turn, and the move should be legal.
+	// Castling is requested by moving the king 2 spaces.
 	
 	// calling this is bad because it requires modifying substates.
 	// better to simply find the matching substate and move to it.
-	bool move (int x1, int y1, int x2, int y2, bool flipSideToMove=true)
+	bool move (int x1, int y1, int x2, int y2)
 	{
-		// assume any target piece is captured.
 		if ( isSafe(x1,y1) == false || isSafe(x2,y2) == false ||
-		aBoard[x1][y1] == 0 )
+		position.at(x1,y1) == 0 )
 		{
 			std::cout<<"There is no piece at "<<x1<<", "<<y1<<"\n";
 			return false;
 		}
 		
-		Piece* movePiece = aBoard[x1][y1];
-		
-		if ( movePiece->team != sideToMove )
-		{
-			//std::cout<<"Invalid move: Piece "<<movePiece->x<<", "<<movePiece->y<<" is not on the side to move.\n";
-			//return false;
-		}
-		
-		aBoard[x1][y1]=0;
-		if (aBoard[x2][y2] != 0 )
-		{
-			delete aBoard[x2][y2];
-		}
-		aBoard[x2][y2] = movePiece;
-		movePiece->x = x2;
-		movePiece->y = y2;
+		MoveList moves;
+		position.generateLegalMoves(moves);
 		
-		//promotion
-		if ( movePiece->getShortName() == WPAWN )
+		for (int i=0;i<moves.size();++i)
 		{
-			if (movePiece->y == 7)
+			if ( moves(i).from() == toSquare(x1,y1) && moves(i).to() == toSquare(x2,y2) )
 			{
-				movePiece->promote();
-			}
-		}
-		else if ( movePiece->getShortName() == BPAWN )
-		{
-			if (movePiece->y == 0)
-			{
-				movePiece->promote();
+				position.makeMove(moves(i));
+				lastMove=moves(i);
+				clearAccumulator();
+				
+				//substates must be cleared/merged
+				clearSubs();
+				status=0;
+				return true;
 			}
 		}
-		
-		// castling
-		// if player moves king 2-3 spaces, this is a request for castling.
-		
-		// en passant
-		
-		
-		movePiece->hasMoved=true;
-		
-		if (flipSideToMove)
-		{
-			sideToMove=!sideToMove;
+		std::cout<<"Invalid move: "<<x1<<", "<<y1<<" to "<<x2<<", "<<y2<<"\n";
+		return false;
+	}
 
-			// set all opponent pieces no longer vulnerable to en passant
-			Vector <Piece*> * vPiece = getAllPieces(!movePiece->team);
-			
-			if (vPiece!=0)
-			{
-				for (int i=0;i<vPiece->size();++i)
-				{
-					(*vPiece)(i)->doubleMoved=false;
-				}
-				delete vPiece;
-			}
-		}
-		
-		//substates must be cleared/merged
+	void reset()
+	{
+		position.reset();
+		lastMove=Move();
 		clearSubs();
+		clearAccumulator();
 		status=0;
-		
-		return true;
 	}
-
-	void reset()
+	
+	// count earlier occurrences of this position with the same side to
+	// move. We look back through the search path and then the game history,
+	// but not past the last capture or pawn move since the position can't
+	// repeat across them.
+	int countRepetitions()
 	{
-		sideToMove=WHITE;
+		const int halfmoveClock = position.halfmoveClock;
+		int count = 0;
+		int distance = 1;
 		
-		// wipe the board
-		for (int y=0;y<8;++y)
-		{ 
-			for (int x=0; x<8; ++x)
+		for (Board* previous = parent; previous != 0; previous = previous->parent)
+		{
+			if ( distance > halfmoveClock )
 			{
-				aBoard[x][y] = 0;
+				return count;
 			}
+			if ( distance%2 == 0 && previous->position.hash == position.hash )
+			{
+				++count;
+			}
+			++distance;
 		}
 		
-		for (int i=0;i<8;++i)
+		if ( history != 0 )
 		{
-			aBoard[i][1] = new Piece ("pawn", WPAWN, WHITE, i, 1, 1);
-			aBoard[i][6] = new Piece("pawn", BPAWN, BLACK, i, 6, 1);
-			
-			
-			//aBoard[i][1] = new Piece ("queen", WQUEEN, WHITE, i, 1, 1);
+			count += history->countMatches(position.hash,halfmoveClock,distance);
 		}
-		
-		aBoard[0][0] = new Piece ("rook", WROOK, WHITE, 0,0,5);
-		aBoard[7][0] = new Piece ("rook", WROOK, WHITE, 7,0,5);
-		aBoard[0][7] = new Piece ("rook", BROOK, BLACK, 0,7,5);
-		aBoard[7][7] = new Piece ("rook", BROOK, BLACK, 7,7,5);
-		
-		aBoard[1][0] = new Piece ("knight", WKNIGHT, WHITE, 1,0,3);
-		aBoard[6][0] = new Piece ("knight", WKNIGHT, WHITE, 6,0,3);
-		aBoard[1][7] = new Piece ("knight", BKNIGHT, BLACK, 1,7,3);
-		aBoard[6][7] = new Piece ("knight", BKNIGHT, BLACK, 6,7,3);
-		
-		aBoard[2][0] = new Piece ("bishop", WBISHOP, WHITE, 2,0,3);
-		aBoard[5][0] = new Piece ("bishop", WBISHOP, WHITE, 5,0,3);
-		aBoard[2][7] = new Piece ("bishop", BBISHOP, BLACK, 2,7,3);
-		aBoard[5][7] = new Piece ("bishop", BBISHOP, BLACK, 5,7,3);
-		
-		aBoard[3][0] = new Piece ("queen", WQUEEN, WHITE, 3,0,9);
-		aBoard[4][0] = new Piece ("king", WKING, WHITE, 4,0,1000);
-		aBoard[3][7] = new Piece ("queen", BQUEEN, BLACK, 3,7,9);
-		aBoard[4][7] = new Piece ("king", BKING, BLACK, 4,7,1000);
+		return count;
 	}
 	
-	// only return all moves for this piece, in the form of state vector
-	Vector <Board*>* getAllMovesFrom(Piece* piece)
+	bool isThreefoldRepetition()
 	{
-		Vector <Board*>* vBoard = new Vector <Board*>;
-		
-		addAllMovesFrom(piece, vBoard);
-			
-		if (vBoard->size() == 0)
-		{
-			delete vBoard;
-			return 0;
-		}
-		
-		return vBoard;
+		return (countRepetitions() >= 2);
 	}
 	
-	// returns true if the board array is not 0.
-	Piece* hasPieceOn(const short int _x, const short int _y)
+	bool isFiftyMoveDraw()
 	{
-		return aBoard[_x][_y];
-	}
-	// returns true if the board array is not 0.
-	Piece* hasPieceOn(const short int _x, const short int _y, const bool _team)
-	{
-		if ( aBoard[_x][_y]==0 || aBoard[_x][_y]->team != _team)
-		{
-			return 0;
-		}
-		
-		return (aBoard[_x][_y]);
+		return (position.halfmoveClock >= FIFTY_MOVE_PLIES);
 	}
 	
-	bool hasPiece(bool _team, unsigned char _piece, short int _amount=1)
+	// Inside a search a single repetition is treated as a draw, as the side
+	// which could avoid it would have done so earlier.
+	bool isDrawByRule()
 	{
-		auto vPiece = getAllPieces(_team);
-		
-		int count = 0;
-		
-		for (int i=0;i<vPiece->size();++i)
-		{
-			if ( (*vPiece)(i)->getShortName() == _piece )
-			{
-				++count;
-			}
-			if ( count == _amount )
-			{
-				return true;
-			}
-		}
-		
-		return false;
+		return (isFiftyMoveDraw() || countRepetitions() >= 1);
 	}
 	
-	// return true if the team can send a piece to this tile.
-	// for now we do this by generating sub boards and just looking to
-	// see if a substate has a piece there
-	Piece* canAttack(const short int _x, const short int _y, bool _team)
+	// make a substate the current state of the game. The position we leave
+	// is added to the game history.
+	void playSubstate(Board* _substate)
 	{
-		generateSubs();
-
-		for (int i=0;i<vSubstates.size();++i)
+		if ( history != 0 )
 		{
-			if ( vSubstates(i)->hasPieceOn(_x,_y,_team) )
-			{
-				return vSubstates(i)->hasPieceOn(_x,_y,_team);
-			}
+			history->push(position.hash);
 		}
-
-		for (int i=0;i<vSubstates2.size();++i)
-		{
-			if (vSubstates2(i)->hasPieceOn(_x,_y,_team))
-			{
-				return vSubstates2(i)->hasPieceOn(_x,_y,_team);
-			}
-		}
-			
-		return 0;
+		*this = *_substate;
+		clearSubs();
 	}
 	
-	
-	// only return all moves for this piece, in the form of state vector
-	void addAllMovesFrom(Piece* piece, Vector <Board*> * vBoard)
+	// play a move chosen somewhere else, such as by a Search. Returns false
+	// if it isn't legal here.
+	bool playMove(const Move& _move)
 	{
-		if (piece==0 || isSafe(piece->x,piece->y)==false || vBoard==0)
-		{
-			std::cout<<"addallmoves error\n";
-			return;
-		}
-	
-		// white pawn, can move up 1 space, attack diagonally.
-		if (piece->getShortName() == 244)
-		{
-			// can it move up 1 space?
-			if (isSafe(piece->x,piece->y+1))
-			{
-				if ( aBoard[piece->x][piece->y+1] == 0 )
-				{
-					// piece can move up 1 space. Make state for this.
-					Board* subBoard = new Board(*this);
-					subBoard->move(piece->x,piece->y,piece->x,piece->y+1);
-					vBoard->push(subBoard);
-					
-					// can it move up 2 spaces?
-					if (piece->y==1 && isSafe(piece->x,piece->y+2))
-					{
-						if ( aBoard[piece->x][piece->y+2] == 0 )
-						{
-							// piece can move up 1 space. Make state for this.
-							Board* subBoard2 = new Board(*this);
-							subBoard2->move(piece->x,piece->y,piece->x,piece->y+2);
-							piece->doubleMoved=true;
-							vBoard->push(subBoard2);
-						}
-					}
-				}
-			}
-
-			// can it attack diagonally left?
-			if (isSafe(piece->x-1,piece->y+1))
-			{
-				if ( aBoard[piece->x-1][piece->y+1] != 0 && aBoard[piece->x-1][piece->y+1]->team != piece->team )
-				{
-					// piece can move up 1 space. Make state for this.
-					Board* subBoard = new Board(*this);
-					subBoard->move(piece->x,piece->y,piece->x-1,piece->y+1);
-					subBoard->transitionName="Pawn capture";
-					vBoard->push(subBoard);
-				}
-			}
-			// can it attack diagonally right?
-			if (isSafe(piece->x+1,piece->y+1))
-			{
-				if ( aBoard[piece->x+1][piece->y+1] != 0 && aBoard[piece->x+1][piece->y+1]->team != piece->team )
-				{
-					// piece can move up 1 space. Make state for this.
-					Board* subBoard = new Board(*this);
-					subBoard->move(piece->x,piece->y,piece->x+1,piece->y+1);
-					subBoard->transitionName="Pawn capture";
-					vBoard->push(subBoard);
-				}
-			}
-			
-			// can it attack en passant?
-			// normally we can assume the en passant attack square is empty
-			// but in this case we will check
-			// en passant left
-			if (isSafe(piece->x-1,piece->y) && isSafe(piece->x-1,piece->y+1))
-			{
-				if ( aBoard[piece->x-1][piece->y] != 0 && aBoard[piece->x-1][piece->y]->team != piece->team &&
-				aBoard[piece->x-1][piece->y]->doubleMoved
-				&& aBoard[piece->x-1][piece->y+1]==0 )
-				{
-					// piece can move up 1 space. Make state for this.
-					Board* subBoard = new Board(*this);
-					subBoard->move(piece->x,piece->y,piece->x-1,piece->y+1);
-					subBoard->aBoard[piece->x-1][piece->y] = 0;
-					subBoard->transitionName="Pawn capture";
-					vBoard->push(subBoard);
-				}
-			}
-			// en passant right
-			if (isSafe(piece->x+1,piece->y) && isSafe(piece->x+1,piece->y+1))
-			{
-				if ( aBoard[piece->x+1][piece->y] != 0 && aBoard[piece->x+1][piece->y]->team != piece->team &&
-				aBoard[piece->x+1][piece->y]->doubleMoved
-				&& aBoard[piece->x+1][piece->y+1]==0 )
-				{
-					// piece can move up 1 space. Make state for this.
-					Board* subBoard = new Board(*this);
-					subBoard->move(piece->x,piece->y,piece->x+1,piece->y+1);
-					subBoard->aBoard[piece->x+1][piece->y] = 0;
-					subBoard->transitionName="Pawn capture";
-					vBoard->push(subBoard);
-				}
-			}
-		}
-		// black pawn, can move down 1 space, attack diagonally.
-		else if (piece->getShortName() == 245)
-		{
-			// can it move down 1 space?
-			if (isSafe(piece->x,piece->y-1))
-			{
-				if ( aBoard[piece->x][piece->y-1] == 0 )
-				{
-					// piece can move down 1 space. Make state for this.
-					Board* subBoard = new Board(*this);
-					subBoard->move(piece->x,piece->y,piece->x,piece->y-1);
-					vBoard->push(subBoard);
-					
-					// can it move down 2 spaces?
-					if (piece->y==6 && isSafe(piece->x,piece->y-2))
-					{
-						if ( aBoard[piece->x][piece->y-2] == 0 )
-						{
-							// piece can move up 1 space. Make state for this.
-							Board* subBoard2 = new Board(*this);
-							subBoard2->move(piece->x,piece->y,piece->x,piece->y-2);
-							piece->doubleMoved=true;
-							vBoard->push(subBoard2);
-						}
-					}
-				}
-			}
-
-			
-			// can it attack diagonally left?
-			if (isSafe(piece->x-1,piece->y-1))
-			{
-				if ( aBoard[piece->x-1][piece->y-1] != 0 && aBoard[piece->x-1][piece->y-1]->team != piece->team )
-				{
-					// piece can move up 1 space. Make state for this.
-					Board* subBoard = new Board(*this);
-					subBoard->move(piece->x,piece->y,piece->x-1,piece->y-1);
-					vBoard->push(subBoard);
-				}
-			}
-			// can it attack diagonally right?
-			if (isSafe(piece->x+1,piece->y-1))
-			{
-				if ( aBoard[piece->x+1][piece->y-1] != 0 && aBoard[piece->x+1][piece->y-1]->team != piece->team )
-				{
-					// piece can move up 1 space. Make state for this.
-					Board* subBoard = new Board(*this);
-					subBoard->move(piece->x,piece->y,piece->x+1,piece->y-1);
-					vBoard->push(subBoard);
-				}
-			}
-			// can it attack en passant?
-			// normally we can assume the en passant attack square is empty
-			// but in this case we will check
-			// en passant left
-			if (isSafe(piece->x-1,piece->y) && isSafe(piece->x-1,piece->y-1))
-			{
-				if ( aBoard[piece->x-1][piece->y] != 0 && aBoard[piece->x-1][piece->y]->team != piece->team &&
-				aBoard[piece->x-1][piece->y]->doubleMoved
-				&& aBoard[piece->x-1][piece->y-1]==0 )
-				{
-					// piece can move up 1 space. Make state for this.
-					Board* subBoard = new Board(*this);
-					subBoard->move(piece->x,piece->y,piece->x-1,piece->y-1);
-					subBoard->aBoard[piece->x-1][piece->y] = 0;
-					subBoard->transitionName="Pawn capture";
-					vBoard->push(subBoard);
-				}
-			}
-			// en passant right
-			if (isSafe(piece->x+1,piece->y) && isSafe(piece->x+1,piece->y-1))
-			{
-				if ( aBoard[piece->x+1][piece->y] != 0 && aBoard[piece->x+1][piece->y]->team != piece->team &&
-				aBoard[piece->x+1][piece->y]->doubleMoved
-				&& aBoard[piece->x+1][piece->y-1]==0 )
-				{
-					// piece can move up 1 space. Make state for this.
-					Board* subBoard = new Board(*this);
-					subBoard->move(piece->x,piece->y,piece->x+1,piece->y-1);
-					subBoard->aBoard[piece->x+1][piece->y] = 0;
-					subBoard->transitionName="Pawn capture";
-					vBoard->push(subBoard);
-				}
-			}
-		}
-		// knight, moves in L shape
-		else if (piece->getShortName() == 'n' || piece->getShortName() == 'N')
-		{
-			// left
-			if (isSafe(piece->x-2,piece->y+1))
-			{
-				if ( aBoard[piece->x-2][piece->y+1] == 0 || aBoard[piece->x-2][piece->y+1]->team != piece->team )
-				{
-					// piece can move up 1 space. Make state for this.
-					Board* subBoard = new Board(*this);
-					subBoard->move(piece->x,piece->y,piece->x-2,piece->y+1);
-					vBoard->push(subBoard);
-				}
-			}
-			if (isSafe(piece->x-2,piece->y-1))
-			{
-				if ( aBoard[piece->x-2][piece->y-1] == 0 || aBoard[piece->x-2][piece->y-1]->team != piece->team )
-				{
-					// piece can move up 1 space. Make state for this.
-					Board* subBoard = new Board(*this);
-					subBoard->move(piece->x,piece->y,piece->x-2,piece->y-1);
-					vBoard->push(subBoard);
-				}
-			}
-			// right
-			if (isSafe(piece->x+2,piece->y+1))
-			{
-				if ( aBoard[piece->x+2][piece->y+1] == 0 || aBoard[piece->x+2][piece->y+1]->team != piece->team )
-				{
-					// piece can move up 1 space. Make state for this.
-					Board* subBoard = new Board(*this);
-					subBoard->move(piece->x,piece->y,piece->x+2,piece->y+1);
-					vBoard->push(subBoard);
-				}
-			}
-			if (isSafe(piece->x+2,piece->y-1))
-			{
-				if ( aBoard[piece->x+2][piece->y-1] == 0 || aBoard[piece->x+2][piece->y-1]->team != piece->team )
-				{
-					// piece can move up 1 space. Make state for this.
-					Board* subBoard = new Board(*this);
-					subBoard->move(piece->x,piece->y,piece->x+2,piece->y-1);
-					vBoard->push(subBoard);
-				}
-			}
-			// up
-			if (isSafe(piece->x+1,piece->y+2))
-			{
-				if ( aBoard[piece->x+1][piece->y+2] == 0 || aBoard[piece->x+1][piece->y+2]->team != piece->team )
-				{
-					// piece can move up 1 space. Make state for this.
-					Board* subBoard = new Board(*this);
-					subBoard->move(piece->x,piece->y,piece->x+1,piece->y+2);
-					vBoard->push(subBoard);
-				}
-			}
-			if (isSafe(piece->x-1,piece->y+2))
-			{
-				if ( aBoard[piece->x-1][piece->y+2] == 0 || aBoard[piece->x-1][piece->y+2]->team != piece->team )
-				{
-					// piece can move up 1 space. Make state for this.
-					Board* subBoard = new Board(*this);
-					subBoard->move(piece->x,piece->y,piece->x-1,piece->y+2);
-					vBoard->push(subBoard);
-				}
-			}
-			// down
-			if (isSafe(piece->x+1,piece->y-2))
-			{
-				if ( aBoard[piece->x+1][piece->y-2] == 0 || aBoard[piece->x+1][piece->y-2]->team != piece->team )
-				{
-					// piece can move up 1 space. Make state for this.
-					Board* subBoard = new Board(*this);
-					subBoard->move(piece->x,piece->y,piece->x+1,piece->y-2);
-					vBoard->push(subBoard);
-				}
-			}
-			if (isSafe(piece->x-1,piece->y-2))
-			{
-				if ( aBoard[piece->x-1][piece->y-2] == 0 || aBoard[piece->x-1][piece->y-2]->team != piece->team )
-				{
-					// piece can move up 1 space. Make state for this.
-					Board* subBoard = new Board(*this);
-					subBoard->move(piece->x,piece->y,piece->x-1,piece->y-2);
-					vBoard->push(subBoard);
-				}
-			}
-			
-		}
-		
-		// rook, moves in straight line
-		else if (piece->getShortName() == 'r' || piece->getShortName() == 'R')
-		{
-			// down
-			for (int file = piece->y-1; file >=0; --file)
-			{
-				if ( aBoard[piece->x][file] == 0 )
-				{
-					// rook can move here and further
-					Board* subBoard = new Board(*this);
-					subBoard->move(piece->x,piece->y,piece->x,file);
-					vBoard->push(subBoard);
-				}
-				else if (aBoard[piece->x][file]->team != piece->team)
-				{
-					// enemy piece here, can move here but no further
-					Board* subBoard = new Board(*this);
-					subBoard->move(piece->x,piece->y,piece->x,file);
-					vBoard->push(subBoard);
-					break;
-				}
-				else
-				{
-					// cannot move here
-					break;
-				}
-			}
-			// up
-			for (int file = piece->y+1; file<8; ++file)
-			{
-				if ( aBoard[piece->x][file] == 0 )
-				{
-					// rook can move here and further
-					Board* subBoard = new Board(*this);
-					subBoard->move(piece->x,piece->y,piece->x,file);
-					vBoard->push(subBoard);
-				}
-				else if (aBoard[piece->x][file]->team != piece->team)
-				{
-					// enemy piece here, can move here but no further
-					Board* subBoard = new Board(*this);
-					subBoard->move(piece->x,piece->y,piece->x,file);
-					vBoard->push(subBoard);
-					break;
-				}
-				else
-				{
-					// cannot move here
-					break;
-				}
-			}
-			// left
-			for (int rank = piece->x-1; rank >=0; --rank)
-			{
-				if ( aBoard[rank][piece->y] == 0 )
-				{
-					// rook can move here and further
-					Board* subBoard = new Board(*this);
-					subBoard->move(piece->x,piece->y,rank,piece->y);
-					vBoard->push(subBoard);
-				}
-				else if (aBoard[rank][piece->y]->team != piece->team)
-				{
-					// enemy piece here, can move here but no further
-					Board* subBoard = new Board(*this);
-					subBoard->move(piece->x,piece->y,rank,piece->y);
-					vBoard->push(subBoard);
-					break;
-				}
-				else
-				{
-					// cannot move here
-					break;
-				}
-			}
-			// right
-			for (int rank = piece->x+1; rank <8; ++rank)
-			{
-				if ( aBoard[rank][piece->y] == 0 )
-				{
-					// rook can move here and further
-					Board* subBoard = new Board(*this);
-					subBoard->move(piece->x,piece->y,rank,piece->y);
-					vBoard->push(subBoard);
-				}
-				else if (aBoard[rank][piece->y]->team != piece->team)
-				{
-					// enemy piece here, can move here but no further
-					Board* subBoard = new Board(*this);
-					subBoard->move(piece->x,piece->y,rank,piece->y);
-					vBoard->push(subBoard);
-					break;
-				}
-				else
-				{
-					// cannot move here
-					break;
-				}
-			}
-		}
-		
-		// bishop, moves in diagonals
-		else if (piece->getShortName() == 'B' || piece->getShortName() == 'b')
+		if ( _move.isNull() || (position.findMove(_move.from(),_move.to()) == _move) == false )
 		{
-			// down-left
-			int file = piece->y-1;
-			int rank = piece->x-1;
-			
-			while (file>=0 && rank >= 0)
-			{
-				if ( aBoard[rank][file] == 0 )
-				{
-					// rook can move here and further
-					Board* subBoard = new Board(*this);
-					subBoard->move(piece->x,piece->y,rank,file);
-					vBoard->push(subBoard);
-				}
-				else if (aBoard[rank][file]->team != piece->team)
-				{
-					// enemy piece here, can move here but no further
-					Board* subBoard = new Board(*this);
-					subBoard->move(piece->x,piece->y,rank,file);
-					vBoard->push(subBoard);
-					break;
-				}
-				else
-				{
-					// cannot move here
-					break;
-				}
-				--file;
-				--rank;
-			}
-			// down-right
-			file = piece->y-1;
-			rank = piece->x+1;
-			
-			while (file>=0 && rank <8)
-			{
-				if ( aBoard[rank][file] == 0 )
-				{
-					// rook can move here and further
-					Board* subBoard = new Board(*this);
-					subBoard->move(piece->x,piece->y,rank,file);
-					vBoard->push(subBoard);
-				}
-				else if (aBoard[rank][file]->team != piece->team)
-				{
-					// enemy piece here, can move here but no further
-					Board* subBoard = new Board(*this);
-					subBoard->move(piece->x,piece->y,rank,file);
-					vBoard->push(subBoard);
-					break;
-				}
-				else
-				{
-					// cannot move here
-					break;
-				}
-				--file;
-				++rank;
-			}
-			// up-left
-			file = piece->y+1;
-			rank = piece->x-1;
-			
-			while (file<8 && rank>=0)
-			{
-				if ( aBoard[rank][file] == 0 )
-				{
-					// rook can move here and further
-					Board* subBoard = new Board(*this);
-					subBoard->move(piece->x,piece->y,rank,file);
-					vBoard->push(subBoard);
-				}
-				else if (aBoard[rank][file]->team != piece->team)
-				{
-					// enemy piece here, can move here but no further
-					Board* subBoard = new Board(*this);
-					subBoard->move(piece->x,piece->y,rank,file);
-					vBoard->push(subBoard);
-					break;
-				}
-				else
-				{
-					// cannot move here
-					break;
-				}
-				++file;
-				--rank;
-			}
-			// up-right
-			file = piece->y+1;
-			rank = piece->x+1;
-			
-			while (file<8 && rank<8)
-			{
-				if ( aBoard[rank][file] == 0 )
-				{
-					// rook can move here and further
-					Board* subBoard = new Board(*this);
-					subBoard->move(piece->x,piece->y,rank,file);
-					vBoard->push(subBoard);
-				}
-				else if (aBoard[rank][file]->team != piece->team)
-				{
-					// enemy piece here, can move here but no further
-					Board* subBoard = new Board(*this);
-					subBoard->move(piece->x,piece->y,rank,file);
-					vBoard->push(subBoard);
-					break;
-				}
-				else
-				{
-					// cannot move here
-					break;
-				}
-				++file;
-				++rank;
-			}
-		}
-		
-		// queen, moves in diagonals and straight lines
-		else if (piece->getShortName() == 'Q' || piece->getShortName() == 'q')
-		{
-			// down-left
-			int file = piece->y-1;
-			int rank = piece->x-1;
-			
-			while (file>=0 && rank >= 0)
-			{
-				if ( aBoard[rank][file] == 0 )
-				{
-					// rook can move here and further
-					Board* subBoard = new Board(*this);
-					subBoard->move(piece->x,piece->y,rank,file);
-					vBoard->push(subBoard);
-				}
-				else if (aBoard[rank][file]->team != piece->team)
-				{
-					// enemy piece here, can move here but no further
-					Board* subBoard = new Board(*this);
-					subBoard->move(piece->x,piece->y,rank,file);
-					vBoard->push(subBoard);
-					break;
-				}
-				else
-				{
-					// cannot move here
-					break;
-				}
-				--file;
-				--rank;
-			}
-			// down-right
-			file = piece->y-1;
-			rank = piece->x+1;
-			
-			while (file>=0 && rank <8)
-			{
-				if ( aBoard[rank][file] == 0 )
-				{
-					// rook can move here and further
-					Board* subBoard = new Board(*this);
-					subBoard->move(piece->x,piece->y,rank,file);
-					vBoard->push(subBoard);
-				}
-				else if (aBoard[rank][file]->team != piece->team)
-				{
-					// enemy piece here, can move here but no further
-					Board* subBoard = new Board(*this);
-					subBoard->move(piece->x,piece->y,rank,file);
-					vBoard->push(subBoard);
-					break;
-				}
-				else
-				{
-					// cannot move here
-					break;
-				}
-				--file;
-				++rank;
-			}
-			// up-left
-			file = piece->y+1;
-			rank = piece->x-1;
-			
-			while (file<8 && rank>=0)
-			{
-				if ( aBoard[rank][file] == 0 )
-				{
-					// rook can move here and further
-					Board* subBoard = new Board(*this);
-					subBoard->move(piece->x,piece->y,rank,file);
-					vBoard->push(subBoard);
-				}
-				else if (aBoard[rank][file]->team != piece->team)
-				{
-					// enemy piece here, can move here but no further
-					Board* subBoard = new Board(*this);
-					subBoard->move(piece->x,piece->y,rank,file);
-					vBoard->push(subBoard);
-					break;
-				}
-				else
-				{
-					// cannot move here
-					break;
-				}
-				++file;
-				--rank;
-			}
-			// up-right
-			file = piece->y+1;
-			rank = piece->x+1;
-			
-			while (file<8 && rank<8)
-			{
-				if ( aBoard[rank][file] == 0 )
-				{
-					// rook can move here and further
-					Board* subBoard = new Board(*this);
-					subBoard->move(piece->x,piece->y,rank,file);
-					vBoard->push(subBoard);
-				}
-				else if (aBoard[rank][file]->team != piece->team)
-				{
-					// enemy piece here, can move here but no further
-					Board* subBoard = new Board(*this);
-					subBoard->move(piece->x,piece->y,rank,file);
-					vBoard->push(subBoard);
-					break;
-				}
-				else
-				{
-					// cannot move here
-					break;
-				}
-				++file;
-				++rank;
-			}
-			// down
-			for (file = piece->y-1; file >=0; --file)
-			{
-				if ( aBoard[piece->x][file] == 0 )
-				{
-					// rook can move here and further
-					Board* subBoard = new Board(*this);
-					subBoard->move(piece->x,piece->y,piece->x,file);
-					vBoard->push(subBoard);
-				}
-				else if (aBoard[piece->x][file]->team != piece->team)
-				{
-					// enemy piece here, can move here but no further
-					Board* subBoard = new Board(*this);
-					subBoard->move(piece->x,piece->y,piece->x,file);
-					vBoard->push(subBoard);
-					break;
-				}
-				else
-				{
-					// cannot move here
-					break;
-				}
-			}
-			// up
-			for (file = piece->y+1; file<8; ++file)
-			{
-				if ( aBoard[piece->x][file] == 0 )
-				{
-					// rook can move here and further
-					Board* subBoard = new Board(*this);
-					subBoard->move(piece->x,piece->y,piece->x,file);
-					vBoard->push(subBoard);
-				}
-				else if (aBoard[piece->x][file]->team != piece->team)
-				{
-					// enemy piece here, can move here but no further
-					Board* subBoard = new Board(*this);
-					subBoard->move(piece->x,piece->y,piece->x,file);
-					vBoard->push(subBoard);
-					break;
-				}
-				else
-				{
-					// cannot move here
-					break;
-				}
-			}
-			// left
-			for (rank = piece->x-1; rank >=0; --rank)
-			{
-				if ( aBoard[rank][piece->y] == 0 )
-				{
-					// rook can move here and further
-					Board* subBoard = new Board(*this);
-					subBoard->move(piece->x,piece->y,rank,piece->y);
-					vBoard->push(subBoard);
-				}
-				else if (aBoard[rank][piece->y]->team != piece->team)
-				{
-					// enemy piece here, can move here but no further
-					Board* subBoard = new Board(*this);
-					subBoard->move(piece->x,piece->y,rank,piece->y);
-					vBoard->push(subBoard);
-					break;
-				}
-				else
-				{
-					// cannot move here
-					break;
-				}
-			}
-			// right
-			for (rank = piece->x+1; rank <8; ++rank)
-			{
-				if ( aBoard[rank][piece->y] == 0 )
-				{
-					// rook can move here and further
-					Board* subBoard = new Board(*this);
-					subBoard->move(piece->x,piece->y,rank,piece->y);
-					vBoard->push(subBoard);
-				}
-				else if (aBoard[rank][piece->y]->team != piece->team)
-				{
-					// enemy piece here, can move here but no further
-					Board* subBoard = new Board(*this);
-					subBoard->move(piece->x,piece->y,rank,piece->y);
-					vBoard->push(subBoard);
-					break;
-				}
-				else
-				{
-					// cannot move here
-					break;
-				}
-			}
-		}
-		
-		// king, moves in diagonals and straight lines but only 1 tile
-		else if (piece->getShortName() == 'K' || piece->getShortName() == 'k')
-		{
-			// down-left
-			int rank = piece->x-1;
-			int file = piece->y-1;
-			if (isSafe(rank,file))
-			{
-				if ( aBoard[rank][file] == 0 )
-				{
-					// piece can move here and further
-					Board* subBoard = new Board(*this);
-					subBoard->move(piece->x,piece->y,rank,file);
-					vBoard->push(subBoard);
-				}
-				else if (aBoard[rank][file]->team != piece->team)
-				{
-					// enemy piece here, can move here but no further
-					Board* subBoard = new Board(*this);
-					subBoard->move(piece->x,piece->y,rank,file);
-					vBoard->push(subBoard);
-				}
-			}
-			// down-right
-			rank = piece->x+1;
-			file = piece->y-1;
-			if (isSafe(rank,file))
-			{
-				if ( aBoard[rank][file] == 0 )
-				{
-					// piece can move here and further
-					Board* subBoard = new Board(*this);
-					subBoard->move(piece->x,piece->y,rank,file);
-					vBoard->push(subBoard);
-				}
-				else if (aBoard[rank][file]->team != piece->team)
-				{
-					// enemy piece here, can move here but no further
-					Board* subBoard = new Board(*this);
-					subBoard->move(piece->x,piece->y,rank,file);
-					vBoard->push(subBoard);
-				}
-			}
-			// up-left
-			rank = piece->x-1;
-			file = piece->y+1;
-			if (isSafe(rank,file))
-			{
-				if ( aBoard[rank][file] == 0 )
-				{
-					// piece can move here and further
-					Board* subBoard = new Board(*this);
-					subBoard->move(piece->x,piece->y,rank,file);
-					vBoard->push(subBoard);
-				}
-				else if (aBoard[rank][file]->team != piece->team)
-				{
-					// enemy piece here, can move here but no further
-					Board* subBoard = new Board(*this);
-					subBoard->move(piece->x,piece->y,rank,file);
-					vBoard->push(subBoard);
-				}
-			}
-			// up-right
-			rank = piece->x+1;
-			file = piece->y+1;
-			if (isSafe(rank,file))
-			{
-				if ( aBoard[rank][file] == 0 )
-				{
-					// piece can move here and further
-					Board* subBoard = new Board(*this);
-					subBoard->move(piece->x,piece->y,rank,file);
-					vBoard->push(subBoard);
-				}
-				else if (aBoard[rank][file]->team != piece->team)
-				{
-					// enemy piece here, can move here but no further
-					Board* subBoard = new Board(*this);
-					subBoard->move(piece->x,piece->y,rank,file);
-					vBoard->push(subBoard);
-				}
-			}
-			// down
-			rank = piece->x;
-			file = piece->y-1;
-			if (isSafe(rank,file))
-			{
-				if ( aBoard[rank][file] == 0 )
-				{
-					// piece can move here and further
-					Board* subBoard = new Board(*this);
-					subBoard->move(piece->x,piece->y,rank,file);
-					vBoard->push(subBoard);
-				}
-				else if (aBoard[rank][file]->team != piece->team)
-				{
-					// enemy piece here, can move here but no further
-					Board* subBoard = new Board(*this);
-					subBoard->move(piece->x,piece->y,rank,file);
-					vBoard->push(subBoard);
-				}
-			}
-			// up
-			rank = piece->x;
-			file = piece->y+1;
-			if (isSafe(rank,file))
-			{
-				if ( aBoard[rank][file] == 0 )
-				{
-					// piece can move here and further
-					Board* subBoard = new Board(*this);
-					subBoard->move(piece->x,piece->y,rank,file);
-					vBoard->push(subBoard);
-				}
-				else if (aBoard[rank][file]->team != piece->team)
-				{
-					// enemy piece here, can move here but no further
-					Board* subBoard = new Board(*this);
-					subBoard->move(piece->x,piece->y,rank,file);
-					vBoard->push(subBoard);
-				}
-			}
-			// left
-			rank = piece->x-1;
-			file = piece->y;
-			if (isSafe(rank,file))
-			{
-				if ( aBoard[rank][file] == 0 )
-				{
-					// piece can move here and further
-					Board* subBoard = new Board(*this);
-					subBoard->move(piece->x,piece->y,rank,file);
-					vBoard->push(subBoard);
-				}
-				else if (aBoard[rank][file]->team != piece->team)
-				{
-					// enemy piece here, can move here but no further
-					Board* subBoard = new Board(*this);
-					subBoard->move(piece->x,piece->y,rank,file);
-					vBoard->push(subBoard);
-				}
-			}
-			// right
-			rank = piece->x+1;
-			file = piece->y;
-			if (isSafe(rank,file))
-			{
-				if ( aBoard[rank][file] == 0 )
-				{
-					// piece can move here and further
-					Board* subBoard = new Board(*this);
-					subBoard->move(piece->x,piece->y,rank,file);
-					vBoard->push(subBoard);
-				}
-				else if (aBoard[rank][file]->team != piece->team)
-				{
-					// enemy piece here, can move here but no further
-					Board* subBoard = new Board(*this);
-					subBoard->move(piece->x,piece->y,rank,file);
-					vBoard->push(subBoard);
-				}
-			}
-			
-			// castling
-			if (piece->hasMoved == false)
-			{
-				// castling WHITE
-				if ( piece->team == WHITE )
-				{
-					if ( aBoard[0][0] != 0 && aBoard[1][0] == 0 &&
-						aBoard[2][0] == 0 && aBoard[3][0] == 0
-						&& aBoard[0][0]->getShortName() == 'r'
-						&& aBoard[0][0]->hasMoved == false)
-					{
-						// make sure all tiles the king visits are not in check
-						if ( canAttack(2,0,BLACK) || canAttack(3,0,BLACK) ||
-						canAttack(4,0,BLACK) )
-						{
-							// White cannot castle queenside
-							// as the king would be passing through check.
-						}
-						else
-						{
-							// Queenside castling is possible
-							Board* subBoard = new Board(*this);
-							Piece * rook = aBoard[0][0];
-							subBoard->move(piece->x,piece->y,2,0,false);
-							subBoard->move(rook->x,rook->y,3,0);
-							vBoard->push(subBoard);
-						}
-					}
-					if ( aBoard[7][0] != 0 && aBoard[6][0] == 0 &&
-						aBoard[5][0] == 0
-						&& aBoard[7][0]->getShortName() == 'r'
-						&& aBoard[7][0]->hasMoved == false)
-					{
-						// make sure all tiles the king visits are not in check
-						if ( canAttack(4,0,BLACK) || canAttack(5,0,BLACK) ||
-						canAttack(6,0,BLACK) )
-						{
-							// White cannot castle kingside
-							// as the king would be passing through check.
-						}
-						else
-						{
-							// Kingside castling is possible
-							Board* subBoard = new Board(*this);
-							Piece * rook = aBoard[7][0];
-							subBoard->move(piece->x,piece->y,6,0,false);
-							subBoard->move(rook->x,rook->y,5,0);
-							vBoard->push(subBoard);
-						}
-					}
-				}
-				else
-				{
-					// castling BLACK
-					if ( aBoard[0][7] != 0 && aBoard[1][7] == 0 &&
-						aBoard[2][7] == 0 && aBoard[3][7] == 0
-						&& aBoard[0][7]->getShortName() == 'R'
-						&& aBoard[0][7]->hasMoved == false)
-					{
-						// make sure all tiles the king visits are not in check
-						if ( canAttack(2,7,WHITE) || canAttack(3,7,WHITE) ||
-						canAttack(4,7,WHITE) )
-						{
-							// Black cannot castle queenside
-							// as the king would be passing through check.
-						}
-						else
-						{
-							// Queenside castling is possible
-							Board* subBoard = new Board(*this);
-							Piece * rook = aBoard[0][7];
-							subBoard->move(piece->x,piece->y,2,7,false);
-							subBoard->move(rook->x,rook->y,3,7);
-							vBoard->push(subBoard);
-						}
-					}
-					if ( aBoard[7][7] != 0 && aBoard[6][7] == 0 &&
-						aBoard[5][7] == 0
-						&& aBoard[7][7]->getShortName() == 'R'
-						&& aBoard[7][7]->hasMoved == false)
-					{
-						// make sure all tiles the king visits are not in check
-						if ( canAttack(4,7,WHITE) || canAttack(5,7,WHITE) ||
-						canAttack(6,7,WHITE) )
-						{
-							// Black cannot castle kingside
-							// as the king would be passing through check.
-						}
-						else
-						{
-							// Kingside castling is possible
-							Board* subBoard = new Board(*this);
-							Piece * rook = aBoard[7][7];
-							subBoard->move(piece->x,piece->y,6,7,false);
-							subBoard->move(rook->x,rook->y,5,7);
-							vBoard->push(subBoard);
-						}
-					}
-				}
+			return false;
+		}
+		Board* substate = makeSubstate(_move);
+		playSubstate(substate);
+		delete substate;
+		return true;
+	}
+	
+	// make a substate where the given move has been played
+	Board* makeSubstate(const Move& _move)
+	{
+		Board* subBoard = new Board(*this);
+		subBoard->position.makeMove(_move);
+		subBoard->lastMove=_move;
+		subBoard->parent=this;
+		return subBoard;
+	}
+	
+	// return the network's first layer for this position. It is worked out
+	// from the parent's if there is one, which only changes a few features.
+	const Nnue::Accumulator& getAccumulator()
+	{
+		if ( accumulator == 0 )
+		{
+			accumulator = new Nnue::Accumulator;
+			if ( parent != 0 )
+			{
+				network.update(parent->getAccumulator(),parent->position,position,*accumulator);
+			}
+			else
+			{
+				network.refresh(position,*accumulator);
 			}
 		}
+		return *accumulator;
+	}
+	void clearAccumulator()
+	{
+		delete accumulator;
+		accumulator=0;
+	}
+	
+	bool hasPiece(bool _team, unsigned char _piece, short int _amount=1)
+	{
+		return (pieceTeam(_piece) == _team && position.countPiece(_piece) >= _amount);
 	}
 	
 	bool isSafe(const int x, const int y)
@@ -1353,15 +282,8 @@ class Board
 	std::string getState(bool displayCoordinates=false)
 	{
 		unsigned char vertLine = 179;
-		unsigned char horizontalLine = 196;
-		unsigned char intersect = 197;
-		unsigned char dot = 249;
 		
 		std::string strBoard = "  ";
-		for (int i=0;i<16;++i)
-		{
-			//strBoard+=horizontalLine;
-		}
 		strBoard+="\n";
 		
 		for (int y=7;y>=0;--y)
@@ -1373,16 +295,8 @@ class Board
 			}
 			for (int x=0;x<8;++x)
 			{
-				if ( aBoard[x][y]==0 )
-				{
-					strBoard+=vertLine;
-					strBoard+=dot;
-				}
-				else
-				{
-					strBoard+=vertLine;
-					strBoard += aBoard[x][y]->getShortName();
-				}
+				strBoard+=vertLine;
+				strBoard+=pieceChar(position.at(x,y));
 			}
 			strBoard+=vertLine;
 			strBoard+="\n";
@@ -1394,45 +308,9 @@ class Board
 		return strBoard;
 	}
 	
-	Vector <Piece*>* getAllPieces(bool _team)
-	{
-		Vector <Piece*>* vPieces = new Vector <Piece*>;
-		// wipe the board
-		for (int y=7;y>=0;--y)
-		{
-			for (int x=0; x<8; ++x)
-			{
-				if (aBoard[x][y]!=0)
-				{
-					if (aBoard[x][y]->team == _team)
-					{
-						vPieces->push(aBoard[x][y]);
-					}
-				}
-			}
-		}
-		
-		if (vPieces->size() == 0)
-		{
-			delete vPieces;
-			return 0;
-		}
-		
-		return vPieces;
-	}
-	
 	int getNPieces (const bool _team)
 	{
-		Vector <Piece*>* vPiece = getAllPieces(_team);
-		
-		if (vPiece==0)
-		{
-			return 0;
-		}
-		const int n = vPiece->size();
-		vPiece->clear();
-		delete vPiece;
-		return n;
+		return position.countPieces(_team);
 	}
 	
 	bool checkMatePossible ()
@@ -1440,66 +318,13 @@ class Board
 		// requirments for checkmate: A team must have at least a king plus
 		// * Queen
 		// * Rook
+		// * Pawn
 		// * 2 bishops
 		// * knight and bishop
-		
-		// stalemate if both sides only have 1 piece (king)
-		if (getNPieces(WHITE) < 2 && getNPieces(BLACK) < 2)
-		{
-			return false;
-		}
-		// checkmate is possible if 1 side has a pawn
-		else if (hasPiece(WHITE,WPAWN) || hasPiece(BLACK,BPAWN))
-		{
-			return true;
-		}
-		// checkmate is possible if either side has a queen
-		else if (hasPiece(WHITE,WQUEEN) || hasPiece(BLACK,BQUEEN))
-		{
-			return true;
-		}
-		// checkmate is possible if either side has a rook
-		else if (hasPiece(WHITE,WROOK) || hasPiece(BLACK,BROOK))
-		{
-			return true;
-		}
-		// checkmate is possible if either side has 2 bishops
-		else if (hasPiece(WHITE,WBISHOP,2) || hasPiece(BLACK,BBISHOP,2))
-		{
-			return true;
-		}
-		// checkmate is possible if either side has a knight and bishop
-		else if ( (hasPiece(WHITE,WBISHOP)&&hasPiece(WHITE,WKNIGHT)) ||
-		(hasPiece(BLACK,BBISHOP)&&hasPiece(BLACK,BKNIGHT))   )
-		{
-			return true;
-		}
-		return false;
+		// These are worked out for each material in the material table.
+		return (materialTable.probe(position.materialKey).flags & MATERIAL_CANNOT_MATE) == 0;
 	}
 	
-	Vector <Board*> * getAllMoves(bool _team)
-	{
-		// get all movable pieces
-		auto vPiece = getAllPieces(_team);
-		if (vPiece==0)
-		{
-			return 0;
-		}
-		
-		Vector <Board*> * vMove = new Vector <Board*>;
-		// get all moves for all pieces
-		for (int i2=0;i2<vPiece->size();++i2)
-		{
-			addAllMovesFrom((*vPiece)(i2),vMove);
-		}
-		delete vPiece;
-		
-		if ( vMove->size() > 0 )
-		{
-			return vMove;
-		}
-		return 0;
-	}
 	
 	// skip the turn and let the other side move again
 	// this is obviously not legal in a real game
@@ -1509,23 +334,14 @@ class Board
 	{
 		const bool bCanMove = canMove(_team);
 		
-		sideToMove = !sideToMove;
+		position.makeNullMove();
 		clearSubs();
 		return bCanMove;
 	}
 	
 	bool canMove(bool _team)
 	{
-		Vector <Board*> * vMove = getAllMoves(_team);
-		
-		if ( vMove == 0 || vMove->size() == 0 )
-		{
-			delete vMove;
-			return false;
-		}
-		vMove->clearPtr();
-		delete vMove;
-		return true;
+		return hasAnyLegalMove(_team);
 	}
 
 	bool randomMove (bool _team)
@@ -1541,8 +357,7 @@ class Board
 		const short int iMove = rng.rand(vSubstatesLegal.size()-1);
 		//std::cout<<"Random move: "<<iMove<<"\n";
 		
-		*this = *vSubstatesLegal(iMove);
-		clearSubs();
+		playSubstate(vSubstatesLegal(iMove));
 		
 		if ( parent )
 		{
@@ -1599,8 +414,7 @@ class Board
 			return false;
 		}
 		int chosenIndex = vBestIndex(rng.rand(vBestIndex.size()-1));
-		*this = *vSubstatesLegal( chosenIndex );
-		clearSubs();
+		playSubstate(vSubstatesLegal( chosenIndex ));
 		return true;
 	}
 	
@@ -1676,6 +490,13 @@ class Board
 			return true;
 		}
 		
+		// don't search past repetitions or the fifty move limit, the
+		// position is already a draw.
+		if ( _currentLevel > 0 && isDrawByRule() )
+		{
+			return true;
+		}
+		
 		generateSubs();
 		generateLegalMoves();
 		//if ( _currentLevel != 0 )
@@ -1713,8 +534,7 @@ class Board
 			
 			if ( best != 0 )
 			{
-				*this = *best;
-				clearSubs();
+				playSubstate(best);
 				// maybe we need a function to clear neighbors?
 				// clear subs of all states not picked.
 				//clearNeighbors();
@@ -1824,7 +644,7 @@ class Board
 			Vector <int> vBestIndex;
 			// if we are side to play, return best score,
 			// otherwise return worst score.
-			if ( _team == sideToMove )
+			if ( _team == position.sideToMove )
 			{
 				return bestSub(_team);
 			}
@@ -1873,45 +693,49 @@ class Board
 		
 	char boardStatus()
 	{
-		// Check: If some of the next moves result in loss of king.
-		// Checkmate: If no substate avoids check
-		// check for stalemate endgame here (not enough pieces to checkmate)
+		// Check: If the king can be captured.
+		// Checkmate: If the side to move is in check and has no legal move.
+		// Stalemate: If the side to move is not in check and has no legal move,
+		// or there isn't enough material to checkmate.
+		status=0;
 		
 		if ( checkMatePossible() == false )
 		{
 			status|=STALEMATE_MATERIAL;
 		}
 		
-		//stalemate: lack of material
+		if (hasKing(BLACK) == false)
+		{
+			status |= BLACK_CHECK;
+			status |= BLACK_NO_KING;
+		}
+		else if (isCheck<BLACK>())
+		{
+			status |= BLACK_CHECK;
+		}
+		if (hasKing(WHITE) == false)
+		{
+			status |= WHITE_CHECK;
+			status |= WHITE_NO_KING;
+		}
+		else if (isCheck<WHITE>())
+		{
+			status |= WHITE_CHECK;
+		}
 		
-		generateSubs();
-
-		// If we find a move which can capture the king, the board state is in check.
-		for (int i=0;i<vSubstates.size();++i)
+		if ( hasAnyLegalMove(position.sideToMove) == false )
 		{
-			if (vSubstates(i)->hasKing(BLACK) == false)
+			if ( position.sideToMove == WHITE && (status & WHITE_CHECK) )
 			{
-				status |= BLACK_CHECK;
-				status |= BLACK_NO_KING;
+				status |= WHITE_CHECKMATE;
 			}
-			if (vSubstates(i)->hasKing(WHITE) == false)
+			else if ( position.sideToMove == BLACK && (status & BLACK_CHECK) )
 			{
-				status |= WHITE_CHECK;
-				status |= WHITE_NO_KING;
+				status |= BLACK_CHECKMATE;
 			}
-		}
-
-		for (int i=0;i<vSubstates2.size();++i)
-		{
-			if (vSubstates2(i)->hasKing(BLACK) == false)
-			{
-				status |= BLACK_CHECK;
-				status |= BLACK_NO_KING;
-			}
-			if (vSubstates2(i)->hasKing(WHITE) == false)
+			else
 			{
-				status |= WHITE_CHECK;
-				status |= WHITE_NO_KING;
+				status |= STALEMATE_MOVEMENT;
 			}
 		}
 		return status;
@@ -1954,74 +778,45 @@ class Board
 	// calculate the score for this board state based on material.
 	int getMaterialScore(const bool _team)
 	{
-		int _score = 0;
-		
-		// get all movable pieces
-		auto vPiece = getAllPieces(_team);
-		if (vPiece==0)
-		{
-			return 0;
-		}
-		
-		// sum material value
-		for (auto const& element : *vPiece)
+		if ( _team == WHITE )
 		{
-			_score += element->materialValue;
+			return getMaterialScore<WHITE>();
 		}
-		delete vPiece;
-
-		return _score;
+		return getMaterialScore<BLACK>();
+	}
+	template <bool TEAM> int getMaterialScore()
+	{
+		return position.getMaterialScore<TEAM>();
 	}
 	inline int getMaterialGap(const bool _team)
 	{
 		return getMaterialScore(_team)-getMaterialScore(!_team);
 	}
 	
-	// calculate the score for this board state based on position
-	// this includes check/checkmate.
-	int getPositionalScore(bool _team)
+	// score this state for _team. The evaluation itself is in Evaluation.hpp
+	void calculateScore(const bool _team)
 	{
-		if (isCheck(!_team))
+		// positions reached again by a different move order are looked up
+		if ( evalCache.probe(position.hash,_team,score) )
 		{
-			return 100;
-			if (isCheckmate(!_team))
-			{
-				return 2000;
-			}
+			return;
 		}
-		if (isCheck(_team))
+		
+		// single dispatch on team, the evaluation below is specialised.
+		if ( canUseNetwork(position) )
 		{
-			if (isCheckmate(_team))
-			{
-				return -2000;
-			}
-			return -10;
+			score = (_team == WHITE) ? getNetworkScore<WHITE>(position,getAccumulator()) :
+				getNetworkScore<BLACK>(position,getAccumulator());
 		}
-		
-		// if (isCheckmate(!_team))
-		// {
-			// // checkmate should obviously be the maximum score.
-			// return 2000;
-		// }
-		// else if (isCheck(!_team))
-		// {
-			// // for now I'll make check about the same value as a pawn capture.
-			// // however in reality it might not be that valuable.
-			// //return 1;
-		// }
-		return 0;
-	}
-	
-	// determine an overall score for this board state using various heuristics
-	// material gap
-	// controlled spaces
-	// n covering moves/covered pieces
-	// king safety
-	// pawn structure (doubled/tripled pawns)
-	// minor piece imbalances (knight+bishop vs bishop+bishop)
-	void calculateScore(const bool _team)
-	{
-		score = getMaterialGap(_team)+getPositionalScore(_team);
+		else if ( _team == WHITE )
+		{
+			score = getHandcraftedScore<WHITE>(position);
+		}
+		else
+		{
+			score = getHandcraftedScore<BLACK>(position);
+		}
+		evalCache.store(position.hash,_team,score);
 		//std::cout<<STATIC_ID<<": calc score: "<<score<<"\n";
 	}
 	
@@ -2029,19 +824,27 @@ class Board
 	int getSubscores(const bool _team, int _depth, int _layer=0)
 	{
 		
-		if (subsGenerated == false)
+		if ( _layer > _depth )
 		{
 			//std::cout<<"r -1\n";
 			return -1;
 		}
 		
-		if ( _layer > _depth )
+		// repeated positions and the fifty move rule are scored as a draw.
+		if ( isDrawByRule() )
 		{
-			//std::cout<<"r -1\n";
-			return -1;
+			return 0;
 		}
-		else if (_layer < _depth)
+		
+		if (_layer < _depth)
 		{
+			// this state wasn't reached by the search
+			if (subsGenerated == false)
+			{
+				//std::cout<<"r -1\n";
+				return -1;
+			}
+			
 			generateSubs();
 			generateLegalMoves();
 			if (isCheck(_team))
@@ -2138,113 +941,32 @@ class Board
 
 	bool hasKing(bool _team)
 	{
-		// get all movable pieces
-		Vector <Piece*>* vPiece = getAllPieces(_team);
-		
-		if (vPiece == 0)
-		{
-			// null vector means 0 pieces
-			return false;
-		}
-		
-		if (vPiece->size() == 0)
-		{
-			return false;
-		}
-		
-		// check if vector contains a king
-		for (int i=0;i<vPiece->size();++i)
+		if ( _team == WHITE )
 		{
-			if ((*vPiece)(i)->getShortName() == 'k' || (*vPiece)(i)->getShortName() == 'K')
-			{
-				delete vPiece;
-				return true;
-			}
+			return (position.findKing<WHITE>() != -1);
 		}
-		delete vPiece;
-		return false;
+		return (position.findKing<BLACK>() != -1);
+	}
+	
+	bool hasAnyLegalMove(const bool _team)
+	{
+		return position.hasAnyLegalMove(_team);
 	}
 	
+	// checkmate if we are in check and no move gets us out of it.
 	bool isCheckmate(bool _team)
 	{
-		//return false;
-		//generateSubs();
-		// calling generateLegalMoves() here seems to cause recursion issues
-		// but not if we only call when finding check, not sure why
-		
-		
-		if (isCheck(_team))
-		{
-			//we are in check
-			//std::cout<<"Check found, looking for checkmate\n";
-			generateSubs();
-			generateLegalMoves();
-
-			if ( _team == sideToMove )
-			{
-				if (vSubstatesLegal.size() == 0 )
-				{
-					// we can't make any legal moves (all moves are in check)
-					// therefore we are in checkmate.
-					std::cout<<"Checkmate found 1\n";
-					
-					//std::cout<<"Possible checkmate found 1\n";
-					//std::cout<<"Legal substates: "<<vSubstatesLegal.size()<<
-					//", "<<vSubstatesLegal2.size()<<"\n";
-					clearSubs();
-					return true;
-				}
-			}
-			else
-			{
-				std::cout<<"Error: team is not sidetomove\n";
-			}
-			// else
-			// {
-				// if (vSubstatesLegal2.size() == 0 )
-				// {
-					// // we can't make any legal moves (all moves are in check)
-					// // therefore we are in checkmate.
-					
-					// std::cout<<"Possible checkmate found 2\n";
-					// std::cout<<"Legal substates: "<<vSubstatesLegal.size()<<
-					// ", "<<vSubstatesLegal2.size()<<"\n";
-					// return true;
-				// }
-			// }
-			
-
-		}
-		clearSubs();
-		return false;
+		return (isCheck(_team) && hasAnyLegalMove(_team) == false);
 	}
 	
 	bool isCheck(bool _team)
 	{
-		//return false;
-		// this causes performance issues because we need to generate 2 levels
-		// of substates. Maybe there is a way to improve this.
-		generateSubs();
-		//generateLegalMoves();
-		
-		for (int i=0; i<vSubstates.size(); ++i)
-		{
-			if ( vSubstates(i)->hasKing(_team) == false )
-			{
-				clearSubs();
-				return true;
-			}
-		}
-		for (int i=0; i<vSubstates2.size(); ++i)
-		{
-			if ( vSubstates2(i)->hasKing(_team) == false )
-			{
-				clearSubs();
-				return true;
-			}
-		}
-		clearSubs();
-		return false;
+		return position.isCheck(_team);
+	}
+	
+	template <bool TEAM> bool isCheck()
+	{
+		return position.isCheck<TEAM>();
 	}
 	
 	// generate all possible moves and store in memory
@@ -2256,49 +978,15 @@ class Board
 		if ( vSubstates.size() == 0 )
 		{
 			vSubstatesLegal.clear();
-			// get all movable pieces
-			auto vPiece = getAllPieces(sideToMove);
-			
-			if (vPiece!=0)
-			{
-				// get all moves for all pieces
-				for (int i2=0;i2<vPiece->size();++i2)
-				{
-					addAllMovesFrom((*vPiece)(i2),&vSubstates);
-				}
-				for (int i=0;i<vSubstates.size();++i)
-				{
-					vSubstates(i)->sideToMove=!sideToMove;
-				}
-				delete vPiece;
-			}
-			
-			//std::cout<<"Generated "<<vSubstates.size()<<" substates.\n";
 			
-
-			//std::cout<<"Generated "<<vSubstatesLegal.size()<<" legal substates.\n";
-		}
-		
-		// generate moves if opponent moves again (to determine check)
-		if ( vSubstates2.size() == 0 )
-		{
-			vSubstatesLegal2.clear();
-			// get all movable pieces
-			auto vPiece = getAllPieces(!sideToMove);
+			MoveList moves;
+			position.generateMoves(position.sideToMove,moves);
 			
-			if(vPiece!=0)
+			for (int i=0;i<moves.size();++i)
 			{
-				// get all moves for all pieces
-				for (int i2=0;i2<vPiece->size();++i2)
-				{
-					addAllMovesFrom((*vPiece)(i2),&vSubstates2);
-				}
-				for (int i=0;i<vSubstates2.size();++i)
-				{
-					vSubstates2(i)->sideToMove=!sideToMove;
-				}
-				delete vPiece;
+				vSubstates.push(makeSubstate(moves(i)));
 			}
+			//std::cout<<"Generated "<<vSubstates.size()<<" substates.\n";
 		}
 		subsGenerated=true;
 	}
@@ -2318,12 +1006,12 @@ class Board
 				if (vSubstates(i)->hasKing(BLACK) == true &&
 					vSubstates(i)->hasKing(WHITE)== true)
 				{
-					if ( vSubstates(i)->isCheck(sideToMove) == false )
+					if ( vSubstates(i)->isCheck(position.sideToMove) == false )
 					{
 						vSubstatesLegal.push(vSubstates(i));
 						if ( _calculateScores )
 						{
-							vSubstates(i)->calculateScore(vSubstates(i)->sideToMove);
+							vSubstates(i)->calculateScore(vSubstates(i)->position.sideToMove);
 						}
 					}
 					else
@@ -2335,30 +1023,6 @@ class Board
 				}
 			}
 		}
-		if ( vSubstatesLegal2.size() == 0 )
-		{
-			// don't add moves which remove king
-			// don't add moves which put player into check
-			
-			for (int i=0;i<vSubstates2.size();++i)
-			{
-				if (vSubstates2(i)->hasKing(BLACK) == true &&
-					vSubstates2(i)->hasKing(WHITE)== true)
-				{
-					if ( vSubstates2(i)->isCheck(sideToMove) == false )
-					{
-						vSubstatesLegal2.push(vSubstates2(i));
-					}
-					else
-					{
-						//std::cout<<"Movement into check found\n";
-					}
-					
-					
-				}
-			}
-		}
-
 	}
 	
 	void clearSubs()
@@ -2370,8 +1034,6 @@ class Board
 		// vSubstatesLegal is a subset of vSubstates so it doesn't need to be
 		// deleted
 		vSubstatesLegal.clear();
-		vSubstates2.clearPtr();
-		vSubstatesLegal2.clear();
 	}
 	void clearNeighbors()
 	{
@@ -2389,13 +1051,6 @@ class Board
 				}
 				parent->vSubstates.removeNulls();
 			}
-			for (int i=0;i<parent->vSubstates2.size();++i)
-			{
-				if (parent->vSubstates2(i) != this)
-				{
-					//delete parent->vSubstates2(i);
-				}
-			}
 		}
 	}
 };
@@ -34,11 +34,11 @@
 #include <System/Time/Timer.hpp>
 #include <File/FileManagerStatic.hpp>
 #include <Container/Vector/Vector.hpp>
-#include <Math/Random/RandomLehmer.hpp>
 #include <Data/DataTools.hpp>
 
 #include <iostream>
 #include <string>
+#include <cstdlib>
 #include <time.h>
 
 #define WHITE true
@@ -51,35 +51,91 @@
 #define BLACK_CHECK 0b00001000
 #define BLACK_CHECKMATE 0b00000100
 #define BLACK_NO_KING 0b00000010
-#define STALEMATE_MOVEMENT 0b00001000
-#define STALEMATE_MATERIAL 0b00000100
-	// pieces
-#define WPAWN 244
-#define BPAWN 245
-#define WROOK 'r'
-#define BROOK 'R'
-#define WKNIGHT 'n'
-#define BKNIGHT 'N'
-#define WBISHOP 'b'
-#define BBISHOP 'B'
-#define WQUEEN 'q'
-#define BQUEEN 'Q'
-#define WKING 'k'
-#define BKING 'K'
+#define STALEMATE_MOVEMENT 0b00010000
+#define STALEMATE_MATERIAL 0b00000001
+	// pieces. The low 3 bits are the piece type and bit 3 is set for white.
+#define WPAWN 9
+#define BPAWN 1
+#define WROOK 12
+#define BROOK 4
+#define WKNIGHT 10
+#define BKNIGHT 2
+#define WBISHOP 11
+#define BBISHOP 3
+#define WQUEEN 13
+#define BQUEEN 5
+#define WKING 14
+#define BKING 6
 
 // We should convert the team defines to enum
 //enum eTeam {WHITE, BLACK, BOTH};
 
-RandomLehmer rng;
+#include "Random.hpp"
+// random numbers for move choice, separate for each thread
+thread_local Random rng;
 
+#include "Side.hpp"
+#include "Tables.hpp"
+#include "Move.hpp"
+#include "Zobrist.hpp"
+#include "GameHistory.hpp"
 #include "Piece.hpp"
+#include "Position.hpp"
+#include "Trace.hpp"
+#include "PawnStructure.hpp"
+#include "EvalCache.hpp"
+#include "Material.hpp"
+#include "Endgame.hpp"
+#include "Tablebase.hpp"
+#include "NnueKernels.hpp"
+#include "Nnue.hpp"
+
+// shared by all boards, as most positions in a search have the same pawns.
+// Each thread has its own so they don't overwrite each other's entries.
+thread_local PawnTable pawnTable;
+// static evaluations of positions already seen
+EvalCache evalCache;
+// material gap, imbalance and phase for each combination of pieces
+const MaterialTable materialTable;
+// evaluation functions for endgames recognised by their material
+const EndgameTable endgameTable;
+// exact results for endgames with few pieces, if tables have been generated
+Tablebases tablebases;
+// evaluates positions if a network file is found
+Nnue::Network network;
+
+#include "Evaluation.hpp"
+#include "TranspositionTable.hpp"
+// results of earlier searches, shared by every search thread
+TranspositionTable transpositionTable;
+
 #include "Board.hpp"
+#include "Search.hpp"
+#include "SearchJob.hpp"
+#include "EnginePlayer.hpp"
+#include "Batch.hpp"
+#include "Tuner.hpp"
+#include "GameRecord.hpp"
+#include "Tournament.hpp"
+#include "TrainingData.hpp"
+#include "GameDatabase.hpp"
+#include "Uci.hpp"
 
 Board mainBoard;
+GameHistory gameHistory;
 
-std::string gameLog = "";
+// the moves of the game, written to GAME_RECORD_FILE when it ends if
+// LOG_GAMES is set
+GameRecord gameRecord;
 
 #define LOG_GAMES false
+#define GAME_RECORD_FILE "games.btgr"
+
+// black plays with a timed search, and thinks on white's time as well
+#define BLACK_SEARCH_TIME 100
+#define BLACK_PONDERS true
+
+EnginePlayer blackEngine(BLACK_PONDERS);
 
 int moveBlackRandom()
 {
@@ -87,7 +143,7 @@ int moveBlackRandom()
 	{
 		// black is unable to move
 		// if we are in check, this is checkmate
-		if (mainBoard.boardStatus() != 0)
+		if (mainBoard.hasState(BLACK_CHECKMATE))
 		{
 			std::cout<<"Black is in checkmate, white wins.\n";
 			return 1;
@@ -107,7 +163,28 @@ int moveBlackGreedy()
 	{
 		// black is unable to move
 		// if we are in check, this is checkmate
-		if (mainBoard.boardStatus() != 0)
+		if (mainBoard.hasState(BLACK_CHECKMATE))
+		{
+			std::cout<<"Black is in checkmate, white wins.\n";
+			return 1;
+		}
+		else
+		{
+			std::cout<<"Stalemate\n";
+			return 2;
+		}
+	}
+	return 0;
+}
+
+int moveBlackEngine()
+{
+	const Move move = blackEngine.think(mainBoard.position,&gameHistory,BLACK_SEARCH_TIME);
+	if ( mainBoard.playMove(move) == false )
+	{
+		// black is unable to move
+		// if we are in check, this is checkmate
+		if (mainBoard.hasState(BLACK_CHECKMATE))
 		{
 			std::cout<<"Black is in checkmate, white wins.\n";
 			return 1;
@@ -118,6 +195,11 @@ int moveBlackGreedy()
 			return 2;
 		}
 	}
+	const SearchInfo& info = blackEngine.getResult();
+	gameRecord.addMove(move,info.nLines > 0 ? info.aLine[0].score : GAME_RECORD_NO_SCORE,info.depth,info.elapsed/1000);
+	
+	// white's turn is spent searching the reply black expects
+	blackEngine.ponder(mainBoard.position,&gameHistory);
 	return 0;
 }
 
@@ -127,7 +209,7 @@ int moveBlackDepth(int _depth, int _breadth)
 	{
 		// black is unable to move
 		// if we are in check, this is checkmate
-		if (mainBoard.boardStatus() != 0)
+		if (mainBoard.hasState(BLACK_CHECKMATE))
 		{
 			std::cout<<"Black is in checkmate, white wins.\n";
 			return 1;
@@ -145,15 +227,34 @@ void printScore()
 {
 	std::cout<<"Material scores: "<<mainBoard.getMaterialScore(WHITE)-1000
 	<<" / "<<mainBoard.getMaterialScore(BLACK)-1000<<"\n";
+	std::cout<<"Pawn table hit rate: "<<pawnTable.hitRate()<<"%\n";
+	std::cout<<"Eval cache hit rate: "<<evalCache.hitRate()<<"%\n";
+	if ( BLACK_PONDERS )
+	{
+		std::cout<<"Black ponder hits: "<<blackEngine.nPonderHits<<" / "<<
+			blackEngine.nPonderHits+blackEngine.nPonderMisses<<"\n";
+	}
 }
 
-void printBoard(bool _log=true)
+void printBoard()
 {
 	std::cout<<mainBoard.getState(true)<<"\n\n";
-	if (_log && LOG_GAMES)
+}
+
+// end the game if it is drawn by repetition or the fifty move rule
+bool isDrawByRule()
+{
+	if (mainBoard.isThreefoldRepetition())
+	{
+		std::cout<<"Draw: Threefold repetition.\n";
+		return true;
+	}
+	if (mainBoard.isFiftyMoveDraw())
 	{
-		gameLog+=mainBoard.getState(true)+"\n\n";
+		std::cout<<"Draw: Fifty moves without a capture or pawn move.\n";
+		return true;
 	}
+	return false;
 }
 
 Timer turnTimer;
@@ -167,7 +268,6 @@ int aiPlay()
 	while (true)
 	{
 		std::cout<<"\n\nTurn: "<<i++<<"\n";
-		gameLog+="\n\nTurn: "+DataTools::toString(i-1)+"\n\n";
 		
 		printBoard();
 		
@@ -177,15 +277,18 @@ int aiPlay()
 			return 0;
 		}
 		
+		if (isDrawByRule())
+		{
+			return 0;
+		}
+		
 		if ( mainBoard.hasState(WHITE_CHECK) )
 		{
 			std::cout<<"White is in check/checkmate.\n";
-			gameLog+="White is in check/checkmate.\n";
 		}
-		else if ( mainBoard.boardStatus() == 2 )
+		else if ( mainBoard.hasState(STALEMATE_MOVEMENT) )
 		{
 			std::cout<<"Stalemate.\n";
-			gameLog+="Stalemate.\n";
 			return 0;
 		}
 		
@@ -207,6 +310,7 @@ int aiPlay()
 			std::cout<<"White cannot move. Stalemate/checkmate.\n";
 			return 0;
 		}
+		gameRecord.addMove(mainBoard.lastMove);
 		
 		
 		// analysis
@@ -220,6 +324,11 @@ int aiPlay()
 			return 0;
 		}
 		
+		if (isDrawByRule())
+		{
+			return 0;
+		}
+		
 		if (mainBoard.hasKing(BLACK) == false)
 		{
 			std::cout<<"Black king is ded.\n";
@@ -229,7 +338,7 @@ int aiPlay()
 		turnTimer.init();
 		turnTimer.start();
 		
-		if (moveBlackDepth(1,999) != 0)
+		if (moveBlackEngine() != 0)
 		{
 			std::cout<<"White wins\n";
 			return 0;
@@ -239,6 +348,7 @@ int aiPlay()
 		while (turnTimer.uSeconds < TIME_BETWEEN_TURNS)
 		{
 			sleep(100);
+			turnTimer.update();
 		}
 		
 		printScore();
@@ -246,20 +356,468 @@ int aiPlay()
 			//sleep(SLEEP_AMOUNT);
 		#endif
 	}
+	return 0;
+}
+
+// score each position in a FEN file, printing the score and the position.
+int evaluateFile(const std::string& _path, const int _depth, const int _nThreads)
+{
+	Vector <Position> vPosition;
+	if ( loadFenFile(_path,vPosition) == 0 )
+	{
+		std::cout<<"No positions read from "<<_path<<"\n";
+		return 1;
+	}
 	
-	// finished
-	std::cout<<"Writing game log\n";
-	FileManagerStatic::writeFreshString(gameLog,"gamelog.txt");
+	Vector <int> vScore;
+	for (int i=0;i<vPosition.size();++i)
+	{
+		vScore.push(0);
+	}
+	
+	Timer timer;
+	timer.init();
+	timer.start();
+	evaluateBatch(&vPosition(0),&vScore(0),vPosition.size(),_depth,_nThreads);
+	timer.update();
+	
+	for (int i=0;i<vPosition.size();++i)
+	{
+		std::cout<<vScore(i)<<"\t"<<vPosition(i).getFen()<<"\n";
+	}
+	std::cout<<"Scored "<<vPosition.size()<<" positions in "<<timer.uSeconds/1000000.0<<" seconds.\n";
 	return 0;
 }
 
+// tune the evaluation weights on a file of positions and results, printing
+// the tuned weights.
+int tuneFile(const std::string& _path, const int _iterations, const int _nThreads)
+{
+	Tuner tuner(_nThreads);
+	
+	Timer timer;
+	timer.init();
+	timer.start();
+	if ( tuner.load(_path) == 0 )
+	{
+		std::cout<<"No positions read from "<<_path<<"\n";
+		return 1;
+	}
+	timer.update();
+	std::cout<<"Loaded "<<tuner.size()<<" positions in "<<timer.uSeconds/1000000.0<<" seconds.\n";
+	
+	std::cout<<"K "<<tuner.fitK()<<", error "<<tuner.error()<<"\n";
+	tuner.tune(_iterations);
+	timer.update();
+	std::cout<<"Tuned in "<<timer.uSeconds/1000000.0<<" seconds.\n";
+	
+	std::cout<<"term\tcurrent\ttuned\n";
+	tuner.print();
+	return 0;
+}
+
+// check FENs which setFen must reject or correct. Returns the number of
+// failures.
+int testFen()
+{
+	int nFailed = 0;
+	auto check = [&](const bool _passed, const std::string& _name)
+	{
+		std::cout<<(_passed ? "pass " : "FAIL ")<<_name<<"\n";
+		nFailed += (_passed == false);
+	};
+	
+	Position position;
+	check(position.setFen("4k3/8/8/8/8/8/8/p3K3 b - - 0 1") == false, "black pawn on rank 1");
+	check(position.setFen("P3k3/8/8/8/8/8/8/4K3 w - - 0 1") == false, "white pawn on rank 8");
+	check(position.setFen("8/8/8/8/8/8/8/4K3 w - - 0 1") == false, "no black king");
+	check(position.setFen("4k3/8/8/8/8/8/8/3KK3 w - - 0 1") == false, "two white kings");
+	
+	check(position.setFen("4k3/8/8/8/8/8/8/R3K3 w KQkq - 0 1") && position.castling == CASTLE_WHITE_QUEENSIDE,
+		"castling rights without their rook or king are cleared");
+	MoveList moves;
+	position.generateLegalMoves(moves);
+	bool castles = false;
+	for (int i=0;i<moves.size();++i)
+	{
+		castles |= (moves(i).type() == MOVE_CASTLE && squareX(moves(i).to()) == 6);
+	}
+	check(castles == false, "no kingside castling without the h1 rook");
+	for (int i=0;i<moves.size();++i)
+	{
+		Position child = position;
+		child.makeMove(moves(i));
+		if ( child.hash != child.computeHash() )
+		{
+			check(false, "hash after "+moves(i).toString());
+		}
+	}
+	
+	check(position.setFen("r3k2r/8/8/8/8/8/8/R3K2R w KQkq - 0 1") && position.castling ==
+		(CASTLE_WHITE_KINGSIDE|CASTLE_WHITE_QUEENSIDE|CASTLE_BLACK_KINGSIDE|CASTLE_BLACK_QUEENSIDE),
+		"castling rights kept with pieces at home");
+	
+	check(position.setFen("k7/8/8/8/8/8/3Pp3/K7 w - e3 0 1") && position.enPassant == NO_EN_PASSANT,
+		"en passant on rank 3 with white to move is cleared");
+	position.generateLegalMoves(moves);
+	bool passant = false;
+	for (int i=0;i<moves.size();++i)
+	{
+		passant |= (moves(i).type() == MOVE_EN_PASSANT);
+	}
+	check(passant == false, "no en passant capture of a pawn on rank 2");
+	check(position.setFen("k7/8/8/3pP3/8/8/8/K7 b - d6 0 1") && position.enPassant == NO_EN_PASSANT,
+		"en passant on rank 6 with black to move is cleared");
+	check(position.setFen("k7/8/3n4/3pP3/8/8/8/K7 w - d6 0 1") && position.enPassant == NO_EN_PASSANT,
+		"en passant onto an occupied square is cleared");
+	check(position.setFen("k7/8/8/3pP3/8/8/8/K7 w - d6 0 1") && position.enPassant == toSquare(3,5),
+		"en passant kept for white");
+	check(position.setFen("k7/8/8/8/3Pp3/8/8/K7 b - d3 0 1") && position.enPassant == toSquare(3,2),
+		"en passant kept for black");
+	return nFailed;
+}
+
+// gamedb build <database> <record file>...
+// gamedb query <database> [moves <move>... | fen <fen>]
+// gamedb game <database> <game number>
+// gamedb duplicates <database> [count] [minimum ply]
+// build a game database from game record files, or look up a position, a
+// game or the positions shared by the most games.
+int gameDatabaseCommand(const int narg, char ** arg)
+{
+	const std::string command = arg[2];
+	const std::string path = arg[3];
+	
+	if ( command == "build" )
+	{
+		GameDatabaseBuilder builder;
+		int nSkipped = 0;
+		for (int i=4;i<narg;++i)
+		{
+			GameRecordReader reader;
+			if ( reader.open(arg[i]) == false )
+			{
+				std::cout<<"Couldn't read game records from "<<arg[i]<<"\n";
+				return 1;
+			}
+			GameRecord record;
+			while ( reader.next(record) )
+			{
+				nSkipped += (builder.add(record) == false);
+			}
+		}
+		if ( builder.write(path) == false )
+		{
+			std::cout<<"Couldn't write "<<path<<"\n";
+			return 1;
+		}
+		std::cout<<"Wrote "<<builder.size()<<" games to "<<path<<", skipping "<<nSkipped<<" with illegal moves\n";
+		return 0;
+	}
+	
+	GameDatabase database;
+	if ( database.open(path) == false )
+	{
+		std::cout<<"Couldn't open the game database "<<path<<"\n";
+		return 1;
+	}
+	
+	if ( command == "query" )
+	{
+		Position position;
+		position.reset();
+		const std::string mode = narg >= 5 ? arg[4] : "";
+		if ( mode == "fen" )
+		{
+			std::string fen;
+			for (int i=5;i<narg;++i)
+			{
+				fen += std::string(arg[i])+" ";
+			}
+			if ( position.setFen(fen) == false )
+			{
+				std::cout<<"Invalid FEN "<<fen<<"\n";
+				return 1;
+			}
+		}
+		else if ( mode == "moves" )
+		{
+			for (int i=5;i<narg;++i)
+			{
+				const std::string text = arg[i];
+				const Move move = text.size() >= 4 ? position.findMove(toSquare(text[0]-'a',text[1]-'1'),
+					toSquare(text[2]-'a',text[3]-'1')) : Move();
+				if ( move.isNull() )
+				{
+					std::cout<<"Illegal move "<<text<<"\n";
+					return 1;
+				}
+				position.makeMove(move);
+			}
+		}
+		
+		const long long start = searchClock();
+		const std::vector <GameDbMoveStat> vStat = database.getMoveStats(position.hash);
+		const std::vector <GameDbPosting> vGame = database.getGames(position.hash,10);
+		const long long elapsed = searchClock()-start;
+		
+		unsigned int nGames = 0;
+		for (const GameDbMoveStat& stat : vStat)
+		{
+			nGames += stat.nGames;
+		}
+		std::cout<<position.getFen()<<"\n"<<nGames<<" games of "<<database.size()<<", found in "<<elapsed/1000.0<<" ms\n";
+		std::cout<<"move\tgames\twhite\tdraw\tblack\n";
+		for (const GameDbMoveStat& stat : vStat)
+		{
+			std::cout<<(stat.move == 0 ? std::string("end") : moveToSan(position,Move::fromData(stat.move)))<<"\t"<<
+				stat.nGames<<"\t"<<stat.whiteWins*100/stat.nGames<<"%\t"<<stat.draws*100/stat.nGames<<"%\t"<<
+				stat.blackWins*100/stat.nGames<<"%\n";
+		}
+		if ( vGame.empty() == false )
+		{
+			std::cout<<"games:";
+			for (const GameDbPosting& game : vGame)
+			{
+				std::cout<<" "<<game.game<<" (ply "<<game.ply<<")";
+			}
+			std::cout<<"\n";
+		}
+		return 0;
+	}
+	
+	if ( command == "game" && narg >= 5 )
+	{
+		GameRecord record;
+		if ( database.getGame(strtoull(arg[4],0,10),record) == false )
+		{
+			std::cout<<"No game "<<arg[4]<<"\n";
+			return 1;
+		}
+		std::cout<<record.toPgn();
+		return 0;
+	}
+	
+	if ( command == "duplicates" )
+	{
+		const long long start = searchClock();
+		const std::vector <GameDbDuplicate> vDuplicate = database.findDuplicates(narg>=5 ? atoi(arg[4]) : 10,
+			narg>=6 ? atoi(arg[5]) : 0);
+		std::cout<<"Searched "<<database.countPositions()<<" positions in "<<(searchClock()-start)/1000.0<<" ms\n";
+		std::cout<<"games\tfirst game\tposition\n";
+		for (const GameDbDuplicate& duplicate : vDuplicate)
+		{
+			Position position;
+			database.getPosition(duplicate.game,duplicate.ply,position);
+			std::cout<<duplicate.nGames<<"\t"<<duplicate.game<<" ply "<<duplicate.ply<<"\t"<<position.getFen()<<"\n";
+		}
+		return 0;
+	}
+	
+	std::cout<<"Unknown game database command "<<command<<"\n";
+	return 1;
+}
+
 int main (int narg, char ** arg)
 {	
 	rng.seed(time(NULL));
 	
+	// uci
+	// talk to a GUI or match runner over the Universal Chess Interface. Other
+	// output has to be sent as info strings.
+	const bool uciMode = ( narg >= 2 && std::string(arg[1]) == "uci" );
+	const std::string notePrefix = uciMode ? "info string " : "";
+	
+	if ( network.load(NNUE_FILE) )
+	{
+		std::cout<<notePrefix<<"Using neural network evaluation from "<<NNUE_FILE<<" ("<<Nnue::simdName(network.getSimd())<<")\n";
+	}
+	
+	const int nTables = tablebases.load(TB_DIRECTORY);
+	if ( nTables > 0 )
+	{
+		std::cout<<notePrefix<<"Loaded "<<nTables<<" endgame tablebases from "<<TB_DIRECTORY<<"\n";
+	}
+	
+	if ( uciMode )
+	{
+		Uci uci;
+		return uci.run();
+	}
+	
+	// test
+	// run the built in checks, returning 1 if any fail.
+	if ( narg >= 2 && std::string(arg[1]) == "test" )
+	{
+		return testFen() == 0 ? 0 : 1;
+	}
+	
+	// tablebase <material> [threads]
+	// generate the tablebase for some material, for example KRKN.
+	if ( narg >= 3 && std::string(arg[1]) == "tablebase" )
+	{
+		if ( tablebases.generate(arg[2], TB_DIRECTORY, narg>=4 ? atoi(arg[3]) : 0) == false )
+		{
+			std::cout<<"Couldn't generate the tablebase for "<<arg[2]<<"\n";
+			return 1;
+		}
+		return 0;
+	}
+	
+	// evaluate <fen file> [depth] [threads]
+	// score every position in the file and print the scores.
+	if ( narg >= 3 && std::string(arg[1]) == "evaluate" )
+	{
+		return evaluateFile(arg[2], narg>=4 ? atoi(arg[3]) : 0, narg>=5 ? atoi(arg[4]) : 0);
+	}
+	
+	// datagen <file> <positions> [player] [threads] [seed <n>]
+	// append self-play positions labelled with search scores and game
+	// results to a training file. The player is depth=<plies> or
+	// alphabeta=<nodes>, by default alphabeta=5000. The same seed plays the
+	// same games, and without one the seed used is printed.
+	if ( narg >= 4 && std::string(arg[1]) == "datagen" )
+	{
+		PlayerSpec player;
+		if ( player.parse(narg>=5 ? arg[4] : "alphabeta=5000") == false ||
+			(player.type != PLAYER_DEPTH && player.type != PLAYER_ALPHABETA) )
+		{
+			std::cout<<"The player must be depth=<plies> or alphabeta=<nodes>\n";
+			return 1;
+		}
+		uint64_t seed = time(NULL);
+		bool seedGiven = false;
+		for (int i=6;i<narg;++i)
+		{
+			if ( std::string(arg[i]) == "seed" && i+1 < narg )
+			{
+				seed = strtoull(arg[++i],0,10);
+				seedGiven = true;
+			}
+		}
+		if ( seedGiven == false )
+		{
+			std::cout<<"Seed "<<seed<<"\n";
+		}
+		const unsigned long long nPositions = strtoull(arg[3],0,10);
+		if ( generateTrainingData(arg[2], nPositions, player, narg>=6 ? atoi(arg[5]) : 0, seed) < nPositions )
+		{
+			std::cout<<"Couldn't write "<<nPositions<<" positions to "<<arg[2]<<"\n";
+			return 1;
+		}
+		return 0;
+	}
+	
+	// pgn <record file>
+	// print the games in a game record file as PGN.
+	if ( narg >= 3 && std::string(arg[1]) == "pgn" )
+	{
+		GameRecordReader reader;
+		if ( reader.open(arg[2]) == false )
+		{
+			std::cout<<"Couldn't read game records from "<<arg[2]<<"\n";
+			return 1;
+		}
+		GameRecord record;
+		while ( reader.next(record) )
+		{
+			std::cout<<record.toPgn();
+		}
+		return 0;
+	}
+	
+	// gamedb <command> <database> ...
+	// build and query a database of recorded games, see gameDatabaseCommand.
+	if ( narg >= 4 && std::string(arg[1]) == "gamedb" )
+	{
+		return gameDatabaseCommand(narg, arg);
+	}
+	
+	// tune <file> [iterations] [threads]
+	// fit the evaluation weights to a file of FENs and game results.
+	if ( narg >= 3 && std::string(arg[1]) == "tune" )
+	{
+		return tuneFile(arg[2], narg>=4 ? atoi(arg[3]) : 1000, narg>=5 ? atoi(arg[4]) : 0);
+	}
+	
+	// match <player> <player> [games] [threads] [sprt <elo0> <elo1> [alpha] [beta]] [record <file>] [seed <n>]
+	// play games between two kinds of player, for example greedy and
+	// alphabeta=5000, and print the first player's score. With sprt the
+	// match stops once a sequential test decides between elo0 and elo1, and
+	// with record the games are appended to a game record file. The same
+	// seed plays the same games, and without one the seed used is printed.
+	if ( narg >= 4 && std::string(arg[1]) == "match" )
+	{
+		PlayerSpec first, second;
+		if ( first.parse(arg[2]) == false || second.parse(arg[3]) == false )
+		{
+			std::cout<<"Players are random, greedy, depth=<plies> or alphabeta=<nodes>\n";
+			return 1;
+		}
+		Sprt sprt;
+		bool useSprt = false;
+		GameRecordWriter writer;
+		bool record = false;
+		uint64_t seed = time(NULL);
+		bool seedGiven = false;
+		for (int i=6;i<narg;++i)
+		{
+			const std::string option = arg[i];
+			if ( option == "sprt" && i+2 < narg )
+			{
+				useSprt = true;
+				sprt = Sprt(atof(arg[i+1]), atof(arg[i+2]));
+				i += 2;
+				if ( i+2 < narg && isdigit(arg[i+1][0]) && isdigit(arg[i+2][0]) )
+				{
+					sprt.alpha = atof(arg[i+1]);
+					sprt.beta = atof(arg[i+2]);
+					i += 2;
+				}
+			}
+			else if ( option == "record" && i+1 < narg )
+			{
+				record = writer.open(arg[++i]);
+				if ( record == false )
+				{
+					std::cout<<"Couldn't open "<<arg[i]<<" for game records\n";
+					return 1;
+				}
+			}
+			else if ( option == "seed" && i+1 < narg )
+			{
+				seed = strtoull(arg[++i],0,10);
+				seedGiven = true;
+			}
+		}
+		if ( seedGiven == false )
+		{
+			std::cout<<"Seed "<<seed<<"\n";
+		}
+		playMatch(first, second, narg>=5 ? atoi(arg[4]) : 100, narg>=6 ? atoi(arg[5]) : 0, seed,
+			useSprt ? &sprt : 0, record ? &writer : 0);
+		return 0;
+	}
+	
+	gameHistory.clear();
+	mainBoard.history = &gameHistory;
 	mainBoard.reset();
+	gameRecord.begin(mainBoard.position,"BigThink greedy","BigThink search",true);
+	
+	const int result = aiPlay();
+	blackEngine.stop();
 	
-	return aiPlay();
+	gameRecord.finish(adjudicate(mainBoard.position,gameHistory));
+	if ( LOG_GAMES )
+	{
+		GameRecordWriter writer;
+		if ( writer.open(GAME_RECORD_FILE) )
+		{
+			writer.write(gameRecord);
+			std::cout<<"Game written to "<<GAME_RECORD_FILE<<"\n";
+		}
+	}
+	return result;
 	
 	std::cout<<"\n\nBigThink chess engine\n";
 	std::cout<<"Enter 4 digits to make move.\n";
@@ -364,8 +922,10 @@ int main (int narg, char ** arg)
 			// process digits
 			if (currentDigit == 4)
 			{
+				const unsigned long long previousHash = mainBoard.position.hash;
 				if (mainBoard.move(digit[0],digit[1],digit[2],digit[3]))
 				{
+					gameHistory.push(previousHash);
 					printBoard();
 					printScore();
 					
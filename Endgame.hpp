@@ -0,0 +1,292 @@
+#include <algorithm>
+#include <unordered_map>
+
+// Specialised evaluation of simple endgames.
+// With few pieces left the general evaluation has no idea how to make
+// progress, so the search shuffles pieces for hundreds of turns in KQK or KRK.
+// Endgames are recognised by their material signature, which is looked up in
+// a registry of evaluation functions. These return exact results where they
+// are known (drawn material, the rule of the square), or a score which drives
+// the lone king to the edge or the right corner so the search can find the
+// mate. Other material, such as opposite coloured bishops, only scales the
+// normal evaluation down towards a draw, starting from the scale factors in
+// the material table.
+
+	// score for an endgame which is known to be won, before the bonus for
+	// making progress. Must be well below SCORE_CHECKMATE.
+#define ENDGAME_KNOWN_WIN 200
+	// scale factor for opposite coloured bishops, out of MATERIAL_SCALE_NORMAL
+#define ENDGAME_SCALE_OPPOSITE_BISHOPS 24
+
+namespace Endgame
+{
+	// returns false if it can't say anything about the position. Otherwise
+	// _score is set from the strong side's point of view.
+	typedef bool (*Function)(const Position& _position, const bool _strong, int& _score);
+
+	inline bool isDarkSquare(const int _square)
+	{
+		return ((squareX(_square)+squareY(_square)) & 1) == 0;
+	}
+
+	inline int findKing(const Position& _position, const bool _team)
+	{
+		return _team==WHITE ? _position.findKing<WHITE>() : _position.findKing<BLACK>();
+	}
+
+	inline int findPiece(const Position& _position, const unsigned char _piece)
+	{
+		for (int square=0;square<64;++square)
+		{
+			if ( _position.aSquare[square] == _piece )
+			{
+				return square;
+			}
+		}
+		return -1;
+	}
+
+	// higher the closer the square is to the edge, 0 to 6
+	inline int edgeBonus(const int _square)
+	{
+		const int x = squareX(_square);
+		const int y = squareY(_square);
+		const int fromEdgeX = x < 4 ? x : 7-x;
+		const int fromEdgeY = y < 4 ? y : 7-y;
+		return 6-fromEdgeX-fromEdgeY;
+	}
+
+	// the weak side is to move and can take an undefended piece next to
+	// its king. The search needs to see that rather than the recogniser.
+	inline bool weakCanCapture(const Position& _position, const bool _strong)
+	{
+		if ( _position.sideToMove == _strong )
+		{
+			return false;
+		}
+		const int weakKing = findKing(_position,!_strong);
+		const int strongKing = findKing(_position,_strong);
+		Bitboard targets = kingAttacks(weakKing) & ~kingAttacks(strongKing);
+		while (targets)
+		{
+			const unsigned char piece = _position.aSquare[popSquare(targets)];
+			if ( piece != 0 && pieceTeam(piece) == _strong )
+			{
+				return true;
+			}
+		}
+		return false;
+	}
+
+	// no one can win
+	inline bool drawn(const Position&, const bool, int& _score)
+	{
+		_score = 0;
+		return true;
+	}
+
+	// king and enough material to mate against a lone king. Push the king to
+	// the edge and bring our king closer.
+	inline bool mateLoneKing(const Position& _position, const bool _strong, int& _score)
+	{
+		if ( weakCanCapture(_position,_strong) )
+		{
+			return false;
+		}
+		const int weakKing = findKing(_position,!_strong);
+		const int strongKing = findKing(_position,_strong);
+
+		MaterialCount material;
+		material.setKey(_position.materialKey);
+
+		_score = ENDGAME_KNOWN_WIN + material.material(_strong) + edgeBonus(weakKing)*3 +
+			(7-squareDistance(strongKing,weakKing))*2;
+		return true;
+	}
+
+	// bishop and knight. The mate can only be given in a corner the bishop
+	// covers, so push the king towards one of those.
+	inline bool mateBishopKnight(const Position& _position, const bool _strong, int& _score)
+	{
+		if ( weakCanCapture(_position,_strong) )
+		{
+			return false;
+		}
+		const int weakKing = findKing(_position,!_strong);
+		const int strongKing = findKing(_position,_strong);
+		const int bishop = findPiece(_position,makePiece(BISHOP,_strong));
+
+		// a1 and h8 are dark
+		const int cornerA = isDarkSquare(bishop) ? toSquare(0,0) : toSquare(7,0);
+		const int cornerB = isDarkSquare(bishop) ? toSquare(7,7) : toSquare(0,7);
+		const int fromCorner = std::min(squareDistance(weakKing,cornerA),squareDistance(weakKing,cornerB));
+
+		_score = ENDGAME_KNOWN_WIN + edgeBonus(weakKing) + (7-fromCorner)*3 +
+			(7-squareDistance(strongKing,weakKing))*2;
+		return true;
+	}
+
+	// two bishops only win if they are on different colours
+	inline bool mateTwoBishops(const Position& _position, const bool _strong, int& _score)
+	{
+		MaterialCount material;
+		material.set(_position);
+		if ( material.darkBishops[_strong] != 1 )
+		{
+			_score = 0;
+			return true;
+		}
+		return mateLoneKing(_position,_strong,_score);
+	}
+
+	// king and pawn against king. Wins by the rule of the square or with the
+	// king on a key square, draws with a rook pawn and the defending king in
+	// the corner. Everything else is left to the search.
+	inline bool kingPawn(const Position& _position, const bool _strong, int& _score)
+	{
+		// flip so the strong side moves up the board
+		const int flip = _strong==WHITE ? 0 : 56;
+		const int pawn = findPiece(_position,makePiece(PAWN,_strong)) ^ flip;
+		const int strongKing = findKing(_position,_strong) ^ flip;
+		const int weakKing = findKing(_position,!_strong) ^ flip;
+		const bool weakToMove = _position.sideToMove != _strong;
+
+		const int x = squareX(pawn);
+		const int y = squareY(pawn);
+		const int queening = toSquare(x,7);
+		const int winScore = ENDGAME_KNOWN_WIN + y*2;
+
+		// the pawn is lost
+		if ( weakToMove && squareDistance(weakKing,pawn) == 1 && squareDistance(strongKing,pawn) > 1 )
+		{
+			return false;
+		}
+
+		// rook pawn with the defending king in the corner
+		if ( (x == 0 || x == 7) && squareDistance(weakKing,queening) <= 1 )
+		{
+			_score = 0;
+			return true;
+		}
+
+		// rule of the square, and our king isn't in the way
+		const int pawnMoves = (y == 1) ? 5 : 7-y;
+		const bool kingInFront = squareX(strongKing) == x && squareY(strongKing) > y;
+		if ( kingInFront == false && squareDistance(weakKing,queening) - (weakToMove ? 1 : 0) > pawnMoves )
+		{
+			_score = winScore;
+			return true;
+		}
+
+		// key squares, which win whoever is to move
+		if ( x != 0 && x != 7 )
+		{
+			const int keyRank = (y < 4) ? y+2 : y+1;
+			const int dx = squareX(strongKing)-x;
+			const int kingY = squareY(strongKing);
+			if ( dx >= -1 && dx <= 1 && (kingY == keyRank || (y >= 4 && kingY == keyRank+1 && kingY <= 7)) )
+			{
+				_score = winScore;
+				return true;
+			}
+		}
+		return false;
+	}
+
+	// signature of the material written as a string such as "KRKN", with the
+	// strong side's pieces first.
+	inline unsigned long long signatureKey(const std::string& _code, const bool _strong)
+	{
+		MaterialCount material;
+		material.clear();
+
+		bool team = !_strong;
+		for (unsigned int i=0;i<_code.size();++i)
+		{
+			if ( _code[i] == 'K' )
+			{
+				team = !team;
+			}
+			const unsigned char piece = Position::pieceFromChar(_code[i]);
+			++material.count[makePiece(pieceType(piece),team)];
+		}
+		return material.key();
+	}
+}
+
+// Looks up the endgame evaluation for a position's material.
+class EndgameTable
+{
+	struct Entry
+	{
+		Endgame::Function function;
+		bool strong;
+	};
+	std::unordered_map <unsigned long long, Entry> mEntry;
+
+	public:
+
+	EndgameTable()
+	{
+		add("KK",Endgame::drawn);
+		add("KNK",Endgame::drawn);
+		add("KBK",Endgame::drawn);
+		add("KNNK",Endgame::drawn);
+		add("KNKN",Endgame::drawn);
+		add("KBKN",Endgame::drawn);
+		add("KBKB",Endgame::drawn);
+		add("KQK",Endgame::mateLoneKing);
+		add("KRK",Endgame::mateLoneKing);
+		add("KQQK",Endgame::mateLoneKing);
+		add("KQRK",Endgame::mateLoneKing);
+		add("KRRK",Endgame::mateLoneKing);
+		add("KBBK",Endgame::mateTwoBishops);
+		add("KBNK",Endgame::mateBishopKnight);
+		add("KPK",Endgame::kingPawn);
+	}
+
+	// register the function for both colours
+	void add(const std::string& _code, const Endgame::Function _function)
+	{
+		mEntry[Endgame::signatureKey(_code,WHITE)] = {_function,WHITE};
+		mEntry[Endgame::signatureKey(_code,BLACK)] = {_function,BLACK};
+	}
+
+	// returns true if the score for TEAM is known
+	template <bool TEAM> bool probe(const Position& _position, int& _score) const
+	{
+		auto entry = mEntry.find(_position.materialKey);
+		if ( entry != mEntry.end() && entry->second.function(_position,entry->second.strong,_score) )
+		{
+			if ( entry->second.strong != TEAM )
+			{
+				_score = -_score;
+			}
+			return true;
+		}
+		return false;
+	}
+
+	// scale TEAM's score down if the side it favours will find it hard to win
+	template <bool TEAM> int scale(const Position& _position, const MaterialEntry& _material, const int _score) const
+	{
+		if ( _score == 0 )
+		{
+			return 0;
+		}
+		const bool favoured = (_score > 0) ? TEAM : Side<TEAM>::OPPONENT;
+		int factor = _material.scale[favoured];
+
+		// only a bishop each, on different colours
+		if ( (_material.flags & MATERIAL_SINGLE_BISHOPS) && factor > ENDGAME_SCALE_OPPOSITE_BISHOPS )
+		{
+			MaterialCount material;
+			material.set(_position);
+			if ( material.darkBishops[WHITE] != material.darkBishops[BLACK] )
+			{
+				factor = ENDGAME_SCALE_OPPOSITE_BISHOPS;
+			}
+		}
+		return _score*factor/MATERIAL_SCALE_NORMAL;
+	}
+};
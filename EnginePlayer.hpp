@@ -0,0 +1,127 @@
+// A player which chooses its moves with a timed SearchJob, and can ponder:
+// think on the opponent's time about the reply it expects.
+// After playing a move the player searches the position after the expected
+// reply, the second move of its principal variation. If the opponent plays
+// that move the search carries on as a normal timed search, with a head start.
+// If they play something else the search is cancelled at once and a new one
+// started. The transposition table keeps what was found either way.
+
+class EnginePlayer
+{
+	SearchJob job;
+	SearchInfo result;
+
+	// the position being pondered, after the reply we expect, and the game
+	// history up to it. The search has its own copy of the history as the
+	// game's grows while it runs.
+	bool pondering;
+	Position ponderPosition;
+	GameHistory ponderHistory;
+	Move expectedReply;
+
+	public:
+	int nThreads;
+	bool ponderEnabled;
+	unsigned long long nPonderHits;
+	unsigned long long nPonderMisses;
+
+	EnginePlayer(const bool _ponder=true, const int _nThreads=1)
+	{
+		pondering=false;
+		result.nLines=0;
+		nThreads=_nThreads;
+		ponderEnabled=_ponder;
+		nPonderHits=0;
+		nPonderMisses=0;
+	}
+
+	// choose a move for the side to move, thinking for _time milliseconds.
+	// Returns a null move if there is no legal move.
+	Move think(const Position& _position, GameHistory* _history, const long long _time)
+	{
+		if ( pondering )
+		{
+			pondering = false;
+			if ( _position.hash == ponderPosition.hash )
+			{
+				// the search is already on this position
+				++nPonderHits;
+				if ( _time > 0 )
+				{
+					job.release(_time);
+				}
+				else
+				{
+					job.cancel();
+				}
+				job.wait();
+				rememberReply();
+				return result.bestMove;
+			}
+			++nPonderMisses;
+			job.cancel();
+			job.wait();
+		}
+
+		SearchLimits limits;
+		limits.time = _time;
+		job.start(_position,limits,_history,nThreads,SearchJob::Callback(),[this](const SearchInfo& _info)
+		{
+			result = _info;
+		});
+		job.wait();
+		rememberReply();
+		return result.bestMove;
+	}
+
+	// start pondering once our move has been played. _position is the
+	// position after our move, and _history the game before it.
+	void ponder(const Position& _position, GameHistory* _history)
+	{
+		if ( ponderEnabled == false || expectedReply.isNull() )
+		{
+			return;
+		}
+		ponderPosition = _position;
+		if ( (ponderPosition.findMove(expectedReply.from(),expectedReply.to()) == expectedReply) == false )
+		{
+			return;
+		}
+		ponderPosition.makeMove(expectedReply);
+
+		ponderHistory.clear();
+		if ( _history != 0 )
+		{
+			ponderHistory.assign(*_history);
+		}
+		ponderHistory.push(_position.hash);
+
+		SearchLimits limits;
+		limits.infinite = true;
+		job.start(ponderPosition,limits,&ponderHistory,nThreads,SearchJob::Callback(),[this](const SearchInfo& _info)
+		{
+			result = _info;
+		});
+		pondering = true;
+	}
+
+	// the result of the last search think() made
+	const SearchInfo& getResult() const
+	{
+		return result;
+	}
+
+	// stop pondering, at the end of a game
+	void stop()
+	{
+		pondering = false;
+		job.cancel();
+		job.wait();
+	}
+
+	private:
+	void rememberReply()
+	{
+		expectedReply = (result.nLines > 0 && result.aLine[0].nPv >= 2) ? result.aLine[0].aPv[1] : Move();
+	}
+};
@@ -0,0 +1,142 @@
+#include <atomic>
+
+// Cache of static evaluations, keyed by position hash.
+// The same leaf is often reached by different move orders, and evaluating it
+// means counting the legal moves of both sides, so scores are stored here and
+// looked up before evaluating.
+// Each entry is a single 64 bit word holding the upper 32 bits of the key and
+// the score, so it can be read and written atomically without locks. Threads
+// searching in parallel can share one cache. A torn read isn't possible, and
+// a slot overwritten by another thread just fails the key check.
+// Probes and hits are counted per thread, each in its own cache line, and
+// added up when the hit rate is read.
+
+	// default number of entries, must be a power of 2.
+#define EVAL_CACHE_SIZE 65536
+	// number of per thread counters, must be a power of 2. Threads beyond
+	// this share counters, which only makes the hit rate less exact.
+#define EVAL_CACHE_COUNTERS 64
+
+// probes and hits of one thread
+struct alignas(64) EvalCacheCounter
+{
+	std::atomic <unsigned long long> nProbes;
+	std::atomic <unsigned long long> nHits;
+};
+
+class EvalCache
+{
+	std::atomic <unsigned long long> * aEntry;
+	unsigned long long mask;
+	EvalCacheCounter aCounter [EVAL_CACHE_COUNTERS];
+
+	public:
+
+	EvalCache(const unsigned long long _nEntries = EVAL_CACHE_SIZE)
+	{
+		aEntry=0;
+		resize(_nEntries);
+	}
+	~EvalCache()
+	{
+		delete [] aEntry;
+	}
+
+	// resize the cache, rounding down to a power of 2. This clears it, and
+	// must not be called while a search is using it.
+	void resize(unsigned long long _nEntries)
+	{
+		unsigned long long size = 1;
+		while ( size*2 <= _nEntries )
+		{
+			size*=2;
+		}
+
+		delete [] aEntry;
+		aEntry = new std::atomic <unsigned long long> [size];
+		mask = size-1;
+		clear();
+	}
+
+	void clear()
+	{
+		for (unsigned long long i=0;i<=mask;++i)
+		{
+			aEntry[i].store(0,std::memory_order_relaxed);
+		}
+		for (int i=0;i<EVAL_CACHE_COUNTERS;++i)
+		{
+			aCounter[i].nProbes.store(0,std::memory_order_relaxed);
+			aCounter[i].nHits.store(0,std::memory_order_relaxed);
+		}
+	}
+
+	unsigned long long size() const
+	{
+		return mask+1;
+	}
+
+	// look up the score of a position for _team. Returns false if it isn't
+	// stored.
+	bool probe(const unsigned long long _hash, const bool _team, int& _score)
+	{
+		const unsigned long long key = teamKey(_hash,_team);
+		const unsigned long long entry = aEntry[key & mask].load(std::memory_order_relaxed);
+
+		EvalCacheCounter& counter = aCounter[counterIndex()];
+		counter.nProbes.store(counter.nProbes.load(std::memory_order_relaxed)+1,std::memory_order_relaxed);
+
+		if ( (entry >> 32) != (key >> 32) )
+		{
+			return false;
+		}
+		counter.nHits.store(counter.nHits.load(std::memory_order_relaxed)+1,std::memory_order_relaxed);
+		_score = (int)(unsigned int)entry;
+		return true;
+	}
+
+	// store a score, replacing whatever was in the slot.
+	void store(const unsigned long long _hash, const bool _team, const int _score)
+	{
+		const unsigned long long key = teamKey(_hash,_team);
+		const unsigned long long entry = (key & 0xFFFFFFFF00000000ULL) | (unsigned int)_score;
+
+		aEntry[key & mask].store(entry,std::memory_order_relaxed);
+	}
+
+	// percentage of probes which were found in the cache
+	int hitRate() const
+	{
+		unsigned long long probes = 0;
+		unsigned long long hits = 0;
+		for (int i=0;i<EVAL_CACHE_COUNTERS;++i)
+		{
+			probes += aCounter[i].nProbes.load(std::memory_order_relaxed);
+			hits += aCounter[i].nHits.load(std::memory_order_relaxed);
+		}
+		if ( probes == 0 )
+		{
+			return 0;
+		}
+		return (int)(hits*100/probes);
+	}
+
+	private:
+	// the counter of the calling thread. Each thread takes the next one the
+	// first time it probes, so it is the only writer unless there are more
+	// threads than counters. The count is a plain load and store rather than
+	// a locked add, which is enough for a statistic.
+	static int counterIndex()
+	{
+		static std::atomic <int> nThreads(0);
+		thread_local const int index = nThreads.fetch_add(1,std::memory_order_relaxed) & (EVAL_CACHE_COUNTERS-1);
+		return index;
+	}
+
+	// scores are from one team's point of view, so the same position scored
+	// for each team needs a different key.
+	static unsigned long long teamKey(const unsigned long long _hash, const bool _team)
+	{
+		return (_team == WHITE) ? _hash : _hash ^ 0x9E3779B97F4A7C15ULL;
+	}
+};
@@ -0,0 +1,317 @@
+// Static evaluation of a Position.
+// Scores are in pawns, from one team's point of view. Board uses these for the
+// leaves of its tree, and Search and the batch evaluator use them directly.
+
+// positional terms are in tenths of a pawn, and are divided by this before
+// being added to the score. Each move of mobility is worth 1.
+#define POSITIONAL_DIVISOR 10
+
+	// score for giving checkmate
+#define SCORE_CHECKMATE 2000
+
+	// positional weights, in tenths of a pawn
+#define KING_ZONE_ATTACK 2
+#define HANGING_SHARE 5
+#define SPACE_WEIGHT 1
+
+// the 3 ranks in front of each side's back rank, files c to f. Indexed by
+// team.
+constexpr Bitboard SPACE_MASK [2] = {0x003C3C3C00000000ULL,0x000000003C3C3C00ULL};
+
+template <bool TEAM> int getMaterialGap(const MaterialEntry& _material)
+{
+	return (TEAM==WHITE) ? _material.gap : -_material.gap;
+}
+
+// fill in the attacks of any team the attack map doesn't cover yet. The
+// search has usually filled the side to move's already.
+inline void completeAttackMap(const Position& _position, AttackMap& _attacks)
+{
+	if ( _attacks.filled[WHITE] == false )
+	{
+		_position.fillAttacks<WHITE>(_attacks);
+	}
+	if ( _attacks.filled[BLACK] == false )
+	{
+		_position.fillAttacks<BLACK>(_attacks);
+	}
+}
+
+// enemy attacks on the squares around TEAM's king, squares attacked twice
+// counting twice
+template <bool TEAM> int getKingZoneAttacks(const Position& _position, const AttackMap& _attacks)
+{
+	const int king = _position.findKing<TEAM>();
+	if ( king == -1 )
+	{
+		return 0;
+	}
+	const Bitboard zone = kingAttacks(king) | squareBit(king);
+	const bool OPPONENT = Side<TEAM>::OPPONENT;
+	return countSquares(zone & _attacks.all[OPPONENT]) + countSquares(zone & _attacks.twice[OPPONENT]);
+}
+
+// value of TEAM's most valuable piece which can be taken for free: attacked
+// and undefended, or attacked by a pawn.
+template <bool TEAM> int getHangingValue(const Position& _position, const AttackMap& _attacks)
+{
+	const bool OPPONENT = Side<TEAM>::OPPONENT;
+	Bitboard targets = (_attacks.all[OPPONENT] & ~_attacks.all[TEAM]) | _attacks.byPawns[OPPONENT];
+	int best = 0;
+
+	while (targets)
+	{
+		const unsigned char piece = _position.aSquare[popSquare(targets)];
+		if ( piece != 0 && pieceTeam(piece) == TEAM && pieceType(piece) != KING && materialValue(piece) > best )
+		{
+			best = materialValue(piece);
+		}
+	}
+	return best;
+}
+
+// squares behind the middle which TEAM's pawns don't block and the enemy
+// pawns don't attack
+template <bool TEAM> int getSpace(const Position& _position, const AttackMap& _attacks)
+{
+	Bitboard space = SPACE_MASK[TEAM] & ~_attacks.byPawns[Side<TEAM>::OPPONENT];
+	int count = 0;
+	while (space)
+	{
+		if ( _position.aSquare[popSquare(space)] != Side<TEAM>::PAWN )
+		{
+			++count;
+		}
+	}
+	return count;
+}
+
+// calculate the score for this board state based on position
+// this includes check/checkmate. Mobility, king safety, hanging pieces and
+// space all come from the attack map. King safety and space matter less as
+// pieces come off, so they are scaled by the game phase.
+template <bool TEAM> int getPositionalScore(Position& _position, AttackMap& _attacks, const MaterialEntry& _material,
+	EvalTrace* _trace=0)
+{
+	const bool OPPONENT = Side<TEAM>::OPPONENT;
+	completeAttackMap(_position,_attacks);
+
+	// a missing king counts as being in check
+	const int king = _position.findKing<TEAM>();
+	const int enemyKing = _position.findKing<OPPONENT>();
+	const bool inCheck = (king == -1 || (_attacks.all[OPPONENT] & squareBit(king)));
+	const bool enemyInCheck = (enemyKing == -1 || (_attacks.all[TEAM] & squareBit(enemyKing)));
+
+	if (enemyInCheck)
+	{
+		if (_position.hasAnyLegalMove(OPPONENT) == false)
+		{
+			return SCORE_CHECKMATE;
+		}
+		return 100;
+	}
+	if (inCheck)
+	{
+		if (_position.hasAnyLegalMove(TEAM) == false)
+		{
+			return -SCORE_CHECKMATE;
+		}
+		return -10;
+	}
+
+	int positional = _attacks.nMoves[TEAM]-_attacks.nMoves[OPPONENT];
+	positional += (TEAM==WHITE) ? _material.imbalance : -_material.imbalance;
+
+	const int kingZone = getKingZoneAttacks<OPPONENT>(_position,_attacks)-getKingZoneAttacks<TEAM>(_position,_attacks);
+	const int space = getSpace<TEAM>(_position,_attacks)-getSpace<OPPONENT>(_position,_attacks);
+	const int middlegame = kingZone*KING_ZONE_ATTACK + space*SPACE_WEIGHT;
+	positional += middlegame*_material.phase/MATERIAL_PHASE_MAX;
+
+	// the side to move can take a hanging piece, the other side can only
+	// save one of theirs, so only the side waiting to move is penalised.
+	const int hanging = (_position.sideToMove == TEAM) ? getHangingValue<OPPONENT>(_position,_attacks) :
+		-getHangingValue<TEAM>(_position,_attacks);
+	positional += hanging*HANGING_SHARE;
+
+	if ( _trace )
+	{
+		// the phase scaled terms are multiplied by the phase here, and the
+		// tuner divides by MATERIAL_PHASE_MAX
+		_trace->add(TERM_MOBILITY,TEAM,_attacks.nMoves[TEAM]-_attacks.nMoves[OPPONENT]);
+		_trace->add(TERM_KING_ZONE,TEAM,kingZone*_material.phase);
+		_trace->add(TERM_SPACE,TEAM,space*_material.phase);
+		_trace->add(TERM_HANGING,TEAM,hanging);
+	}
+	return positional/POSITIONAL_DIVISOR;
+}
+template <bool TEAM> int getPositionalScore(Position& _position)
+{
+	AttackMap attacks;
+	attacks.clear();
+	return getPositionalScore<TEAM>(_position,attacks,materialTable.probe(_position.materialKey));
+}
+
+// exact score from the tablebases, if there is one for the material. Mates
+// further from the root of a search score lower.
+template <bool TEAM> bool getTablebaseScore(const Position& _position, const int _ply, int& _score)
+{
+	int dtm;
+	if ( tablebases.probe(_position,dtm) == false )
+	{
+		return false;
+	}
+	if ( dtm == TB_DRAW )
+	{
+		_score = 0;
+		return true;
+	}
+	// odd distances are wins for the side to move
+	_score = (dtm % 2 == 1) ? SCORE_CHECKMATE-_ply-dtm : -SCORE_CHECKMATE+_ply+dtm;
+	if ( _position.sideToMove != TEAM )
+	{
+		_score = -_score;
+	}
+	return true;
+}
+
+// score of an endgame the tablebases or the endgame table know. The endgame
+// table's functions don't look for checkmate or stalemate, so that is done
+// here.
+template <bool TEAM> bool getEndgameScore(Position& _position, int& _score)
+{
+	if ( getTablebaseScore<TEAM>(_position,0,_score) )
+	{
+		return true;
+	}
+	if ( endgameTable.probe<TEAM>(_position,_score) == false )
+	{
+		return false;
+	}
+	if ( _position.hasAnyLegalMove(_position.sideToMove) == false )
+	{
+		_score = _position.isCheck(_position.sideToMove) ? -SCORE_CHECKMATE : 0;
+		if ( _position.sideToMove != TEAM )
+		{
+			_score = -_score;
+		}
+	}
+	return true;
+}
+
+// scale a score down for drawish material. Checkmates are left alone.
+template <bool TEAM> int scaleEndgameScore(const Position& _position, const MaterialEntry& _material, const int _score)
+{
+	if ( _score >= SCORE_CHECKMATE/2 || _score <= -SCORE_CHECKMATE/2 )
+	{
+		return _score;
+	}
+	return endgameTable.scale<TEAM>(_position,_material,_score);
+}
+
+// pawn structure and the pawns sheltering the king. The structure is
+// looked up in the pawn hash table, unless it is being traced.
+template <bool TEAM> int getPawnScore(const Position& _position, EvalTrace* _trace=0)
+{
+	PawnEntry traced;
+	if ( _trace )
+	{
+		PawnTable::trace(_position,*_trace,traced);
+	}
+	const PawnEntry& entry = _trace ? traced : pawnTable.probe(_position);
+
+	int pawnScore = (TEAM==WHITE) ? entry.score : -entry.score;
+	pawnScore += pawnShieldScore<TEAM>(entry,_position.findKing<TEAM>(),_trace);
+	pawnScore -= pawnShieldScore<Side<TEAM>::OPPONENT>(entry,_position.findKing<Side<TEAM>::OPPONENT>(),_trace);
+	return pawnScore/PAWN_STRUCTURE_DIVISOR;
+}
+
+// determine an overall score for this board state using various heuristics
+// material gap
+// controlled spaces
+// n covering moves/covered pieces
+// king safety
+// pawn structure (doubled/tripled pawns)
+// minor piece imbalances (knight+bishop vs bishop+bishop)
+// The attack map may already have the side to move's attacks from the move
+// generation done by the search. Everything which depends only on the
+// material comes from one lookup in the material table.
+// With a trace, the count of each term is recorded as well.
+template <bool TEAM> int getHandcraftedScore(Position& _position, AttackMap& _attacks, EvalTrace* _trace=0)
+{
+	int score;
+	if ( getEndgameScore<TEAM>(_position,score) )
+	{
+		return score;
+	}
+	const MaterialEntry material = materialTable.probe(_position.materialKey);
+	if ( _trace )
+	{
+		MaterialTable::trace(_position.materialKey,*_trace);
+	}
+	score = getMaterialGap<TEAM>(material)+getPositionalScore<TEAM>(_position,_attacks,material,_trace)+
+		getPawnScore<TEAM>(_position,_trace);
+	return scaleEndgameScore<TEAM>(_position,material,score);
+}
+template <bool TEAM> int getHandcraftedScore(Position& _position)
+{
+	AttackMap attacks;
+	attacks.clear();
+	return getHandcraftedScore<TEAM>(_position,attacks);
+}
+
+// score from the neural network, in place of the handcrafted terms.
+// Checkmates are still found by search rather than left to the network, and
+// known endgames are still scored by the endgame table.
+template <bool TEAM> int getNetworkScore(Position& _position, const Nnue::Accumulator& _accumulator)
+{
+	if (_position.isCheck<Side<TEAM>::OPPONENT>() && _position.hasAnyLegalMove(Side<TEAM>::OPPONENT) == false)
+	{
+		return SCORE_CHECKMATE;
+	}
+	if (_position.isCheck<TEAM>() && _position.hasAnyLegalMove(TEAM) == false)
+	{
+		return -SCORE_CHECKMATE;
+	}
+
+	int score;
+	if ( getEndgameScore<TEAM>(_position,score) )
+	{
+		return score;
+	}
+
+	// the network scores for the side to move, in hundredths of a pawn.
+	// Rounding to the nearest pawn rather than towards zero keeps scores
+	// from half a pawn up, and treats both sides alike.
+	const int centipawns = network.evaluate(_accumulator,_position.sideToMove);
+	const int networkScore = (centipawns >= 0 ? centipawns+NNUE_CENTIPAWNS_PER_PAWN/2 :
+		centipawns-NNUE_CENTIPAWNS_PER_PAWN/2)/NNUE_CENTIPAWNS_PER_PAWN;
+	return scaleEndgameScore<TEAM>(_position,materialTable.probe(_position.materialKey),
+		(_position.sideToMove == TEAM) ? networkScore : -networkScore);
+}
+
+// the network needs both kings, as its features are relative to them
+inline bool canUseNetwork(const Position& _position)
+{
+	return ( network.isLoaded() && _position.findKing<WHITE>() != -1 &&
+		_position.findKing<BLACK>() != -1 );
+}
+
+// score a position on its own, with the network if there is one
+template <bool TEAM> int evaluate(Position& _position)
+{
+	if ( canUseNetwork(_position) )
+	{
+		Nnue::Accumulator accumulator;
+		network.refresh(_position,accumulator);
+		return getNetworkScore<TEAM>(_position,accumulator);
+	}
+	return getHandcraftedScore<TEAM>(_position);
+}
+inline int evaluate(Position& _position, const bool _team)
+{
+	if ( _team == WHITE )
+	{
+		return evaluate<WHITE>(_position);
+	}
+	return evaluate<BLACK>(_position);
+}
@@ -0,0 +1,471 @@
+#include <algorithm>
+
+// A database of finished games which can be searched by position, for an
+// opening explorer and for finding positions many games share.
+// Games are built from game record files (see GameRecord.hpp). Each move is
+// stored as its index in the legal move list, one byte instead of two, and
+// games are packed in blocks of GAME_DB_BLOCK_GAMES with the offset of each
+// block kept, so any game is found by skipping at most a block's games.
+// Two sorted tables index the positions by Zobrist hash:
+//   move statistics: for each position and move played from it, the number
+//   of games and their results. Move 0 counts games which ended there.
+//   postings: each position with the game and ply it was reached at.
+// The file is memory mapped, and a lookup is a binary search in each table,
+// so queries take milliseconds however many games there are.
+// Moves are decoded with the engine's own move generator, so a change to the
+// order moves are generated in needs a new GAME_DB_VERSION.
+// The database is built in memory. Move statistics are merged as they grow,
+// but there is a posting for every position of every game.
+
+#define GAME_DB_MAGIC "BTDB"
+#define GAME_DB_VERSION 1
+	// games in each block of game data
+#define GAME_DB_BLOCK_GAMES 256
+	// move statistic entries collected before they are merged
+#define GAME_DB_MERGE_EVERY 4000000
+
+struct GameDbHeader
+{
+	char magic [4];
+	unsigned int version;
+	unsigned long long nGames;
+	unsigned long long nBlocks;
+	unsigned long long blocksOffset;
+	unsigned long long nStats;
+	unsigned long long statsOffset;
+	unsigned long long nPostings;
+	unsigned long long postingsOffset;
+};
+
+struct GameDbMoveStat
+{
+	unsigned long long hash;
+	unsigned int nGames;
+	unsigned int whiteWins;
+	unsigned int draws;
+	unsigned int blackWins;
+	unsigned short move; // data of the move played, 0 if the game ended
+	unsigned short padding;
+	unsigned int padding2;
+
+	bool operator<(const GameDbMoveStat& _stat) const
+	{
+		return hash < _stat.hash || (hash == _stat.hash && move < _stat.move);
+	}
+};
+
+struct GameDbPosting
+{
+	unsigned long long hash;
+	unsigned int game;
+	unsigned int ply;
+
+	bool operator<(const GameDbPosting& _posting) const
+	{
+		return hash < _posting.hash || (hash == _posting.hash &&
+			(game < _posting.game || (game == _posting.game && ply < _posting.ply)));
+	}
+};
+
+// a position reached by several games
+struct GameDbDuplicate
+{
+	unsigned long long hash;
+	unsigned int nGames;
+	// the first game and ply it was reached at
+	unsigned int game;
+	unsigned int ply;
+};
+
+// Games are stored as:
+//   varint number of bytes which follow
+//   u8 result, u8 length and the FEN, empty for the start position
+//   one byte for each move, its index among the legal moves
+class GameDatabaseBuilder
+{
+	std::vector <unsigned char> vGameData;
+	std::vector <unsigned long long> vBlockOffset;
+	std::vector <GameDbMoveStat> vStat;
+	size_t nMerged;
+	std::vector <GameDbPosting> vPosting;
+	unsigned long long nGames;
+
+	public:
+	GameDatabaseBuilder()
+	{
+		nMerged=0;
+		nGames=0;
+	}
+
+	unsigned long long size() const
+	{
+		return nGames;
+	}
+
+	// add a game. Returns false if a move in it isn't legal, in which case
+	// the game isn't added.
+	bool add(const GameRecord& _record)
+	{
+		Position start;
+		start.reset();
+		const bool fromStart = _record.getFen() == start.getFen();
+		if ( fromStart == false && start.setFen(_record.getFen()) == false )
+		{
+			return false;
+		}
+
+		// encode the moves first, so a bad game leaves nothing behind
+		std::vector <unsigned char> vMove;
+		Position position = start;
+		for (int i=0;i<_record.size();++i)
+		{
+			MoveList moves;
+			position.generateLegalMoves(moves);
+			int index = 0;
+			while ( index < moves.size() && (moves(index) == _record.getMove(i)) == false )
+			{
+				++index;
+			}
+			if ( index == moves.size() )
+			{
+				return false;
+			}
+			vMove.push_back((unsigned char)index);
+			position.makeMove(moves(index));
+		}
+
+		if ( nGames % GAME_DB_BLOCK_GAMES == 0 )
+		{
+			vBlockOffset.push_back(vGameData.size());
+		}
+		const std::string fen = fromStart ? "" : _record.getFen().substr(0,255);
+		putVarint(vGameData,2+fen.size()+vMove.size());
+		vGameData.push_back((unsigned char)_record.getResult());
+		vGameData.push_back((unsigned char)fen.size());
+		vGameData.insert(vGameData.end(),fen.begin(),fen.end());
+		vGameData.insert(vGameData.end(),vMove.begin(),vMove.end());
+
+		// index every position, with the move played from it
+		position = start;
+		for (int ply=0;ply<=_record.size();++ply)
+		{
+			GameDbPosting posting;
+			posting.hash = position.hash;
+			posting.game = (unsigned int)nGames;
+			posting.ply = ply;
+			vPosting.push_back(posting);
+
+			GameDbMoveStat stat;
+			memset(&stat,0,sizeof(stat));
+			stat.hash = position.hash;
+			stat.move = ply < _record.size() ? _record.getMove(ply).getData() : 0;
+			stat.nGames = 1;
+			stat.whiteWins = _record.getResult() == GAME_WHITE_WINS;
+			stat.draws = _record.getResult() == GAME_DRAW;
+			stat.blackWins = _record.getResult() == GAME_BLACK_WINS;
+			vStat.push_back(stat);
+
+			if ( ply < _record.size() )
+			{
+				position.makeMove(_record.getMove(ply));
+			}
+		}
+		if ( vStat.size()-nMerged >= GAME_DB_MERGE_EVERY )
+		{
+			mergeStats();
+		}
+		++nGames;
+		return true;
+	}
+
+	bool write(const std::string& _path)
+	{
+		mergeStats();
+		std::sort(vPosting.begin(),vPosting.end());
+
+		GameDbHeader header;
+		memset(&header,0,sizeof(header));
+		memcpy(header.magic,GAME_DB_MAGIC,4);
+		header.version = GAME_DB_VERSION;
+		header.nGames = nGames;
+		header.nBlocks = vBlockOffset.size();
+		header.nStats = vStat.size();
+		header.nPostings = vPosting.size();
+
+		// the tables start on 8 byte boundaries so they can be read in place
+		const unsigned long long dataOffset = sizeof(GameDbHeader);
+		header.blocksOffset = align(dataOffset+vGameData.size());
+		header.statsOffset = header.blocksOffset+vBlockOffset.size()*sizeof(unsigned long long);
+		header.postingsOffset = header.statsOffset+vStat.size()*sizeof(GameDbMoveStat);
+		// block offsets are kept from the start of the game data, and are
+		// written from the start of the file
+		std::vector <unsigned long long> vFileOffset(vBlockOffset);
+		for (unsigned long long& offset : vFileOffset)
+		{
+			offset += dataOffset;
+		}
+
+		std::ofstream file(_path,std::ios::binary|std::ios::trunc);
+		if ( file.is_open() == false )
+		{
+			return false;
+		}
+		const char zeros [8] = {0};
+		file.write((const char*)&header,sizeof(header));
+		file.write((const char*)vGameData.data(),vGameData.size());
+		file.write(zeros,header.blocksOffset-dataOffset-vGameData.size());
+		file.write((const char*)vFileOffset.data(),vFileOffset.size()*sizeof(unsigned long long));
+		file.write((const char*)vStat.data(),vStat.size()*sizeof(GameDbMoveStat));
+		file.write((const char*)vPosting.data(),vPosting.size()*sizeof(GameDbPosting));
+		return file.good();
+	}
+
+	private:
+	// sort the statistics and add together entries for the same position
+	// and move
+	void mergeStats()
+	{
+		std::sort(vStat.begin(),vStat.end());
+		size_t end = 0;
+		for (size_t i=0;i<vStat.size();++i)
+		{
+			if ( end > 0 && vStat[end-1].hash == vStat[i].hash && vStat[end-1].move == vStat[i].move )
+			{
+				vStat[end-1].nGames += vStat[i].nGames;
+				vStat[end-1].whiteWins += vStat[i].whiteWins;
+				vStat[end-1].draws += vStat[i].draws;
+				vStat[end-1].blackWins += vStat[i].blackWins;
+			}
+			else
+			{
+				vStat[end++] = vStat[i];
+			}
+		}
+		vStat.resize(end);
+		nMerged = end;
+	}
+	static unsigned long long align(const unsigned long long _offset)
+	{
+		return (_offset+7) & ~7ULL;
+	}
+	static void putVarint(std::vector <unsigned char>& _bytes, unsigned long long _value)
+	{
+		while ( _value >= 128 )
+		{
+			_bytes.push_back((unsigned char)(_value|128));
+			_value >>= 7;
+		}
+		_bytes.push_back((unsigned char)_value);
+	}
+};
+
+// a built database, read from its memory mapped file
+class GameDatabase
+{
+	Tablebase::MappedFile file;
+	GameDbHeader header;
+	const unsigned long long* aBlockOffset;
+	const GameDbMoveStat* aStat;
+	const GameDbPosting* aPosting;
+
+	public:
+	GameDatabase()
+	{
+		memset(&header,0,sizeof(header));
+		aBlockOffset=0;
+		aStat=0;
+		aPosting=0;
+	}
+
+	bool open(const std::string& _path)
+	{
+		if ( file.open(_path) == false || file.getSize() < sizeof(GameDbHeader) )
+		{
+			return false;
+		}
+		memcpy(&header,file.bytes(),sizeof(header));
+		if ( memcmp(header.magic,GAME_DB_MAGIC,4) != 0 || header.version != GAME_DB_VERSION ||
+			file.getSize() < header.postingsOffset+header.nPostings*sizeof(GameDbPosting) )
+		{
+			file.close();
+			return false;
+		}
+		aBlockOffset = (const unsigned long long*)(file.bytes()+header.blocksOffset);
+		aStat = (const GameDbMoveStat*)(file.bytes()+header.statsOffset);
+		aPosting = (const GameDbPosting*)(file.bytes()+header.postingsOffset);
+		return true;
+	}
+
+	unsigned long long size() const
+	{
+		return header.nGames;
+	}
+	unsigned long long countPositions() const
+	{
+		return header.nPostings;
+	}
+
+	// the moves played from the position, most played first
+	std::vector <GameDbMoveStat> getMoveStats(const unsigned long long _hash) const
+	{
+		GameDbMoveStat key;
+		memset(&key,0,sizeof(key));
+		key.hash = _hash;
+		const GameDbMoveStat* first = std::lower_bound(aStat,aStat+header.nStats,key);
+		std::vector <GameDbMoveStat> vStat;
+		for (const GameDbMoveStat* stat=first;stat<aStat+header.nStats && stat->hash == _hash;++stat)
+		{
+			vStat.push_back(*stat);
+		}
+		std::stable_sort(vStat.begin(),vStat.end(),[](const GameDbMoveStat& _a, const GameDbMoveStat& _b)
+		{
+			return _a.nGames > _b.nGames;
+		});
+		return vStat;
+	}
+
+	// up to _max games reaching the position, with the ply they reach it
+	std::vector <GameDbPosting> getGames(const unsigned long long _hash, const size_t _max) const
+	{
+		GameDbPosting key;
+		key.hash = _hash;
+		key.game = 0;
+		key.ply = 0;
+		std::vector <GameDbPosting> vGame;
+		for (const GameDbPosting* posting=std::lower_bound(aPosting,aPosting+header.nPostings,key);
+			posting<aPosting+header.nPostings && posting->hash == _hash && vGame.size() < _max;++posting)
+		{
+			// a game may reach the position more than once
+			if ( vGame.empty() || vGame.back().game != posting->game )
+			{
+				vGame.push_back(*posting);
+			}
+		}
+		return vGame;
+	}
+
+	// read a game back as a record
+	bool getGame(const unsigned long long _game, GameRecord& _record) const
+	{
+		if ( _game >= header.nGames )
+		{
+			return false;
+		}
+		const unsigned char* data = file.bytes()+aBlockOffset[_game/GAME_DB_BLOCK_GAMES];
+		unsigned long long length = readVarint(data);
+		for (unsigned long long i=0;i<_game%GAME_DB_BLOCK_GAMES;++i)
+		{
+			data += length;
+			length = readVarint(data);
+		}
+
+		const int result = data[0];
+		const int fenLength = data[1];
+		Position position;
+		position.reset();
+		if ( fenLength > 0 && position.setFen(std::string((const char*)data+2,fenLength)) == false )
+		{
+			return false;
+		}
+		_record.begin(position,"","");
+		for (unsigned long long i=2+fenLength;i<length;++i)
+		{
+			MoveList moves;
+			position.generateLegalMoves(moves);
+			if ( data[i] >= moves.size() )
+			{
+				return false;
+			}
+			const Move move = moves(data[i]);
+			_record.addMove(move);
+			position.makeMove(move);
+		}
+		_record.finish(result);
+		return true;
+	}
+
+	// the position after _ply plies of a game
+	bool getPosition(const unsigned long long _game, const int _ply, Position& _position) const
+	{
+		GameRecord record;
+		if ( getGame(_game,record) == false || _ply > record.size() )
+		{
+			return false;
+		}
+		_position.reset();
+		if ( _position.setFen(record.getFen()) == false )
+		{
+			return false;
+		}
+		for (int i=0;i<_ply;++i)
+		{
+			_position.makeMove(record.getMove(i));
+		}
+		return true;
+	}
+
+	// the _count positions reached by the most games, not counting those any
+	// game reaches before _minPly, such as the start position and openings
+	std::vector <GameDbDuplicate> findDuplicates(const size_t _count, const unsigned int _minPly) const
+	{
+		std::vector <GameDbDuplicate> vDuplicate;
+		auto fewerGames = [](const GameDbDuplicate& _a, const GameDbDuplicate& _b)
+		{
+			return _a.nGames > _b.nGames;
+		};
+
+		unsigned long long i = 0;
+		while ( i < header.nPostings )
+		{
+			GameDbDuplicate duplicate;
+			duplicate.hash = aPosting[i].hash;
+			duplicate.nGames = 0;
+			duplicate.game = aPosting[i].game;
+			duplicate.ply = aPosting[i].ply;
+			unsigned int minPly = aPosting[i].ply;
+			unsigned int lastGame = 0;
+			for (;i<header.nPostings && aPosting[i].hash == duplicate.hash;++i)
+			{
+				if ( duplicate.nGames == 0 || aPosting[i].game != lastGame )
+				{
+					++duplicate.nGames;
+					lastGame = aPosting[i].game;
+				}
+				minPly = std::min(minPly,aPosting[i].ply);
+			}
+			if ( duplicate.nGames < 2 || minPly < _minPly )
+			{
+				continue;
+			}
+
+			// keep the best _count as a heap with the fewest games on top
+			if ( vDuplicate.size() < _count )
+			{
+				vDuplicate.push_back(duplicate);
+				std::push_heap(vDuplicate.begin(),vDuplicate.end(),fewerGames);
+			}
+			else if ( _count > 0 && duplicate.nGames > vDuplicate.front().nGames )
+			{
+				std::pop_heap(vDuplicate.begin(),vDuplicate.end(),fewerGames);
+				vDuplicate.back() = duplicate;
+				std::push_heap(vDuplicate.begin(),vDuplicate.end(),fewerGames);
+			}
+		}
+		std::sort_heap(vDuplicate.begin(),vDuplicate.end(),fewerGames);
+		return vDuplicate;
+	}
+
+	private:
+	static unsigned long long readVarint(const unsigned char*& _data)
+	{
+		unsigned long long value = 0;
+		int shift = 0;
+		while ( *_data & 128 )
+		{
+			value |= (unsigned long long)(*_data++ & 127) << shift;
+			shift += 7;
+		}
+		value |= (unsigned long long)(*_data++) << shift;
+		return value;
+	}
+};
@@ -0,0 +1,55 @@
+// Hashes of the positions which came before the current one in a game.
+// Boards search back through their parents and then through this to find
+// repeated positions.
+
+	// a game is drawn after this many plies without a capture or pawn move
+#define FIFTY_MOVE_PLIES 100
+
+class GameHistory
+{
+	Vector <unsigned long long> vHash;
+
+	public:
+	void clear()
+	{
+		vHash.clear();
+	}
+	void push(const unsigned long long _hash)
+	{
+		vHash.push(_hash);
+	}
+	int size()
+	{
+		return vHash.size();
+	}
+	// copy another history, for a search which mustn't see it change
+	void assign(GameHistory& _history)
+	{
+		vHash.clear();
+		for (int i=0;i<_history.vHash.size();++i)
+		{
+			vHash.push(_history.vHash(i));
+		}
+	}
+
+	// count the positions matching _hash, looking back no more than _plies
+	// plies. _plyOffset is how many plies ago the most recent entry was
+	// played, so only positions with the same side to move are compared.
+	int countMatches(const unsigned long long _hash, const int _plies, const int _plyOffset=1)
+	{
+		int count=0;
+		for (int i=1; i<=vHash.size(); ++i)
+		{
+			const int distance = _plyOffset+i-1;
+			if ( distance > _plies )
+			{
+				break;
+			}
+			if ( distance%2 == 0 && vHash(vHash.size()-i) == _hash )
+			{
+				++count;
+			}
+		}
+		return count;
+	}
+};
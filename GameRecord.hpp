@@ -0,0 +1,548 @@
+#include <condition_variable>
+#include <fstream>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Games stored compactly, so many can be logged at once and read back later.
+// A record holds the starting position, the players, the result and each
+// move in 16 bits, optionally with the score, depth and time of the search
+// which chose it. A long game takes a few KB at most.
+// Finished records are handed to a GameRecordWriter, which appends them to a
+// file on its own thread, so game threads never wait for the disk.
+// A file starts with GAME_RECORD_MAGIC and a version byte, then each game:
+//   u32 size of the rest of the record
+//   u8 result, u8 flags
+//   u8 length and the FEN, the same for the white and black player names
+//   u16 number of moves
+//   each move as u16, followed if annotated by the score in centipawns (i16),
+//   the depth (u8) and the time in milliseconds (u16)
+// Numbers are little endian.
+
+#define GAME_RECORD_MAGIC "BTGR"
+#define GAME_RECORD_VERSION 1
+	// record flags
+#define GAME_RECORD_ANNOTATED 1
+	// score of a move which wasn't chosen by a search
+#define GAME_RECORD_NO_SCORE -32768
+	// stored scores beyond this are mates, GAME_RECORD_MATE less the plies
+	// to mate
+#define GAME_RECORD_MATE 32000
+	// bytes collected before the writer thread writes them out
+#define GAME_WRITER_BUFFER 65536
+	// the longest the writer thread holds data before writing it
+#define GAME_WRITER_INTERVAL_MS 1000
+
+	// game results
+#define GAME_UNFINISHED 0
+#define GAME_WHITE_WINS 1
+#define GAME_BLACK_WINS 2
+#define GAME_DRAW 3
+
+// the result of the game if it is over in this position: checkmate,
+// stalemate, the fifty move rule, threefold repetition or too little material
+// to mate. _history holds the positions before this one.
+inline int adjudicate(Position& _position, GameHistory& _history)
+{
+	if ( _position.hasAnyLegalMove(_position.sideToMove) == false )
+	{
+		if ( _position.isCheck(_position.sideToMove) )
+		{
+			return _position.sideToMove == WHITE ? GAME_BLACK_WINS : GAME_WHITE_WINS;
+		}
+		return GAME_DRAW;
+	}
+	if ( _position.halfmoveClock >= FIFTY_MOVE_PLIES ||
+		_history.countMatches(_position.hash,_position.halfmoveClock) >= 2 ||
+		(materialTable.probe(_position.materialKey).flags & MATERIAL_CANNOT_MATE) )
+	{
+		return GAME_DRAW;
+	}
+	return GAME_UNFINISHED;
+}
+
+// a legal move in standard algebraic notation, such as Nbd7, exd5 or O-O
+inline std::string moveToSan(Position& _position, const Move& _move)
+{
+	std::string san;
+	const int type = pieceType(_position.aSquare[_move.from()]);
+	const bool capture = _position.aSquare[_move.to()] != 0 || _move.type() == MOVE_EN_PASSANT;
+
+	if ( _move.type() == MOVE_CASTLE )
+	{
+		san = squareX(_move.to()) == 6 ? "O-O" : "O-O-O";
+	}
+	else if ( type == PAWN )
+	{
+		if ( capture )
+		{
+			san += (char)('a'+squareX(_move.from()));
+			san += 'x';
+		}
+		san += (char)('a'+squareX(_move.to()));
+		san += (char)('1'+squareY(_move.to()));
+		if ( _move.type() == MOVE_PROMOTION )
+		{
+			san += "=Q";
+		}
+	}
+	else
+	{
+		san += " PNBRQK"[type];
+
+		// name the file, rank or both if another piece of the same kind
+		// could move to the same square
+		MoveList moves;
+		_position.generateLegalMoves(moves);
+		bool ambiguous = false, sameFile = false, sameRank = false;
+		for (int i=0;i<moves.size();++i)
+		{
+			const Move other = moves(i);
+			if ( other.to() == _move.to() && other.from() != _move.from() &&
+				pieceType(_position.aSquare[other.from()]) == type )
+			{
+				ambiguous = true;
+				sameFile |= squareX(other.from()) == squareX(_move.from());
+				sameRank |= squareY(other.from()) == squareY(_move.from());
+			}
+		}
+		if ( ambiguous && (sameFile == false || sameRank) )
+		{
+			san += (char)('a'+squareX(_move.from()));
+		}
+		if ( ambiguous && sameFile )
+		{
+			san += (char)('1'+squareY(_move.from()));
+		}
+		if ( capture )
+		{
+			san += 'x';
+		}
+		san += (char)('a'+squareX(_move.to()));
+		san += (char)('1'+squareY(_move.to()));
+	}
+
+	Position after = _position;
+	after.makeMove(_move);
+	if ( after.isCheck(after.sideToMove) )
+	{
+		san += after.hasAnyLegalMove(after.sideToMove) ? '+' : '#';
+	}
+	return san;
+}
+
+class GameRecord
+{
+	std::string fen;
+	std::string white;
+	std::string black;
+	int result;
+	bool annotated;
+	// the moves and their annotations as they are stored
+	std::vector <unsigned char> vMoveData;
+	int nMoves;
+
+	public:
+	GameRecord()
+	{
+		result=GAME_UNFINISHED;
+		annotated=false;
+		nMoves=0;
+	}
+
+	// start recording a game from _position. With _annotated each move
+	// keeps its search score, depth and time.
+	void begin(const Position& _position, const std::string& _white, const std::string& _black,
+		const bool _annotated=false)
+	{
+		fen = _position.getFen();
+		white = _white.substr(0,255);
+		black = _black.substr(0,255);
+		result = GAME_UNFINISHED;
+		annotated = _annotated;
+		vMoveData.clear();
+		nMoves = 0;
+	}
+
+	// _score is in pawns, for the side which made the move
+	void addMove(const Move& _move, const int _score=GAME_RECORD_NO_SCORE, const int _depth=0, const long long _time=0)
+	{
+		putShort(vMoveData,_move.getData());
+		if ( annotated )
+		{
+			int centipawns = GAME_RECORD_NO_SCORE;
+			if ( _score != GAME_RECORD_NO_SCORE && (_score > SCORE_MATE_BOUND || _score < -SCORE_MATE_BOUND) )
+			{
+				const int plies = SCORE_CHECKMATE-(_score > 0 ? _score : -_score);
+				centipawns = _score > 0 ? GAME_RECORD_MATE-plies : plies-GAME_RECORD_MATE;
+			}
+			else if ( _score != GAME_RECORD_NO_SCORE )
+			{
+				centipawns = clamp(_score*100,-(GAME_RECORD_MATE-MAX_PLY),GAME_RECORD_MATE-MAX_PLY);
+			}
+			putShort(vMoveData,(unsigned short)centipawns);
+			vMoveData.push_back((unsigned char)clamp(_depth,0,255));
+			putShort(vMoveData,(unsigned short)clamp(_time,0,65535));
+		}
+		++nMoves;
+	}
+
+	void finish(const int _result)
+	{
+		result = _result;
+	}
+
+	int size() const
+	{
+		return nMoves;
+	}
+	int getResult() const
+	{
+		return result;
+	}
+	bool isAnnotated() const
+	{
+		return annotated;
+	}
+	const std::string& getFen() const
+	{
+		return fen;
+	}
+	const std::string& getWhite() const
+	{
+		return white;
+	}
+	const std::string& getBlack() const
+	{
+		return black;
+	}
+	Move getMove(const int _index) const
+	{
+		return Move::fromData(getShort(&vMoveData[_index*moveSize()]));
+	}
+	// in centipawns, or GAME_RECORD_NO_SCORE. Mates are stored as
+	// GAME_RECORD_MATE less the plies to mate.
+	int getScore(const int _index) const
+	{
+		return annotated ? (short)getShort(&vMoveData[_index*moveSize()+2]) : GAME_RECORD_NO_SCORE;
+	}
+	int getDepth(const int _index) const
+	{
+		return annotated ? vMoveData[_index*moveSize()+4] : 0;
+	}
+	// milliseconds
+	int getTime(const int _index) const
+	{
+		return annotated ? getShort(&vMoveData[_index*moveSize()+5]) : 0;
+	}
+
+	// append the record in the file format
+	void write(std::vector <unsigned char>& _bytes) const
+	{
+		const size_t start = _bytes.size();
+		putInt(_bytes,0);
+		_bytes.push_back((unsigned char)result);
+		_bytes.push_back(annotated ? GAME_RECORD_ANNOTATED : 0);
+		putString(_bytes,fen);
+		putString(_bytes,white);
+		putString(_bytes,black);
+		putShort(_bytes,(unsigned short)nMoves);
+		_bytes.insert(_bytes.end(),vMoveData.begin(),vMoveData.end());
+
+		const unsigned int size = (unsigned int)(_bytes.size()-start-4);
+		for (int i=0;i<4;++i)
+		{
+			_bytes[start+i] = (unsigned char)(size>>(8*i));
+		}
+	}
+
+	// read a record written by write(), without its size. Returns false if
+	// it is malformed.
+	bool read(const unsigned char* _data, const size_t _size)
+	{
+		size_t at = 0;
+		if ( _size < 2 )
+		{
+			return false;
+		}
+		result = _data[at++];
+		annotated = (_data[at++] & GAME_RECORD_ANNOTATED) != 0;
+		if ( getString(_data,_size,at,fen) == false || getString(_data,_size,at,white) == false ||
+			getString(_data,_size,at,black) == false || at+2 > _size )
+		{
+			return false;
+		}
+		nMoves = getShort(_data+at);
+		at += 2;
+		if ( at+(size_t)nMoves*moveSize() != _size )
+		{
+			return false;
+		}
+		vMoveData.assign(_data+at,_data+_size);
+		return true;
+	}
+
+	// the game in PGN, with the search's score, depth and time as comments
+	// on annotated moves
+	std::string toPgn() const
+	{
+		Position position;
+		position.reset();
+		const bool fromStart = fen == position.getFen();
+		if ( fromStart == false && position.setFen(fen) == false )
+		{
+			return "";
+		}
+
+		std::string pgn = "[Event \"BigThink game\"]\n[Site \"?\"]\n[Date \"????.??.??\"]\n[Round \"?\"]\n";
+		pgn += "[White \""+(white.empty() ? std::string("?") : white)+"\"]\n";
+		pgn += "[Black \""+(black.empty() ? std::string("?") : black)+"\"]\n";
+		pgn += "[Result \""+resultText()+"\"]\n";
+		if ( fromStart == false )
+		{
+			pgn += "[SetUp \"1\"]\n[FEN \""+fen+"\"]\n";
+		}
+		pgn += "\n";
+
+		std::string line;
+		int moveNumber = 1;
+		for (int i=0;i<nMoves;++i)
+		{
+			const Move move = getMove(i);
+			if ( (position.findMove(move.from(),move.to()) == move) == false )
+			{
+				break;
+			}
+			std::string text;
+			if ( position.sideToMove == WHITE )
+			{
+				text = std::to_string(moveNumber)+". ";
+			}
+			else if ( i == 0 )
+			{
+				text = std::to_string(moveNumber)+"... ";
+			}
+			text += moveToSan(position,move);
+			const int score = getScore(i);
+			if ( score != GAME_RECORD_NO_SCORE )
+			{
+				char comment [64];
+				if ( score > GAME_RECORD_MATE-MAX_PLY || score < MAX_PLY-GAME_RECORD_MATE )
+				{
+					const int plies = GAME_RECORD_MATE-(score > 0 ? score : -score);
+					snprintf(comment,sizeof(comment)," {%sM%d/%d %dms}",score > 0 ? "+" : "-",(plies+1)/2,getDepth(i),getTime(i));
+				}
+				else
+				{
+					snprintf(comment,sizeof(comment)," {%+.2f/%d %dms}",score/100.0,getDepth(i),getTime(i));
+				}
+				text += comment;
+			}
+
+			if ( position.sideToMove == BLACK )
+			{
+				++moveNumber;
+			}
+			position.makeMove(move);
+			addPgnText(pgn,line,text);
+		}
+		addPgnText(pgn,line,resultText());
+		return pgn+line+"\n\n";
+	}
+
+	std::string resultText() const
+	{
+		return result == GAME_WHITE_WINS ? "1-0" : result == GAME_BLACK_WINS ? "0-1" : result == GAME_DRAW ? "1/2-1/2" : "*";
+	}
+
+	private:
+	int moveSize() const
+	{
+		return annotated ? 7 : 2;
+	}
+	static long long clamp(const long long _value, const long long _min, const long long _max)
+	{
+		return _value < _min ? _min : (_value > _max ? _max : _value);
+	}
+	static void putShort(std::vector <unsigned char>& _bytes, const unsigned short _value)
+	{
+		_bytes.push_back((unsigned char)_value);
+		_bytes.push_back((unsigned char)(_value>>8));
+	}
+	static void putInt(std::vector <unsigned char>& _bytes, const unsigned int _value)
+	{
+		putShort(_bytes,(unsigned short)_value);
+		putShort(_bytes,(unsigned short)(_value>>16));
+	}
+	static void putString(std::vector <unsigned char>& _bytes, const std::string& _text)
+	{
+		const size_t length = _text.size() < 255 ? _text.size() : 255;
+		_bytes.push_back((unsigned char)length);
+		_bytes.insert(_bytes.end(),_text.begin(),_text.begin()+length);
+	}
+	static unsigned short getShort(const unsigned char* _data)
+	{
+		return _data[0] | (_data[1]<<8);
+	}
+	static bool getString(const unsigned char* _data, const size_t _size, size_t& _at, std::string& _text)
+	{
+		if ( _at >= _size || _at+1+_data[_at] > _size )
+		{
+			return false;
+		}
+		_text.assign((const char*)_data+_at+1,_data[_at]);
+		_at += 1+_data[_at];
+		return true;
+	}
+	// PGN lines are kept under 80 characters
+	static void addPgnText(std::string& _pgn, std::string& _line, const std::string& _text)
+	{
+		if ( _line.empty() == false && _line.size()+1+_text.size() > 79 )
+		{
+			_pgn += _line+"\n";
+			_line.clear();
+		}
+		_line += (_line.empty() ? "" : " ")+_text;
+	}
+};
+
+// appends game records to a file from a background thread
+class GameRecordWriter
+{
+	std::ofstream file;
+	std::thread thread;
+	std::mutex mutex;
+	std::condition_variable wake;
+	// records waiting to be written
+	std::vector <unsigned char> vPending;
+	bool closing;
+
+	public:
+	unsigned long long nGames;
+
+	GameRecordWriter()
+	{
+		closing=false;
+		nGames=0;
+	}
+	~GameRecordWriter()
+	{
+		close();
+	}
+
+	// open a record file for appending, starting it if it is new or empty
+	bool open(const std::string& _path)
+	{
+		close();
+		file.open(_path,std::ios::binary|std::ios::app|std::ios::ate);
+		if ( file.is_open() == false )
+		{
+			return false;
+		}
+		if ( file.tellp() == 0 )
+		{
+			file.write(GAME_RECORD_MAGIC,4);
+			file.put((char)GAME_RECORD_VERSION);
+		}
+		closing = false;
+		nGames = 0;
+		thread = std::thread(&GameRecordWriter::run,this);
+		return true;
+	}
+
+	// queue a finished game. This only copies its bytes, so it is quick and
+	// safe from any thread.
+	void write(const GameRecord& _record)
+	{
+		std::vector <unsigned char> bytes;
+		_record.write(bytes);
+		std::lock_guard <std::mutex> lock(mutex);
+		vPending.insert(vPending.end(),bytes.begin(),bytes.end());
+		++nGames;
+		if ( vPending.size() >= GAME_WRITER_BUFFER )
+		{
+			wake.notify_one();
+		}
+	}
+
+	// write everything queued and close the file
+	void close()
+	{
+		if ( thread.joinable() )
+		{
+			{
+				std::lock_guard <std::mutex> lock(mutex);
+				closing = true;
+			}
+			wake.notify_one();
+			thread.join();
+		}
+		if ( file.is_open() )
+		{
+			file.close();
+		}
+	}
+
+	private:
+	void run()
+	{
+		std::vector <unsigned char> vWriting;
+		std::unique_lock <std::mutex> lock(mutex);
+		while (true)
+		{
+			wake.wait_for(lock,std::chrono::milliseconds(GAME_WRITER_INTERVAL_MS),[this]()
+			{
+				return closing || vPending.size() >= GAME_WRITER_BUFFER;
+			});
+			const bool last = closing;
+			vWriting.swap(vPending);
+			lock.unlock();
+
+			if ( vWriting.empty() == false )
+			{
+				file.write((const char*)vWriting.data(),vWriting.size());
+				file.flush();
+				vWriting.clear();
+			}
+			if ( last )
+			{
+				return;
+			}
+			lock.lock();
+		}
+	}
+};
+
+// reads the games in a record file in order
+class GameRecordReader
+{
+	std::ifstream file;
+	std::vector <unsigned char> vBuffer;
+
+	public:
+	bool open(const std::string& _path)
+	{
+		file.open(_path,std::ios::binary);
+		char magic [5] = {0};
+		file.read(magic,5);
+		return file.good() && memcmp(magic,GAME_RECORD_MAGIC,4) == 0 && magic[4] == GAME_RECORD_VERSION;
+	}
+
+	// read the next game, returning false at the end of the file or if a
+	// record is malformed
+	bool next(GameRecord& _record)
+	{
+		unsigned char header [4];
+		if ( file.read((char*)header,4).good() == false )
+		{
+			return false;
+		}
+		const unsigned int size = header[0] | (header[1]<<8) | (header[2]<<16) | ((unsigned int)header[3]<<24);
+		vBuffer.resize(size);
+		if ( size == 0 || file.read((char*)vBuffer.data(),size).good() == false )
+		{
+			return false;
+		}
+		return _record.read(vBuffer.data(),size);
+	}
+};
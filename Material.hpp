@@ -0,0 +1,275 @@
+// Material, looked up by the material key.
+// Position keeps a count of each piece in its material key, updated as moves
+// are made. Everything the evaluation needs to know about the material alone
+// is worked out once for every combination of pieces and kept in a table, so
+// an evaluation gets the material gap, the imbalance terms, the game phase
+// and whether anyone can still mate from a single lookup.
+
+	// imbalance terms, in tenths of a pawn
+#define MATERIAL_BISHOP_PAIR 5
+	// for each knight or rook and each pawn over 5, in eighths of a tenth
+#define MATERIAL_KNIGHT_PAWN 5
+#define MATERIAL_ROOK_PAWN -10
+#define MATERIAL_IMBALANCE_DIVISOR 8
+	// total phase with every piece on the board. Knights and bishops count 1,
+	// rooks 2 and queens 4.
+#define MATERIAL_PHASE_MAX 24
+	// scale factors are out of MATERIAL_SCALE_NORMAL
+#define MATERIAL_SCALE_NORMAL 64
+#define MATERIAL_SCALE_NO_PAWNS 8
+	// flags
+#define MATERIAL_CANNOT_MATE 1
+#define MATERIAL_SINGLE_BISHOPS 2 // a bishop each and no other pieces
+
+// number of a piece in a material key
+constexpr int materialCount(const unsigned long long _key, const unsigned char _piece)
+{
+	return (_key >> (4*pieceIndex(_piece))) & 15;
+}
+
+// number of pieces in a material key, including the kings
+inline int pieceTotal(unsigned long long _key)
+{
+	int total = 0;
+	for (;_key;_key >>= 4)
+	{
+		total += _key & 15;
+	}
+	return total;
+}
+
+// number of each piece on the board, indexed by piece code
+struct MaterialCount
+{
+	unsigned char count [16];
+	unsigned char darkBishops [2]; // indexed by team
+
+	void clear()
+	{
+		memset(this,0,sizeof(MaterialCount));
+	}
+	// the counts from a material key. The bishops' colours aren't known.
+	void setKey(const unsigned long long _key)
+	{
+		clear();
+		for (int piece=0;piece<16;++piece)
+		{
+			if ( pieceType(piece) != NO_PIECE && pieceType(piece) != 7 )
+			{
+				count[piece] = materialCount(_key,piece);
+			}
+		}
+		count[0] = 64-pieceTotal(_key);
+	}
+	void set(const Position& _position)
+	{
+		clear();
+		for (int square=0;square<64;++square)
+		{
+			const unsigned char piece = _position.aSquare[square];
+			++count[piece];
+			if ( pieceType(piece) == BISHOP && ((squareX(square)+squareY(square)) & 1) == 0 )
+			{
+				++darkBishops[pieceTeam(piece)];
+			}
+		}
+	}
+	int of(const int _type, const bool _team) const
+	{
+		return count[makePiece(_type,_team)];
+	}
+	// pieces other than the king and pawns
+	int pieces(const bool _team) const
+	{
+		return of(KNIGHT,_team)+of(BISHOP,_team)+of(ROOK,_team)+of(QUEEN,_team);
+	}
+	int material(const bool _team) const
+	{
+		int value = 0;
+		for (int type=PAWN;type<KING;++type)
+		{
+			value += of(type,_team)*PIECE_VALUE[type];
+		}
+		return value;
+	}
+	// the same as Position::materialKey
+	unsigned long long key() const
+	{
+		unsigned long long key = 0;
+		for (int piece=0;piece<16;++piece)
+		{
+			if ( pieceType(piece) != NO_PIECE && pieceType(piece) != 7 )
+			{
+				key += count[piece]*materialBit(piece);
+			}
+		}
+		return key;
+	}
+};
+
+struct MaterialEntry
+{
+	short gap; // white's material minus black's, in pawns
+	signed char imbalance; // from white's point of view, in tenths of a pawn
+	unsigned char phase; // 0 with only pawns left, MATERIAL_PHASE_MAX at the start
+	unsigned char flags;
+	unsigned char nPieces;
+	unsigned char scale [2]; // for a score favouring each team
+};
+
+class MaterialTable
+{
+	// the number of each piece the table covers. Positions with more, which
+	// need promotions, are worked out when they are looked up.
+	static constexpr int RANGE[6] = {0,9,3,3,3,2};
+	static constexpr int SIDE_SIZE = 9*3*3*3*2;
+
+	MaterialEntry* aEntry;
+
+	public:
+	MaterialTable()
+	{
+		aEntry = new MaterialEntry [SIDE_SIZE*SIDE_SIZE];
+		for (int index=0;index<SIDE_SIZE*SIDE_SIZE;++index)
+		{
+			aEntry[index] = compute(keyOf(index));
+		}
+	}
+	~MaterialTable()
+	{
+		delete [] aEntry;
+	}
+
+	MaterialEntry probe(const unsigned long long _key) const
+	{
+		const int index = indexOf(_key);
+		if ( index == -1 )
+		{
+			return compute(_key);
+		}
+		return aEntry[index];
+	}
+
+	// record the material terms of a key
+	static void trace(const unsigned long long _key, EvalTrace& _trace)
+	{
+		MaterialCount material;
+		material.setKey(_key);
+		for (int team=0;team<2;++team)
+		{
+			for (int type=PAWN;type<KING;++type)
+			{
+				_trace.add(TERM_PAWN+type-PAWN,team,material.of(type,team));
+			}
+			getImbalance(material,team,&_trace);
+		}
+	}
+
+	private:
+	// the table index of a key, or -1 if it isn't in the table
+	static int indexOf(const unsigned long long _key)
+	{
+		int index = 0;
+		for (int team=1;team>=0;--team)
+		{
+			if ( materialCount(_key,makePiece(KING,team)) != 1 )
+			{
+				return -1;
+			}
+			for (int type=PAWN;type<KING;++type)
+			{
+				const int count = materialCount(_key,makePiece(type,team));
+				if ( count >= RANGE[type] )
+				{
+					return -1;
+				}
+				index = index*RANGE[type]+count;
+			}
+		}
+		return index;
+	}
+	static unsigned long long keyOf(int _index)
+	{
+		unsigned long long key = 0;
+		for (int team=0;team<2;++team)
+		{
+			key += materialBit(makePiece(KING,team));
+			for (int type=KING-1;type>=PAWN;--type)
+			{
+				key += (_index % RANGE[type])*materialBit(makePiece(type,team));
+				_index /= RANGE[type];
+			}
+		}
+		return key;
+	}
+
+	static MaterialEntry compute(const unsigned long long _key)
+	{
+		MaterialCount material;
+		material.setKey(_key);
+
+		MaterialEntry entry;
+		entry.gap = material.material(WHITE)-material.material(BLACK) +
+			(material.of(KING,WHITE)-material.of(KING,BLACK))*PIECE_VALUE[KING];
+		entry.imbalance = getImbalance(material,WHITE)-getImbalance(material,BLACK);
+		entry.nPieces = pieceTotal(_key);
+
+		int phase = 0;
+		for (int team=0;team<2;++team)
+		{
+			phase += material.of(KNIGHT,team)+material.of(BISHOP,team)+material.of(ROOK,team)*2+material.of(QUEEN,team)*4;
+		}
+		entry.phase = phase < MATERIAL_PHASE_MAX ? phase : MATERIAL_PHASE_MAX;
+
+		entry.flags = 0;
+		if ( canMate(material,WHITE) == false && canMate(material,BLACK) == false )
+		{
+			entry.flags |= MATERIAL_CANNOT_MATE;
+		}
+		if ( material.pieces(WHITE) == 1 && material.pieces(BLACK) == 1 &&
+			material.of(BISHOP,WHITE) == 1 && material.of(BISHOP,BLACK) == 1 )
+		{
+			entry.flags |= MATERIAL_SINGLE_BISHOPS;
+		}
+		entry.scale[WHITE] = getScale(material,WHITE);
+		entry.scale[BLACK] = getScale(material,BLACK);
+		return entry;
+	}
+
+	// the bishop pair, and knights getting better and rooks worse the more
+	// pawns there are
+	static int getImbalance(const MaterialCount& _material, const bool _team, EvalTrace* _trace=0)
+	{
+		const int extraPawns = _material.of(PAWN,_team)-5;
+		const bool bishopPair = _material.of(BISHOP,_team) >= 2;
+		if ( _trace )
+		{
+			_trace->add(TERM_BISHOP_PAIR,_team,bishopPair);
+			_trace->add(TERM_KNIGHT_PAWNS,_team,_material.of(KNIGHT,_team)*extraPawns);
+			_trace->add(TERM_ROOK_PAWNS,_team,_material.of(ROOK,_team)*extraPawns);
+		}
+		int imbalance = bishopPair ? MATERIAL_BISHOP_PAIR : 0;
+		imbalance += (_material.of(KNIGHT,_team)*extraPawns*MATERIAL_KNIGHT_PAWN +
+			_material.of(ROOK,_team)*extraPawns*MATERIAL_ROOK_PAWN)/MATERIAL_IMBALANCE_DIVISOR;
+		return imbalance;
+	}
+
+	// the same rules Board used to check one piece at a time
+	static bool canMate(const MaterialCount& _material, const bool _team)
+	{
+		return ( _material.of(PAWN,_team) > 0 || _material.of(QUEEN,_team) > 0 || _material.of(ROOK,_team) > 0 ||
+			_material.of(BISHOP,_team) >= 2 || (_material.of(BISHOP,_team) > 0 && _material.of(KNIGHT,_team) > 0) );
+	}
+
+	// how likely _strong is to turn an advantage into a win. Without pawns a
+	// minor piece more isn't enough, and a minor piece alone can't mate.
+	static int getScale(const MaterialCount& _material, const bool _strong)
+	{
+		if ( _material.of(PAWN,_strong) == 0 &&
+			_material.material(_strong)-_material.material(!_strong) <= PIECE_VALUE[BISHOP] )
+		{
+			return _material.material(_strong) <= PIECE_VALUE[BISHOP] ? 0 : MATERIAL_SCALE_NO_PAWNS;
+		}
+		return MATERIAL_SCALE_NORMAL;
+	}
+};
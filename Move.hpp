@@ -0,0 +1,103 @@
+// Moves are stored as plain values so they can be generated and tested
+// without building a Board for each one.
+
+	// special move types
+#define MOVE_NORMAL 0
+#define MOVE_DOUBLE_PAWN 1
+#define MOVE_EN_PASSANT 2
+#define MOVE_CASTLE 3
+#define MOVE_PROMOTION 4
+
+// A move packed into 16 bits: from square (6 bits), to square (6 bits) and
+// a special move type (4 bits). Squares are indexed as x + y*8.
+class Move
+{
+	unsigned short data;
+
+	public:
+	Move()
+	{
+		data=0;
+	}
+	Move(const int _from, const int _to, const int _type=MOVE_NORMAL)
+	{
+		data = _from | (_to << 6) | (_type << 12);
+	}
+	// a move from the value returned by getData()
+	static Move fromData(const unsigned short _data)
+	{
+		Move move;
+		move.data = _data;
+		return move;
+	}
+
+	int from() const
+	{
+		return data & 63;
+	}
+	int to() const
+	{
+		return (data >> 6) & 63;
+	}
+	int type() const
+	{
+		return data >> 12;
+	}
+	unsigned short getData() const
+	{
+		return data;
+	}
+	bool operator==(const Move& _move) const
+	{
+		return data == _move.data;
+	}
+	bool isNull() const
+	{
+		return data == 0;
+	}
+	// coordinate notation such as e2e4, used by UCI. Promotions are always
+	// to a queen.
+	std::string toString() const
+	{
+		std::string text;
+		text += (char)('a'+squareX(from()));
+		text += (char)('1'+squareY(from()));
+		text += (char)('a'+squareX(to()));
+		text += (char)('1'+squareY(to()));
+		if ( type() == MOVE_PROMOTION )
+		{
+			text += 'q';
+		}
+		return text;
+	}
+};
+
+// Fixed size move list. 218 is the most moves possible from one position.
+class MoveList
+{
+	Move aMove [256];
+	int nMoves;
+
+	public:
+	MoveList()
+	{
+		nMoves=0;
+	}
+
+	void push(const Move& _move)
+	{
+		aMove[nMoves++]=_move;
+	}
+	int size() const
+	{
+		return nMoves;
+	}
+	void clear()
+	{
+		nMoves=0;
+	}
+	Move& operator()(const int _index)
+	{
+		return aMove[_index];
+	}
+};
@@ -0,0 +1,298 @@
+#include <fstream>
+
+// Efficiently updatable neural network evaluation (NNUE).
+// The first layer is sparse: each input feature is a (king square, piece,
+// square) triple, seen from one side's point of view, so only about 30 of the
+// 40960 inputs are on. Its output, the accumulator, is the sum of the weight
+// rows of the active features. A move only turns a few features on or off, so
+// a substate's accumulator is its parent's plus/minus a few rows. The parent
+// keeps its own accumulator, so taking a move back costs nothing.
+// The accumulator then goes through 2 small dense layers and an output neuron.
+// Those weights are int8, so a layer's weights fit in a few cache lines. The
+// kernels are in NnueKernels.hpp and are picked for the CPU when the network
+// is made.
+
+// The weights are read from a binary file:
+//  "BTNN" magic, version (int32)
+//  feature weights int16 [NNUE_FEATURES][NNUE_HIDDEN], feature biases int16 [NNUE_HIDDEN]
+//  layer 1 weights int8 [NNUE_L2][NNUE_HIDDEN*2], biases int32 [NNUE_L2]
+//  layer 2 weights int8 [NNUE_L3][NNUE_L2], biases int32 [NNUE_L3]
+//  output weights int8 [NNUE_L3], bias int32
+// all little endian. If there is no file the handcrafted evaluation is used.
+
+#define NNUE_MAGIC 0x4E4E5442
+#define NNUE_VERSION 2
+#define NNUE_FILE "bigthink.nnue"
+
+	// 64 king squares * 10 piece kinds (5 types * own/enemy) * 64 squares
+#define NNUE_FEATURES 40960
+#define NNUE_HIDDEN 128
+#define NNUE_L2 32
+#define NNUE_L3 32
+
+	// dense layer sums are shifted right by this before clipping
+#define NNUE_WEIGHT_SHIFT 6
+	// the output is in hundredths of a pawn after dividing by this
+#define NNUE_OUTPUT_SCALE 16
+	// the evaluation works in whole pawns, so network scores are rounded to
+	// the nearest multiple of this
+#define NNUE_CENTIPAWNS_PER_PAWN 100
+
+namespace Nnue
+{
+	// first layer output for both points of view, indexed by team
+	struct Accumulator
+	{
+		short value [2][NNUE_HIDDEN];
+	};
+
+	// the square as seen from _perspective's side of the board
+	constexpr int orient(const bool _perspective, const int _square)
+	{
+		return _perspective==WHITE ? _square : _square^56;
+	}
+
+	// index of the input feature for a piece on a square, seen by _perspective
+	// whose king is on _kingSquare. Kings are not features.
+	constexpr int featureIndex(const bool _perspective, const int _kingSquare, const unsigned char _piece, const int _square)
+	{
+		return orient(_perspective,_kingSquare)*640 +
+			((pieceType(_piece)-1)*2 + (pieceTeam(_piece)==_perspective ? 0 : 1))*64 +
+			orient(_perspective,_square);
+	}
+
+	static_assert(featureIndex(BLACK,toSquare(7,7),WQUEEN,toSquare(0,0)) < NNUE_FEATURES, "feature index");
+
+	class Network
+	{
+		short* featureWeights; // [NNUE_FEATURES][NNUE_HIDDEN]
+		short featureBias [NNUE_HIDDEN];
+		signed char l1Weights [NNUE_L2][NNUE_HIDDEN*2];
+		int l1Bias [NNUE_L2];
+		signed char l2Weights [NNUE_L3][NNUE_L2];
+		int l2Bias [NNUE_L3];
+		signed char outputWeights [NNUE_L3];
+		int outputBias;
+
+		bool loaded;
+		Kernels kernels;
+
+		public:
+		Network()
+		{
+			featureWeights=0;
+			loaded=false;
+			kernels=getKernels(detectSimd());
+		}
+		~Network()
+		{
+			delete [] featureWeights;
+		}
+
+		bool isLoaded() const
+		{
+			return loaded;
+		}
+
+		eSimd getSimd() const
+		{
+			return kernels.simd;
+		}
+		// use a different set of kernels, for example the scalar ones to
+		// check the others against.
+		void setSimd(const eSimd _simd)
+		{
+			kernels=getKernels(_simd);
+		}
+
+		// read the weights from a file. Returns false if there is no valid
+		// network there, in which case the evaluator stays off.
+		bool load(const std::string& _path)
+		{
+			loaded=false;
+
+			std::ifstream file(_path,std::ios::binary);
+			if ( !file )
+			{
+				return false;
+			}
+
+			int header[2] = {0,0};
+			file.read((char*)header,sizeof(header));
+			if ( header[0] != NNUE_MAGIC || header[1] != NNUE_VERSION )
+			{
+				std::cout<<"Network file "<<_path<<" has the wrong format.\n";
+				return false;
+			}
+
+			if ( featureWeights == 0 )
+			{
+				featureWeights = new short [NNUE_FEATURES*NNUE_HIDDEN];
+			}
+			file.read((char*)featureWeights,sizeof(short)*NNUE_FEATURES*NNUE_HIDDEN);
+			file.read((char*)featureBias,sizeof(featureBias));
+			file.read((char*)l1Weights,sizeof(l1Weights));
+			file.read((char*)l1Bias,sizeof(l1Bias));
+			file.read((char*)l2Weights,sizeof(l2Weights));
+			file.read((char*)l2Bias,sizeof(l2Bias));
+			file.read((char*)outputWeights,sizeof(outputWeights));
+			file.read((char*)&outputBias,sizeof(outputBias));
+
+			if ( !file )
+			{
+				std::cout<<"Network file "<<_path<<" is truncated.\n";
+				return false;
+			}
+			loaded=true;
+
+			if ( checkKernels() == false )
+			{
+				std::cout<<"Warning: "<<simdName(kernels.simd)<<" network kernels don't match the scalar ones, using scalar.\n";
+				setSimd(SIMD_SCALAR);
+			}
+			return true;
+		}
+
+		// make sure the selected kernels give the same score as the scalar
+		// reference kernels on the starting position.
+		bool checkKernels()
+		{
+			const Kernels selected = kernels;
+			Position position;
+			position.reset();
+
+			Accumulator accumulator;
+			refresh(position,accumulator);
+			const int score = evaluate(accumulator,WHITE);
+
+			Accumulator referenceAccumulator;
+			setSimd(SIMD_SCALAR);
+			refresh(position,referenceAccumulator);
+			const int referenceScore = evaluate(referenceAccumulator,WHITE);
+			kernels = selected;
+
+			return ( score == referenceScore &&
+				memcmp(&accumulator,&referenceAccumulator,sizeof(Accumulator)) == 0 );
+		}
+
+		const short* featureRow(const int _feature) const
+		{
+			return featureWeights + _feature*NNUE_HIDDEN;
+		}
+
+		// build one side's accumulator from scratch
+		void refresh(const Position& _position, const bool _perspective, Accumulator& _accumulator) const
+		{
+			short* value = _accumulator.value[_perspective];
+			const int king = (_perspective==WHITE) ? _position.findKing<WHITE>() : _position.findKing<BLACK>();
+
+			memcpy(value,featureBias,sizeof(featureBias));
+			for (int square=0;square<64;++square)
+			{
+				const unsigned char piece = _position.aSquare[square];
+				if ( piece != 0 && pieceType(piece) != KING )
+				{
+					kernels.addRow(value,featureRow(featureIndex(_perspective,king,piece,square)),NNUE_HIDDEN);
+				}
+			}
+		}
+		void refresh(const Position& _position, Accumulator& _accumulator) const
+		{
+			refresh(_position,WHITE,_accumulator);
+			refresh(_position,BLACK,_accumulator);
+		}
+
+		// work out a position's accumulator from the one before the move.
+		// The squares which differ give the features to turn off and on. If a
+		// king moved, that side's features all change and it is rebuilt.
+		void update(const Accumulator& _before, const Position& _positionBefore,
+			const Position& _positionAfter, Accumulator& _after) const
+		{
+			_after = _before;
+
+			// find the squares which changed, and check if a king moved
+			int aChanged [64];
+			int nChanged = 0;
+			bool kingMoved [2] = {false,false};
+
+			for (int square=0;square<64;++square)
+			{
+				const unsigned char removed = _positionBefore.aSquare[square];
+				const unsigned char added = _positionAfter.aSquare[square];
+
+				if ( removed != added )
+				{
+					aChanged[nChanged++] = square;
+					if ( pieceType(removed) == KING )
+					{
+						kingMoved[pieceTeam(removed)] = true;
+					}
+					if ( pieceType(added) == KING )
+					{
+						kingMoved[pieceTeam(added)] = true;
+					}
+				}
+			}
+
+			for (int perspective=0;perspective<2;++perspective)
+			{
+				const bool team = perspective;
+
+				if ( kingMoved[team] )
+				{
+					refresh(_positionAfter,team,_after);
+					continue;
+				}
+
+				const int kingSquare = (team==WHITE) ? _positionAfter.findKing<WHITE>() : _positionAfter.findKing<BLACK>();
+				short* value = _after.value[team];
+
+				for (int i=0;i<nChanged;++i)
+				{
+					const int square = aChanged[i];
+					const unsigned char removed = _positionBefore.aSquare[square];
+					const unsigned char added = _positionAfter.aSquare[square];
+
+					// the other side's king isn't a feature either
+					if ( removed != 0 && pieceType(removed) != KING )
+					{
+						kernels.subtractRow(value,featureRow(featureIndex(team,kingSquare,removed,square)),NNUE_HIDDEN);
+					}
+					if ( added != 0 && pieceType(added) != KING )
+					{
+						kernels.addRow(value,featureRow(featureIndex(team,kingSquare,added,square)),NNUE_HIDDEN);
+					}
+				}
+			}
+		}
+
+		// score for the side to move, in hundredths of a pawn
+		int evaluate(const Accumulator& _accumulator, const bool _sideToMove) const
+		{
+			// the side to move's half of the accumulator comes first
+			unsigned char input [NNUE_HIDDEN*2];
+			kernels.clippedRelu(_accumulator.value[_sideToMove],input,NNUE_HIDDEN);
+			kernels.clippedRelu(_accumulator.value[!_sideToMove],input+NNUE_HIDDEN,NNUE_HIDDEN);
+
+			unsigned char hidden1 [NNUE_L2];
+			denseLayer(input,NNUE_HIDDEN*2,&l1Weights[0][0],l1Bias,hidden1,NNUE_L2);
+
+			unsigned char hidden2 [NNUE_L3];
+			denseLayer(hidden1,NNUE_L2,&l2Weights[0][0],l2Bias,hidden2,NNUE_L3);
+
+			return (outputBias + kernels.dot(hidden2,outputWeights,NNUE_L3)) / NNUE_OUTPUT_SCALE;
+		}
+
+		private:
+		// fully connected layer followed by a clipped relu
+		void denseLayer(const unsigned char* _input, const int _nInput, const signed char* _weights,
+			const int* _bias, unsigned char* _output, const int _nOutput) const
+		{
+			for (int i=0;i<_nOutput;++i)
+			{
+				const int sum = (_bias[i] + kernels.dot(_input,_weights+i*_nInput,_nInput)) >> NNUE_WEIGHT_SHIFT;
+				_output[i] = sum < 0 ? 0 : (sum > NNUE_ACTIVATION_MAX ? NNUE_ACTIVATION_MAX : sum);
+			}
+		}
+	};
+}
@@ -0,0 +1,291 @@
+// Integer kernels for the neural network, and picking them at runtime.
+// The feature layer is int16, the dense layers multiply uint8 activations by
+// int8 weights with int32 sums. There is a version of each kernel for VNNI
+// (AVX-512 VNNI on 256 bit vectors), AVX2 and SSE4.1, and a plain scalar one
+// which gives the same results and is used to check them. The instruction set
+// is found with cpuid when the program starts, so one executable runs the
+// fastest kernels each machine supports.
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+	#define NNUE_X86
+	#include <immintrin.h>
+	#if defined(_MSC_VER)
+		#include <intrin.h>
+	#else
+		#include <cpuid.h>
+	#endif
+#endif
+
+// GCC and clang need to be told a function may use an instruction set the rest
+// of the program isn't compiled for. MSVC allows any intrinsic anywhere.
+#if defined(__GNUC__)
+	#define NNUE_TARGET(_features) __attribute__((target(_features)))
+#else
+	#define NNUE_TARGET(_features)
+#endif
+
+	// activations are clipped to 0..NNUE_ACTIVATION_MAX
+#define NNUE_ACTIVATION_MAX 127
+
+namespace Nnue
+{
+	enum eSimd
+	{
+		SIMD_SCALAR=0,
+		SIMD_SSE41=1,
+		SIMD_AVX2=2,
+		SIMD_VNNI=3
+	};
+
+	inline const char* simdName(const eSimd _simd)
+	{
+		static const char* NAME[4] = {"scalar","SSE4.1","AVX2","VNNI"};
+		return NAME[_simd];
+	}
+
+	// the best instruction set this CPU and operating system support
+	inline eSimd detectSimd()
+	{
+	#if defined(NNUE_X86)
+		unsigned int leaf1[4] = {0,0,0,0};
+		unsigned int leaf7[4] = {0,0,0,0};
+		unsigned long long xcr0 = 0;
+
+	#if defined(_MSC_VER)
+		int regs[4];
+		__cpuidex(regs,0,0);
+		const unsigned int maxLeaf = regs[0];
+		__cpuidex(regs,1,0);
+		for (int i=0;i<4;++i) { leaf1[i]=regs[i]; }
+		if ( maxLeaf >= 7 )
+		{
+			__cpuidex(regs,7,0);
+			for (int i=0;i<4;++i) { leaf7[i]=regs[i]; }
+		}
+		if ( leaf1[2] & (1u << 27) )
+		{
+			xcr0 = _xgetbv(0);
+		}
+	#else
+		const unsigned int maxLeaf = __get_cpuid_max(0,0);
+		__cpuid_count(1,0,leaf1[0],leaf1[1],leaf1[2],leaf1[3]);
+		if ( maxLeaf >= 7 )
+		{
+			__cpuid_count(7,0,leaf7[0],leaf7[1],leaf7[2],leaf7[3]);
+		}
+		if ( leaf1[2] & (1u << 27) )
+		{
+			// xgetbv, the operating system must save the vector registers
+			unsigned int eax, edx;
+			__asm__ ("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+			xcr0 = ((unsigned long long)edx << 32) | eax;
+		}
+	#endif
+
+		const bool sse41 = (leaf1[2] & (1u << 19)) != 0;
+		const bool avxState = (xcr0 & 0x6) == 0x6;
+		const bool avx512State = (xcr0 & 0xE6) == 0xE6;
+		const bool avx2 = avxState && (leaf1[2] & (1u << 28)) && (leaf7[1] & (1u << 5));
+		const bool vnni = avx2 && avx512State && (leaf7[1] & (1u << 31)) && (leaf7[2] & (1u << 11));
+
+		if ( vnni )
+		{
+			return SIMD_VNNI;
+		}
+		if ( avx2 )
+		{
+			return SIMD_AVX2;
+		}
+		if ( sse41 )
+		{
+			return SIMD_SSE41;
+		}
+	#endif
+		return SIMD_SCALAR;
+	}
+
+	// Scalar reference kernels.
+
+	// add or subtract a feature weight row. _size is a multiple of 16.
+	inline void addRowScalar(short* _accumulator, const short* _row, const int _size)
+	{
+		for (int i=0;i<_size;++i)
+		{
+			_accumulator[i] += _row[i];
+		}
+	}
+	inline void subtractRowScalar(short* _accumulator, const short* _row, const int _size)
+	{
+		for (int i=0;i<_size;++i)
+		{
+			_accumulator[i] -= _row[i];
+		}
+	}
+	// clamp to 0..NNUE_ACTIVATION_MAX. _size is a multiple of 32.
+	inline void clippedReluScalar(const short* _input, unsigned char* _output, const int _size)
+	{
+		for (int i=0;i<_size;++i)
+		{
+			_output[i] = _input[i] < 0 ? 0 : (_input[i] > NNUE_ACTIVATION_MAX ? NNUE_ACTIVATION_MAX : _input[i]);
+		}
+	}
+	// dot product of activations and weights. _size is a multiple of 32.
+	inline int dotScalar(const unsigned char* _input, const signed char* _weights, const int _size)
+	{
+		int sum = 0;
+		for (int i=0;i<_size;++i)
+		{
+			sum += _input[i]*_weights[i];
+		}
+		return sum;
+	}
+
+#if defined(NNUE_X86)
+	// SSE4.1
+
+	NNUE_TARGET("sse4.1") inline void addRowSse41(short* _accumulator, const short* _row, const int _size)
+	{
+		for (int i=0;i<_size;i+=8)
+		{
+			__m128i a = _mm_loadu_si128((const __m128i*)(_accumulator+i));
+			a = _mm_add_epi16(a,_mm_loadu_si128((const __m128i*)(_row+i)));
+			_mm_storeu_si128((__m128i*)(_accumulator+i),a);
+		}
+	}
+	NNUE_TARGET("sse4.1") inline void subtractRowSse41(short* _accumulator, const short* _row, const int _size)
+	{
+		for (int i=0;i<_size;i+=8)
+		{
+			__m128i a = _mm_loadu_si128((const __m128i*)(_accumulator+i));
+			a = _mm_sub_epi16(a,_mm_loadu_si128((const __m128i*)(_row+i)));
+			_mm_storeu_si128((__m128i*)(_accumulator+i),a);
+		}
+	}
+	NNUE_TARGET("sse4.1") inline void clippedReluSse41(const short* _input, unsigned char* _output, const int _size)
+	{
+		const __m128i top = _mm_set1_epi16(NNUE_ACTIVATION_MAX);
+		for (int i=0;i<_size;i+=16)
+		{
+			// packus clips below 0, so only the top needs clipping first
+			const __m128i a = _mm_min_epi16(_mm_loadu_si128((const __m128i*)(_input+i)),top);
+			const __m128i b = _mm_min_epi16(_mm_loadu_si128((const __m128i*)(_input+i+8)),top);
+			_mm_storeu_si128((__m128i*)(_output+i),_mm_packus_epi16(a,b));
+		}
+	}
+	NNUE_TARGET("sse4.1") inline int dotSse41(const unsigned char* _input, const signed char* _weights, const int _size)
+	{
+		// maddubs can't overflow as activations are at most 127
+		const __m128i ones = _mm_set1_epi16(1);
+		__m128i sum = _mm_setzero_si128();
+		for (int i=0;i<_size;i+=16)
+		{
+			const __m128i product = _mm_maddubs_epi16(
+				_mm_loadu_si128((const __m128i*)(_input+i)),
+				_mm_loadu_si128((const __m128i*)(_weights+i)));
+			sum = _mm_add_epi32(sum,_mm_madd_epi16(product,ones));
+		}
+		sum = _mm_add_epi32(sum,_mm_shuffle_epi32(sum,0x4E));
+		sum = _mm_add_epi32(sum,_mm_shuffle_epi32(sum,0xB1));
+		return _mm_cvtsi128_si32(sum);
+	}
+
+	// AVX2
+
+	NNUE_TARGET("avx2") inline void addRowAvx2(short* _accumulator, const short* _row, const int _size)
+	{
+		for (int i=0;i<_size;i+=16)
+		{
+			__m256i a = _mm256_loadu_si256((const __m256i*)(_accumulator+i));
+			a = _mm256_add_epi16(a,_mm256_loadu_si256((const __m256i*)(_row+i)));
+			_mm256_storeu_si256((__m256i*)(_accumulator+i),a);
+		}
+	}
+	NNUE_TARGET("avx2") inline void subtractRowAvx2(short* _accumulator, const short* _row, const int _size)
+	{
+		for (int i=0;i<_size;i+=16)
+		{
+			__m256i a = _mm256_loadu_si256((const __m256i*)(_accumulator+i));
+			a = _mm256_sub_epi16(a,_mm256_loadu_si256((const __m256i*)(_row+i)));
+			_mm256_storeu_si256((__m256i*)(_accumulator+i),a);
+		}
+	}
+	NNUE_TARGET("avx2") inline void clippedReluAvx2(const short* _input, unsigned char* _output, const int _size)
+	{
+		const __m256i top = _mm256_set1_epi16(NNUE_ACTIVATION_MAX);
+		for (int i=0;i<_size;i+=32)
+		{
+			const __m256i a = _mm256_min_epi16(_mm256_loadu_si256((const __m256i*)(_input+i)),top);
+			const __m256i b = _mm256_min_epi16(_mm256_loadu_si256((const __m256i*)(_input+i+16)),top);
+			// packus works within each 128 bit lane, so put the lanes back in order
+			const __m256i packed = _mm256_permute4x64_epi64(_mm256_packus_epi16(a,b),0xD8);
+			_mm256_storeu_si256((__m256i*)(_output+i),packed);
+		}
+	}
+	NNUE_TARGET("avx2") inline int horizontalSumAvx2(const __m256i _sum)
+	{
+		__m128i half = _mm_add_epi32(_mm256_castsi256_si128(_sum),_mm256_extracti128_si256(_sum,1));
+		half = _mm_add_epi32(half,_mm_shuffle_epi32(half,0x4E));
+		half = _mm_add_epi32(half,_mm_shuffle_epi32(half,0xB1));
+		return _mm_cvtsi128_si32(half);
+	}
+	NNUE_TARGET("avx2") inline int dotAvx2(const unsigned char* _input, const signed char* _weights, const int _size)
+	{
+		const __m256i ones = _mm256_set1_epi16(1);
+		__m256i sum = _mm256_setzero_si256();
+		for (int i=0;i<_size;i+=32)
+		{
+			const __m256i product = _mm256_maddubs_epi16(
+				_mm256_loadu_si256((const __m256i*)(_input+i)),
+				_mm256_loadu_si256((const __m256i*)(_weights+i)));
+			sum = _mm256_add_epi32(sum,_mm256_madd_epi16(product,ones));
+		}
+		return horizontalSumAvx2(sum);
+	}
+
+	// VNNI does the multiply and both additions in one instruction
+
+	NNUE_TARGET("avx2,avx512vl,avx512vnni") inline int dotVnni(const unsigned char* _input, const signed char* _weights, const int _size)
+	{
+		__m256i sum = _mm256_setzero_si256();
+		for (int i=0;i<_size;i+=32)
+		{
+			sum = _mm256_dpbusd_epi32(sum,
+				_mm256_loadu_si256((const __m256i*)(_input+i)),
+				_mm256_loadu_si256((const __m256i*)(_weights+i)));
+		}
+		return horizontalSumAvx2(sum);
+	}
+#endif
+
+	// the kernels used for one instruction set
+	struct Kernels
+	{
+		eSimd simd;
+		void (*addRow)(short*, const short*, int);
+		void (*subtractRow)(short*, const short*, int);
+		void (*clippedRelu)(const short*, unsigned char*, int);
+		int (*dot)(const unsigned char*, const signed char*, int);
+	};
+
+	inline Kernels getKernels(const eSimd _simd)
+	{
+		Kernels kernels = {SIMD_SCALAR,addRowScalar,subtractRowScalar,clippedReluScalar,dotScalar};
+
+	#if defined(NNUE_X86)
+		if ( _simd == SIMD_SSE41 )
+		{
+			kernels = {SIMD_SSE41,addRowSse41,subtractRowSse41,clippedReluSse41,dotSse41};
+		}
+		else if ( _simd == SIMD_AVX2 )
+		{
+			kernels = {SIMD_AVX2,addRowAvx2,subtractRowAvx2,clippedReluAvx2,dotAvx2};
+		}
+		else if ( _simd == SIMD_VNNI )
+		{
+			// VNNI only speeds up the dense layers
+			kernels = {SIMD_VNNI,addRowAvx2,subtractRowAvx2,clippedReluAvx2,dotVnni};
+		}
+	#endif
+		return kernels;
+	}
+}
@@ -0,0 +1,267 @@
+// Pawn structure evaluation.
+// Doubled, isolated, backward and passed pawns are found with bitboard masks.
+// The pawns rarely change between one node and the next, so the result is
+// stored in a hash table keyed by the pawn-only Zobrist key (Position::pawnHash)
+// and most evaluations are a single lookup.
+
+// the pawn structure score is in tenths of a pawn, and is divided by this
+// before being added to the score.
+#define PAWN_STRUCTURE_DIVISOR 10
+
+// number of entries in the pawn hash table, must be a power of 2.
+#define PAWN_TABLE_SIZE 16384
+
+	// penalties and bonuses, in tenths of a pawn
+#define PAWN_DOUBLED 2
+#define PAWN_ISOLATED 2
+#define PAWN_BACKWARD 1
+#define PAWN_SHIELD_NEAR 2
+#define PAWN_SHIELD_FAR 1
+
+namespace PawnMasks
+{
+	// passed pawn bonus by rank, counted from the pawn's own side
+	constexpr int PASSED_BONUS[8] = {0,1,1,2,4,7,10,0};
+
+	struct Masks
+	{
+		Bitboard file [8];
+		// the files either side of a file
+		Bitboard adjacentFiles [8];
+		// indexed by team (BLACK=0, WHITE=1) then square:
+		// squares in front of the pawn on its own file
+		Bitboard forwardFile [2][64];
+		// squares in front of the pawn on its own and adjacent files. A pawn
+		// is passed if there are no enemy pawns here.
+		Bitboard passed [2][64];
+		// squares on the adjacent files level with or behind the pawn. A pawn
+		// with no friendly pawns here can't be defended by one.
+		Bitboard support [2][64];
+		// squares 1 and 2 ranks in front of the king on its own and adjacent
+		// files.
+		Bitboard shieldNear [2][64];
+		Bitboard shieldFar [2][64];
+	};
+
+	constexpr Masks buildMasks()
+	{
+		Masks m {};
+		for (int x=0;x<8;++x)
+		{
+			for (int y=0;y<8;++y)
+			{
+				m.file[x] |= squareBit(toSquare(x,y));
+			}
+		}
+		for (int x=0;x<8;++x)
+		{
+			m.adjacentFiles[x] = (x>0 ? m.file[x-1] : 0) | (x<7 ? m.file[x+1] : 0);
+		}
+
+		for (int square=0;square<64;++square)
+		{
+			const int x = squareX(square);
+			const int y = squareY(square);
+
+			for (int team=0;team<2;++team)
+			{
+				const int forward = (team==1) ? 1 : -1;
+
+				for (int y2=0;y2<8;++y2)
+				{
+					const bool ahead = (y2-y)*forward > 0;
+					const Bitboard rank = Tables::offsetBit(x,y2);
+					const Bitboard adjacentRank = Tables::offsetBit(x-1,y2) | Tables::offsetBit(x+1,y2);
+
+					if ( ahead )
+					{
+						m.forwardFile[team][square] |= rank;
+						m.passed[team][square] |= rank | adjacentRank;
+					}
+					else
+					{
+						m.support[team][square] |= adjacentRank;
+					}
+					if ( y2 == y+forward )
+					{
+						m.shieldNear[team][square] |= rank | adjacentRank;
+					}
+					if ( y2 == y+forward*2 )
+					{
+						m.shieldFar[team][square] |= rank | adjacentRank;
+					}
+				}
+			}
+		}
+		return m;
+	}
+
+	constexpr Masks MASKS = buildMasks();
+
+	// all squares attacked by a set of TEAM's pawns
+	template <bool TEAM> constexpr Bitboard pawnAttacksAll(const Bitboard _pawns)
+	{
+		return TEAM==WHITE ?
+			((_pawns & ~MASKS.file[0]) << 7) | ((_pawns & ~MASKS.file[7]) << 9) :
+			((_pawns & ~MASKS.file[0]) >> 9) | ((_pawns & ~MASKS.file[7]) >> 7);
+	}
+}
+
+static_assert(PawnMasks::MASKS.passed[WHITE][toSquare(0,6)] == (squareBit(toSquare(0,7)) | squareBit(toSquare(1,7))), "passed mask");
+static_assert(PawnMasks::pawnAttacksAll<WHITE>(squareBit(toSquare(0,1))) == pawnAttacks(WHITE,toSquare(0,1)), "pawn attack shift");
+static_assert(PawnMasks::pawnAttacksAll<BLACK>(squareBit(toSquare(7,6))) == pawnAttacks(BLACK,toSquare(7,6)), "pawn attack shift");
+
+struct PawnEntry
+{
+	unsigned long long key;
+	Bitboard pawns [2]; // indexed by team
+	Bitboard passed [2];
+	int score; // from white's point of view, in tenths of a pawn
+};
+
+// The table starts zeroed. That is the correct entry for a position with no
+// pawns, whose pawn hash is 0, so empty slots need no special case.
+class PawnTable
+{
+	PawnEntry aEntry [PAWN_TABLE_SIZE];
+
+	public:
+	unsigned long long nProbes;
+	unsigned long long nHits;
+
+	PawnTable()
+	{
+		clear();
+	}
+
+	void clear()
+	{
+		memset(aEntry,0,sizeof(aEntry));
+		nProbes=0;
+		nHits=0;
+	}
+
+	// return the pawn structure of the position, evaluating it if it isn't
+	// already stored.
+	const PawnEntry& probe(const Position& _position)
+	{
+		PawnEntry& entry = aEntry[_position.pawnHash & (PAWN_TABLE_SIZE-1)];
+		++nProbes;
+
+		if ( entry.key == _position.pawnHash )
+		{
+			++nHits;
+			return entry;
+		}
+
+		setPawns(entry,_position);
+		entry.score = evaluate<WHITE>(entry) - evaluate<BLACK>(entry);
+		return entry;
+	}
+
+	// evaluate the pawn structure without the table, recording the terms
+	static void trace(const Position& _position, EvalTrace& _trace, PawnEntry& _entry)
+	{
+		setPawns(_entry,_position);
+		_entry.score = evaluate<WHITE>(_entry,&_trace) - evaluate<BLACK>(_entry,&_trace);
+	}
+
+	// percentage of probes which were found in the table
+	int hitRate() const
+	{
+		if ( nProbes == 0 )
+		{
+			return 0;
+		}
+		return (int)(nHits*100/nProbes);
+	}
+
+	private:
+	static void setPawns(PawnEntry& _entry, const Position& _position)
+	{
+		_entry.key = _position.pawnHash;
+		_entry.pawns[WHITE] = 0;
+		_entry.pawns[BLACK] = 0;
+		for (int square=0;square<64;++square)
+		{
+			if ( _position.aSquare[square] == WPAWN )
+			{
+				_entry.pawns[WHITE] |= squareBit(square);
+			}
+			else if ( _position.aSquare[square] == BPAWN )
+			{
+				_entry.pawns[BLACK] |= squareBit(square);
+			}
+		}
+	}
+
+	// score TEAM's pawns, and record which of them are passed.
+	template <bool TEAM> static int evaluate(PawnEntry& _entry, EvalTrace* _trace=0)
+	{
+		using namespace PawnMasks;
+
+		const Bitboard ownPawns = _entry.pawns[TEAM];
+		const Bitboard enemyPawns = _entry.pawns[Side<TEAM>::OPPONENT];
+		const Bitboard enemyAttacks = pawnAttacksAll<Side<TEAM>::OPPONENT>(enemyPawns);
+
+		int score = 0;
+		_entry.passed[TEAM] = 0;
+
+		Bitboard pawns = ownPawns;
+		while (pawns)
+		{
+			const int square = popSquare(pawns);
+			const int x = squareX(square);
+
+			// only the rearmost of doubled pawns is penalised
+			const bool doubled = (MASKS.forwardFile[TEAM][square] & ownPawns) != 0;
+			const bool isolated = (MASKS.adjacentFiles[x] & ownPawns) == 0;
+
+			if ( doubled )
+			{
+				score -= PAWN_DOUBLED;
+				if ( _trace ) { _trace->add(TERM_DOUBLED,TEAM,1); }
+			}
+			if ( isolated )
+			{
+				score -= PAWN_ISOLATED;
+				if ( _trace ) { _trace->add(TERM_ISOLATED,TEAM,1); }
+			}
+			else if ( (MASKS.support[TEAM][square] & ownPawns) == 0 &&
+				(squareBit(square + Side<TEAM>::FORWARD*8) & enemyAttacks) )
+			{
+				// no pawn can defend it and it can't safely advance
+				score -= PAWN_BACKWARD;
+				if ( _trace ) { _trace->add(TERM_BACKWARD,TEAM,1); }
+			}
+
+			if ( doubled == false && (MASKS.passed[TEAM][square] & enemyPawns) == 0 )
+			{
+				const int rank = (TEAM==WHITE) ? squareY(square) : 7-squareY(square);
+				score += PASSED_BONUS[rank];
+				_entry.passed[TEAM] |= squareBit(square);
+				if ( _trace ) { _trace->add(TERM_PASSED_RANK_2+rank-1,TEAM,1); }
+			}
+		}
+		return score;
+	}
+};
+
+// TEAM's pawns in front of its king, in tenths of a pawn. This depends on the
+// king so it isn't stored, but only needs the stored pawn bitboards.
+template <bool TEAM> int pawnShieldScore(const PawnEntry& _entry, const int _kingSquare, EvalTrace* _trace=0)
+{
+	if ( _kingSquare == -1 )
+	{
+		return 0;
+	}
+	const Bitboard ownPawns = _entry.pawns[TEAM];
+	const int near = countSquares(PawnMasks::MASKS.shieldNear[TEAM][_kingSquare] & ownPawns);
+	const int far = countSquares(PawnMasks::MASKS.shieldFar[TEAM][_kingSquare] & ownPawns);
+	if ( _trace )
+	{
+		_trace->add(TERM_SHIELD_NEAR,TEAM,near);
+		_trace->add(TERM_SHIELD_FAR,TEAM,far);
+	}
+	return near*PAWN_SHIELD_NEAR + far*PAWN_SHIELD_FAR;
+}
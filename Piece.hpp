@@ -1,52 +1,55 @@
-class Piece
+// Pieces are stored as a single byte. The low 3 bits are the piece type and
+// bit 3 is set for white pieces. 0 is an empty square.
+// The team specific codes (WPAWN, BKING etc.) are defined in Driver.cpp.
+
+enum ePieceType
 {
-	std::string name;
-	unsigned char shortName;
+	NO_PIECE=0,
+	PAWN=1,
+	KNIGHT=2,
+	BISHOP=3,
+	ROOK=4,
+	QUEEN=5,
+	KING=6
+};
 
-	public:
-	bool hasMoved;
-	bool isPromoted;
-	bool team;
-	
-	int materialValue;
-	
-	bool doubleMoved; // pawn moved 2 spaces and can be captured en passant
-	
-	int x,y;
+#define PIECE_WHITE 8
 
-	Piece(std::string _name, unsigned char _shortName, bool _team, int _x, int _y, int _materialValue)
-	{
-		name = _name;
-		shortName = _shortName;
-		hasMoved=false;
-		isPromoted=false;
-		team=_team;
-		x=_x;
-		y=_y;
-		materialValue=_materialValue;
-		doubleMoved=false;
-	}
-	std::string getName()
-	{
-		return name;
-	}
-	unsigned char getShortName()
-	{
-		return shortName;
-	}
-	void promote()
+constexpr unsigned char makePiece(const int _type, const bool _team)
+{
+	return _type | (_team==WHITE ? PIECE_WHITE : 0);
+}
+constexpr int pieceType(const unsigned char _piece)
+{
+	return _piece & 7;
+}
+constexpr bool pieceTeam(const unsigned char _piece)
+{
+	return (_piece & PIECE_WHITE) != 0;
+}
+
+// material value of each piece type
+constexpr int PIECE_VALUE[7] = {0,1,3,3,5,9,1000};
+
+constexpr int materialValue(const unsigned char _piece)
+{
+	return PIECE_VALUE[pieceType(_piece)];
+}
+
+// Zobrist key index of a piece, from 0 to 11.
+constexpr int pieceIndex(const unsigned char _piece)
+{
+	return pieceType(_piece)-1 + (pieceTeam(_piece)==WHITE ? 0 : 6);
+}
+
+// character used to display each piece code
+inline unsigned char pieceChar(const unsigned char _piece)
+{
+	// black pieces are upper case, white pieces are lower case
+	static const unsigned char PIECE_CHAR[16] =
 	{
-		isPromoted=true;
-		name = "queen";
-		
-		if ( team == WHITE )
-		{
-			shortName='q';
-		}
-		else
-		{
-			shortName='Q';
-		}
-		materialValue=9;
-	}
-};
+		249,245,'N','B','R','Q','K',249,
+		249,244,'n','b','r','q','k',249
+	};
+	return PIECE_CHAR[_piece & 15];
+}
@@ -0,0 +1,1025 @@
+#include <cstring>
+#include <sstream>
+#include <type_traits>
+
+// The state of a game at one point in time.
+// Position is trivially copyable and 96 bytes, so making a move on a copy is
+// a memcpy and positions are cheap to keep in queues, tables and files.
+// Pieces are single byte codes (see Piece.hpp). Castling rights and the en
+// passant square are held here rather than on the pieces.
+
+#define NO_EN_PASSANT -1
+
+// castling rights which survive a move touching this square
+constexpr unsigned char castlingMask(const int _square)
+{
+	return _square==toSquare(4,0) ? (unsigned char)~(CASTLE_WHITE_KINGSIDE|CASTLE_WHITE_QUEENSIDE) :
+		_square==toSquare(7,0) ? (unsigned char)~CASTLE_WHITE_KINGSIDE :
+		_square==toSquare(0,0) ? (unsigned char)~CASTLE_WHITE_QUEENSIDE :
+		_square==toSquare(4,7) ? (unsigned char)~(CASTLE_BLACK_KINGSIDE|CASTLE_BLACK_QUEENSIDE) :
+		_square==toSquare(7,7) ? (unsigned char)~CASTLE_BLACK_KINGSIDE :
+		_square==toSquare(0,7) ? (unsigned char)~CASTLE_BLACK_QUEENSIDE : (unsigned char)0xFF;
+}
+
+// the material key counts each piece in 4 bits, in pieceIndex order
+constexpr unsigned long long materialBit(const unsigned char _piece)
+{
+	return 1ULL << (4*pieceIndex(_piece));
+}
+
+// Squares attacked by each team, recorded by move generation so evaluation
+// doesn't have to work them out again. Indexed by team.
+struct AttackMap
+{
+	Bitboard all [2];
+	Bitboard byPawns [2];
+	Bitboard twice [2]; // attacked by at least 2 pieces
+	int nMoves [2]; // pseudo-legal moves
+	bool filled [2]; // false until the team's moves have been generated
+
+	void clear()
+	{
+		memset(this,0,sizeof(AttackMap));
+	}
+	void add(const bool _team, const Bitboard _squares)
+	{
+		twice[_team] |= all[_team] & _squares;
+		all[_team] |= _squares;
+	}
+};
+
+struct Position
+{
+	unsigned char aSquare [64]; // piece code on each square, indexed x + y*8
+	unsigned long long hash; // Zobrist hash, updated as moves are made
+	unsigned long long pawnHash; // Zobrist hash of the pawns only
+	unsigned long long materialKey; // number of each piece, see materialBit
+	bool sideToMove;
+	unsigned char castling; // CASTLE_* bits still available
+	signed char enPassant; // square a pawn may capture onto en passant
+	unsigned char halfmoveClock; // plies since the last capture or pawn move
+
+	void clear()
+	{
+		memset(aSquare,0,sizeof(aSquare));
+		sideToMove=WHITE;
+		castling=0;
+		enPassant=NO_EN_PASSANT;
+		halfmoveClock=0;
+		hash=computeHash();
+		pawnHash=computePawnHash();
+		materialKey=computeMaterialKey();
+	}
+
+	void reset()
+	{
+		clear();
+
+		const unsigned char backRank[8] = {ROOK,KNIGHT,BISHOP,QUEEN,KING,BISHOP,KNIGHT,ROOK};
+		for (int x=0;x<8;++x)
+		{
+			aSquare[toSquare(x,0)] = makePiece(backRank[x],WHITE);
+			aSquare[toSquare(x,1)] = WPAWN;
+			aSquare[toSquare(x,6)] = BPAWN;
+			aSquare[toSquare(x,7)] = makePiece(backRank[x],BLACK);
+		}
+		castling = CASTLE_WHITE_KINGSIDE | CASTLE_WHITE_QUEENSIDE |
+			CASTLE_BLACK_KINGSIDE | CASTLE_BLACK_QUEENSIDE;
+		hash=computeHash();
+		pawnHash=computePawnHash();
+		materialKey=computeMaterialKey();
+	}
+
+	// set up the position from a FEN string. Returns false if it can't be
+	// read, in which case the position is cleared.
+	bool setFen(const std::string& _fen)
+	{
+		clear();
+		std::istringstream fields(_fen);
+		std::string board, side, rights, passant;
+		int clock = 0;
+
+		if ( !(fields>>board>>side) )
+		{
+			return false;
+		}
+		fields>>rights>>passant>>clock;
+
+		// ranks are listed from black's back rank down
+		int x=0, y=7;
+		for (char c : board)
+		{
+			if ( c == '/' )
+			{
+				x=0;
+				--y;
+			}
+			else if ( c >= '1' && c <= '8' )
+			{
+				x += c-'0';
+			}
+			else
+			{
+				const int type = pieceFromChar(c);
+				if ( type == NO_PIECE || x > 7 || y < 0 )
+				{
+					clear();
+					return false;
+				}
+				aSquare[toSquare(x,y)] = makePiece(type,(c>='A' && c<='Z') ? WHITE : BLACK);
+				++x;
+			}
+		}
+
+		// move generation assumes each side has one king and no pawns on the
+		// back ranks
+		int nKings[2] = {0,0};
+		for (int square=0;square<64;++square)
+		{
+			const unsigned char piece = aSquare[square];
+			if ( pieceType(piece) == KING )
+			{
+				++nKings[pieceTeam(piece)];
+			}
+			if ( pieceType(piece) == PAWN && (squareY(square) == 0 || squareY(square) == 7) )
+			{
+				clear();
+				return false;
+			}
+		}
+		if ( nKings[WHITE] != 1 || nKings[BLACK] != 1 )
+		{
+			clear();
+			return false;
+		}
+
+		sideToMove = (side == "b") ? BLACK : WHITE;
+		for (char c : rights)
+		{
+			if ( c == 'K' ) { castling |= CASTLE_WHITE_KINGSIDE; }
+			if ( c == 'Q' ) { castling |= CASTLE_WHITE_QUEENSIDE; }
+			if ( c == 'k' ) { castling |= CASTLE_BLACK_KINGSIDE; }
+			if ( c == 'q' ) { castling |= CASTLE_BLACK_QUEENSIDE; }
+		}
+		// a right is lost if its king or rook isn't on its home square
+		const int aHome[6] = {toSquare(4,0),toSquare(7,0),toSquare(0,0),toSquare(4,7),toSquare(7,7),toSquare(0,7)};
+		const unsigned char aHomePiece[6] = {WKING,WROOK,WROOK,BKING,BROOK,BROOK};
+		for (int i=0;i<6;++i)
+		{
+			if ( aSquare[aHome[i]] != aHomePiece[i] )
+			{
+				castling &= castlingMask(aHome[i]);
+			}
+		}
+		// as in makeMove, en passant is only kept if it can be played. The
+		// target is behind a pawn which has just moved two squares, so it is
+		// on rank 6 with white to move, rank 3 with black to move, and empty.
+		if ( passant.size() == 2 && passant[0] >= 'a' && passant[0] <= 'h' &&
+			passant[1] == (sideToMove==WHITE ? '6' : '3') )
+		{
+			const int target = toSquare(passant[0]-'a',passant[1]-'1');
+			const int pawn = target + (sideToMove==WHITE ? -8 : 8);
+			if ( aSquare[target] == 0 && aSquare[pawn] == makePiece(PAWN,!sideToMove) &&
+				canBeCapturedEnPassant(pawn) )
+			{
+				enPassant = target;
+			}
+		}
+		halfmoveClock = (clock > 255) ? 255 : (clock < 0 ? 0 : clock);
+
+		hash=computeHash();
+		pawnHash=computePawnHash();
+		materialKey=computeMaterialKey();
+		return true;
+	}
+
+	// FEN string of the position. The move number isn't stored, so it is
+	// always given as 1.
+	std::string getFen() const
+	{
+		static const char PIECE_LETTER[7] = {' ','p','n','b','r','q','k'};
+		std::string fen;
+
+		for (int y=7;y>=0;--y)
+		{
+			int empty = 0;
+			for (int x=0;x<8;++x)
+			{
+				const unsigned char piece = at(x,y);
+				if ( piece == 0 )
+				{
+					++empty;
+					continue;
+				}
+				if ( empty > 0 )
+				{
+					fen += (char)('0'+empty);
+					empty = 0;
+				}
+				const char letter = PIECE_LETTER[pieceType(piece)];
+				fen += (pieceTeam(piece)==WHITE) ? (char)(letter-'a'+'A') : letter;
+			}
+			if ( empty > 0 )
+			{
+				fen += (char)('0'+empty);
+			}
+			if ( y > 0 )
+			{
+				fen += '/';
+			}
+		}
+
+		fen += (sideToMove==WHITE) ? " w " : " b ";
+		if ( castling == 0 )
+		{
+			fen += '-';
+		}
+		if ( castling & CASTLE_WHITE_KINGSIDE ) { fen += 'K'; }
+		if ( castling & CASTLE_WHITE_QUEENSIDE ) { fen += 'Q'; }
+		if ( castling & CASTLE_BLACK_KINGSIDE ) { fen += 'k'; }
+		if ( castling & CASTLE_BLACK_QUEENSIDE ) { fen += 'q'; }
+
+		if ( enPassant == NO_EN_PASSANT )
+		{
+			fen += " -";
+		}
+		else
+		{
+			fen += ' ';
+			fen += (char)('a'+squareX(enPassant));
+			fen += (char)('1'+squareY(enPassant));
+		}
+		return fen + " " + std::to_string(halfmoveClock) + " 1";
+	}
+
+	// piece type from a FEN letter of either case
+	static int pieceFromChar(const char _c)
+	{
+		switch (_c | 32)
+		{
+			case 'p': return PAWN;
+			case 'n': return KNIGHT;
+			case 'b': return BISHOP;
+			case 'r': return ROOK;
+			case 'q': return QUEEN;
+			case 'k': return KING;
+		}
+		return NO_PIECE;
+	}
+
+	unsigned char at(const int _x, const int _y) const
+	{
+		return aSquare[toSquare(_x,_y)];
+	}
+
+	// hash the pieces, side to move, castling rights and en passant file.
+	unsigned long long computeHash() const
+	{
+		unsigned long long key = 0;
+
+		for (int square=0;square<64;++square)
+		{
+			if ( aSquare[square] != 0 )
+			{
+				key ^= Zobrist::KEYS.piece[pieceIndex(aSquare[square])][square];
+			}
+		}
+		if ( sideToMove == BLACK )
+		{
+			key ^= Zobrist::KEYS.blackToMove;
+		}
+		if ( enPassant != NO_EN_PASSANT )
+		{
+			key ^= Zobrist::KEYS.enPassant[squareX(enPassant)];
+		}
+		return key ^ Zobrist::castlingKey(castling);
+	}
+
+	// hash of the pawns alone, used to look up pawn structure scores.
+	unsigned long long computePawnHash() const
+	{
+		unsigned long long key = 0;
+
+		for (int square=0;square<64;++square)
+		{
+			if ( pieceType(aSquare[square]) == PAWN )
+			{
+				key ^= Zobrist::KEYS.piece[pieceIndex(aSquare[square])][square];
+			}
+		}
+		return key;
+	}
+
+	unsigned long long computeMaterialKey() const
+	{
+		unsigned long long key = 0;
+
+		for (int square=0;square<64;++square)
+		{
+			if ( aSquare[square] != 0 )
+			{
+				key += materialBit(aSquare[square]);
+			}
+		}
+		return key;
+	}
+
+	// toggle a piece in both hashes
+	void hashPiece(const unsigned char _piece, const int _square)
+	{
+		const unsigned long long key = Zobrist::KEYS.piece[pieceIndex(_piece)][_square];
+		hash ^= key;
+		if ( pieceType(_piece) == PAWN )
+		{
+			pawnHash ^= key;
+		}
+	}
+
+	// move a piece between squares, capturing anything on the target
+	void movePiece(const int _from, const int _to)
+	{
+		const unsigned char piece = aSquare[_from];
+		if ( aSquare[_to] != 0 )
+		{
+			hashPiece(aSquare[_to],_to);
+			materialKey -= materialBit(aSquare[_to]);
+		}
+		hashPiece(piece,_from);
+		hashPiece(piece,_to);
+		aSquare[_to] = piece;
+		aSquare[_from] = 0;
+	}
+	void removePiece(const int _square)
+	{
+		hashPiece(aSquare[_square],_square);
+		materialKey -= materialBit(aSquare[_square]);
+		aSquare[_square] = 0;
+	}
+	void placePiece(const int _square, const unsigned char _piece)
+	{
+		aSquare[_square] = _piece;
+		hashPiece(_piece,_square);
+		materialKey += materialBit(_piece);
+	}
+
+	// play a generated move. The hash is updated incrementally.
+	void makeMove(const Move& _move)
+	{
+		const int from = _move.from();
+		const int to = _move.to();
+		const unsigned char piece = aSquare[from];
+
+		// captures and pawn moves reset the fifty move count
+		if ( aSquare[to] != 0 || pieceType(piece) == PAWN )
+		{
+			halfmoveClock=0;
+		}
+		else if ( halfmoveClock < 255 )
+		{
+			++halfmoveClock;
+		}
+
+		if ( enPassant != NO_EN_PASSANT )
+		{
+			hash ^= Zobrist::KEYS.enPassant[squareX(enPassant)];
+			enPassant = NO_EN_PASSANT;
+		}
+		hash ^= Zobrist::castlingKey(castling);
+
+		movePiece(from,to);
+
+		switch (_move.type())
+		{
+			case MOVE_CASTLE:
+				// the rook jumps over the king
+				if ( squareX(to) == 2 )
+				{
+					movePiece(toSquare(0,squareY(to)),toSquare(3,squareY(to)));
+				}
+				else
+				{
+					movePiece(toSquare(7,squareY(to)),toSquare(5,squareY(to)));
+				}
+				break;
+			case MOVE_EN_PASSANT:
+				// the captured pawn is beside us, not on the target
+				removePiece(toSquare(squareX(to),squareY(from)));
+				break;
+			case MOVE_DOUBLE_PAWN:
+				// only record en passant if an enemy pawn could take it, so
+				// otherwise identical positions hash the same.
+				if ( canBeCapturedEnPassant(to) )
+				{
+					enPassant = (from+to)/2;
+					hash ^= Zobrist::KEYS.enPassant[squareX(enPassant)];
+				}
+				break;
+			case MOVE_PROMOTION:
+				// always promote to a queen
+				removePiece(to);
+				placePiece(to,makePiece(QUEEN,pieceTeam(piece)));
+				break;
+		}
+
+		castling &= castlingMask(from) & castlingMask(to);
+		hash ^= Zobrist::castlingKey(castling);
+
+		sideToMove = !sideToMove;
+		hash ^= Zobrist::KEYS.blackToMove;
+	}
+
+	// pass the turn to the other side without moving.
+	void makeNullMove()
+	{
+		if ( enPassant != NO_EN_PASSANT )
+		{
+			hash ^= Zobrist::KEYS.enPassant[squareX(enPassant)];
+			enPassant = NO_EN_PASSANT;
+		}
+		sideToMove = !sideToMove;
+		hash ^= Zobrist::KEYS.blackToMove;
+	}
+
+	// true if there is an enemy pawn beside the pawn which just double moved
+	bool canBeCapturedEnPassant(const int _square) const
+	{
+		const unsigned char enemyPawn = makePiece(PAWN,!pieceTeam(aSquare[_square]));
+		const int x = squareX(_square);
+		return ( (x > 0 && aSquare[_square-1] == enemyPawn) ||
+			(x < 7 && aSquare[_square+1] == enemyPawn) );
+	}
+
+	// returns true if there is a piece on the square which TEAM can capture
+	template <bool TEAM> bool hasEnemyOn(const int _square) const
+	{
+		return (aSquare[_square] != 0 && pieceTeam(aSquare[_square]) != TEAM);
+	}
+
+	// returns true if TEAM can move onto this square (empty or capture)
+	template <bool TEAM> bool canLandOn(const int _square) const
+	{
+		return (aSquare[_square] == 0 || pieceTeam(aSquare[_square]) != TEAM);
+	}
+
+	// returns true if the piece is on any of the squares
+	bool hasPieceOn(Bitboard _squares, const unsigned char _piece) const
+	{
+		while (_squares)
+		{
+			if ( aSquare[popSquare(_squares)] == _piece )
+			{
+				return true;
+			}
+		}
+		return false;
+	}
+
+	// return the first piece found travelling from the square in the given
+	// direction, or 0 if we reach the edge of the board.
+	unsigned char firstPieceFrom(int _square, const int _direction) const
+	{
+		const int step = Tables::DIRECTION_X[_direction] + Tables::DIRECTION_Y[_direction]*8;
+
+		for (int i=rayLength(_square,_direction);i>0;--i)
+		{
+			_square+=step;
+			if ( aSquare[_square] != 0 )
+			{
+				return aSquare[_square];
+			}
+		}
+		return 0;
+	}
+
+	// returns true if a piece of TEAM attacks the square. We look outward
+	// from the square for each kind of attacker.
+	template <bool TEAM> bool isAttackedBy(const int _square) const
+	{
+		// pawns attack diagonally forwards, so look diagonally backwards.
+		if ( hasPieceOn(pawnAttacks(Side<TEAM>::OPPONENT,_square),Side<TEAM>::PAWN) ||
+			hasPieceOn(knightAttacks(_square),Side<TEAM>::KNIGHT) ||
+			hasPieceOn(kingAttacks(_square),Side<TEAM>::KING) )
+		{
+			return true;
+		}
+
+		// sliding pieces. The first 4 directions are straight lines, the
+		// last 4 are diagonals.
+		for (int i=0;i<8;++i)
+		{
+			const unsigned char slider = firstPieceFrom(_square,i);
+
+			if ( slider == Side<TEAM>::QUEEN ||
+				(i<4 && slider == Side<TEAM>::ROOK) ||
+				(i>=4 && slider == Side<TEAM>::BISHOP) )
+			{
+				return true;
+			}
+		}
+		return false;
+	}
+
+	// square of TEAM's king, or -1 if there is no king.
+	template <bool TEAM> int findKing() const
+	{
+		for (int square=0;square<64;++square)
+		{
+			if ( aSquare[square] == Side<TEAM>::KING )
+			{
+				return square;
+			}
+		}
+		return -1;
+	}
+
+	// TEAM is in check if an enemy piece attacks its king.
+	template <bool TEAM> bool isCheck() const
+	{
+		const int king = findKing<TEAM>();
+		if ( king == -1 )
+		{
+			// king has already been captured
+			return true;
+		}
+		return isAttackedBy<Side<TEAM>::OPPONENT>(king);
+	}
+	bool isCheck(const bool _team) const
+	{
+		if ( _team == WHITE )
+		{
+			return isCheck<WHITE>();
+		}
+		return isCheck<BLACK>();
+	}
+
+	// add every pseudo-legal move of TEAM. Moves may still leave the king in
+	// check, use isLegal to filter them. If an attack map is given, the
+	// squares TEAM attacks are recorded in it on the way.
+	template <bool TEAM> void generateMoves(MoveList& _moves, AttackMap* _attacks=0) const
+	{
+		const int nBefore = _moves.size();
+		for (int square=0;square<64;++square)
+		{
+			if ( aSquare[square] != 0 && pieceTeam(aSquare[square]) == TEAM )
+			{
+				generateMovesFrom<TEAM>(square,_moves,_attacks);
+			}
+		}
+		if ( _attacks != 0 )
+		{
+			_attacks->nMoves[TEAM] = _moves.size()-nBefore;
+			_attacks->filled[TEAM] = true;
+		}
+	}
+	// record the squares TEAM attacks and count its pseudo-legal moves, as
+	// generateMoves would with an attack map, without making any moves. Used
+	// by evaluation for the team whose moves the search didn't generate.
+	template <bool TEAM> void fillAttacks(AttackMap& _attacks) const
+	{
+		const bool OPPONENT = Side<TEAM>::OPPONENT;
+		int nMoves = 0;
+		for (int square=0;square<64;++square)
+		{
+			const unsigned char piece = aSquare[square];
+			if ( piece == 0 || pieceTeam(piece) != TEAM )
+			{
+				continue;
+			}
+			switch (pieceType(piece))
+			{
+				case PAWN:
+				{
+					const int forward = square + Side<TEAM>::FORWARD*8;
+					if ( aSquare[forward] == 0 )
+					{
+						++nMoves;
+						if ( squareY(square) == Side<TEAM>::PAWN_RANK && aSquare[forward + Side<TEAM>::FORWARD*8] == 0 )
+						{
+							++nMoves;
+						}
+					}
+					Bitboard targets = pawnAttacks(TEAM,square);
+					_attacks.add(TEAM,targets);
+					_attacks.byPawns[TEAM] |= targets;
+					while (targets)
+					{
+						const int target = popSquare(targets);
+						nMoves += ( hasEnemyOn<TEAM>(target) || target == enPassant );
+					}
+					break;
+				}
+				case KNIGHT:
+				case KING:
+				{
+					Bitboard targets = (pieceType(piece) == KNIGHT) ? knightAttacks(square) : kingAttacks(square);
+					_attacks.add(TEAM,targets);
+					while (targets)
+					{
+						nMoves += canLandOn<TEAM>(popSquare(targets));
+					}
+					break;
+				}
+				default:
+				{
+					// bishop, rook or queen
+					const bool straight = pieceType(piece) != BISHOP;
+					const bool diagonal = pieceType(piece) != ROOK;
+					Bitboard attacked = 0;
+					for (int i = (straight ? 0 : 4); i < (diagonal ? 8 : 4); ++i)
+					{
+						const int step = Tables::DIRECTION_X[i] + Tables::DIRECTION_Y[i]*8;
+						int target = square;
+						for (int n=rayLength(square,i);n>0;--n)
+						{
+							target+=step;
+							attacked |= squareBit(target);
+							if ( aSquare[target] != 0 )
+							{
+								nMoves += (pieceTeam(aSquare[target]) != TEAM);
+								break;
+							}
+							++nMoves;
+						}
+					}
+					_attacks.add(TEAM,attacked);
+					break;
+				}
+			}
+		}
+
+		// castling, checking the squares the king crosses against the
+		// opponent's attacks when they are already known
+		const int y = Side<TEAM>::BACK_RANK;
+		auto safe = [&](const int _x)
+		{
+			const int square = toSquare(_x,y);
+			return _attacks.filled[OPPONENT] ? (_attacks.all[OPPONENT] & squareBit(square)) == 0 :
+				isAttackedBy<OPPONENT>(square) == false;
+		};
+		if ( aSquare[toSquare(4,y)] == Side<TEAM>::KING )
+		{
+			if ( (castling & Side<TEAM>::CASTLE_QUEENSIDE) && at(1,y) == 0 && at(2,y) == 0 && at(3,y) == 0 &&
+				safe(2) && safe(3) && safe(4) )
+			{
+				++nMoves;
+			}
+			if ( (castling & Side<TEAM>::CASTLE_KINGSIDE) && at(5,y) == 0 && at(6,y) == 0 &&
+				safe(4) && safe(5) && safe(6) )
+			{
+				++nMoves;
+			}
+		}
+
+		_attacks.nMoves[TEAM] = nMoves;
+		_attacks.filled[TEAM] = true;
+	}
+
+	void generateMoves(const bool _team, MoveList& _moves) const
+	{
+		if ( _team == WHITE )
+		{
+			generateMoves<WHITE>(_moves);
+		}
+		else
+		{
+			generateMoves<BLACK>(_moves);
+		}
+	}
+
+	template <bool TEAM> void generateMovesFrom(const int _square, MoveList& _moves, AttackMap* _attacks=0) const
+	{
+		switch (aSquare[_square])
+		{
+			case Side<TEAM>::PAWN:
+				addPawnMoves<TEAM>(_square,_moves,_attacks);
+				break;
+			case Side<TEAM>::KNIGHT:
+				addStepMoves<TEAM>(_square,knightAttacks(_square),_moves,_attacks);
+				break;
+			case Side<TEAM>::BISHOP:
+				addSlidingMoves<TEAM,false,true>(_square,_moves,_attacks);
+				break;
+			case Side<TEAM>::ROOK:
+				addSlidingMoves<TEAM,true,false>(_square,_moves,_attacks);
+				break;
+			case Side<TEAM>::QUEEN:
+				addSlidingMoves<TEAM,true,true>(_square,_moves,_attacks);
+				break;
+			case Side<TEAM>::KING:
+				addStepMoves<TEAM>(_square,kingAttacks(_square),_moves,_attacks);
+				addCastlingMoves<TEAM>(_square,_moves);
+				break;
+		}
+	}
+
+	// pawn, can move forward 1 space, attack diagonally.
+	template <bool TEAM> void addPawnMoves(const int _square, MoveList& _moves, AttackMap* _attacks) const
+	{
+		const int forward = _square + Side<TEAM>::FORWARD*8;
+		// moves onto the last rank are promotions
+		const int type = (squareY(forward) == Side<TEAM>::PROMOTION_RANK) ? MOVE_PROMOTION : MOVE_NORMAL;
+
+		// can it move forward 1 space?
+		if ( aSquare[forward] == 0 )
+		{
+			_moves.push(Move(_square,forward,type));
+
+			// can it move forward 2 spaces?
+			const int doubleForward = forward + Side<TEAM>::FORWARD*8;
+			if ( squareY(_square) == Side<TEAM>::PAWN_RANK && aSquare[doubleForward] == 0 )
+			{
+				_moves.push(Move(_square,doubleForward,MOVE_DOUBLE_PAWN));
+			}
+		}
+
+		// can it attack diagonally left or right?
+		Bitboard targets = pawnAttacks(TEAM,_square);
+		if ( _attacks != 0 )
+		{
+			_attacks->add(TEAM,targets);
+			_attacks->byPawns[TEAM] |= targets;
+		}
+		while (targets)
+		{
+			const int target = popSquare(targets);
+
+			if ( hasEnemyOn<TEAM>(target) )
+			{
+				_moves.push(Move(_square,target,type));
+			}
+			else if ( target == enPassant )
+			{
+				_moves.push(Move(_square,target,MOVE_EN_PASSANT));
+			}
+		}
+	}
+
+	// knight or king, moves a single step to any of the target squares
+	template <bool TEAM> void addStepMoves(const int _square, Bitboard _targets, MoveList& _moves, AttackMap* _attacks) const
+	{
+		if ( _attacks != 0 )
+		{
+			_attacks->add(TEAM,_targets);
+		}
+		while (_targets)
+		{
+			const int target = popSquare(_targets);
+
+			if ( canLandOn<TEAM>(target) )
+			{
+				_moves.push(Move(_square,target));
+			}
+		}
+	}
+
+	// rook, bishop or queen. Moves in straight lines and/or diagonals.
+	template <bool TEAM, bool STRAIGHT, bool DIAGONAL> void addSlidingMoves(const int _square, MoveList& _moves, AttackMap* _attacks) const
+	{
+		// every square reached is attacked, including the one blocking us
+		Bitboard attacked = 0;
+
+		// the first 4 directions are straight lines, the last 4 diagonals.
+		for (int i = (STRAIGHT ? 0 : 4); i < (DIAGONAL ? 8 : 4); ++i)
+		{
+			const int step = Tables::DIRECTION_X[i] + Tables::DIRECTION_Y[i]*8;
+			int target = _square;
+
+			for (int n=rayLength(_square,i);n>0;--n)
+			{
+				target+=step;
+				attacked |= squareBit(target);
+
+				if ( aSquare[target] == 0 )
+				{
+					// piece can move here and further
+					_moves.push(Move(_square,target));
+				}
+				else
+				{
+					// enemy piece here, can move here but no further
+					if ( pieceTeam(aSquare[target]) != TEAM )
+					{
+						_moves.push(Move(_square,target));
+					}
+					break;
+				}
+			}
+		}
+		if ( _attacks != 0 )
+		{
+			_attacks->add(TEAM,attacked);
+		}
+	}
+
+	template <bool TEAM> void addCastlingMoves(const int _square, MoveList& _moves) const
+	{
+		const int y = Side<TEAM>::BACK_RANK;
+		const bool OPPONENT = Side<TEAM>::OPPONENT;
+
+		// the castling rights are lost when the king or rook moves, so the
+		// pieces are known to be on their starting squares.
+		if ( (castling & Side<TEAM>::CASTLE_QUEENSIDE) &&
+			at(1,y) == 0 && at(2,y) == 0 && at(3,y) == 0 )
+		{
+			// make sure all tiles the king visits are not in check
+			if ( isAttackedBy<OPPONENT>(toSquare(2,y)) == false &&
+				isAttackedBy<OPPONENT>(toSquare(3,y)) == false &&
+				isAttackedBy<OPPONENT>(toSquare(4,y)) == false )
+			{
+				_moves.push(Move(_square,toSquare(2,y),MOVE_CASTLE));
+			}
+		}
+		if ( (castling & Side<TEAM>::CASTLE_KINGSIDE) &&
+			at(5,y) == 0 && at(6,y) == 0 )
+		{
+			// make sure all tiles the king visits are not in check
+			if ( isAttackedBy<OPPONENT>(toSquare(4,y)) == false &&
+				isAttackedBy<OPPONENT>(toSquare(5,y)) == false &&
+				isAttackedBy<OPPONENT>(toSquare(6,y)) == false )
+			{
+				_moves.push(Move(_square,toSquare(6,y),MOVE_CASTLE));
+			}
+		}
+	}
+
+	// returns true if the move doesn't leave TEAM's king in check, and
+	// doesn't capture a king. The move is made on the squares in place and
+	// then taken back.
+	template <bool TEAM> bool isLegal(const Move& _move)
+	{
+		const int from = _move.from();
+		const int to = _move.to();
+		const unsigned char moving = aSquare[from];
+		const unsigned char captured = aSquare[to];
+
+		if ( captured == Side<Side<TEAM>::OPPONENT>::KING )
+		{
+			return false;
+		}
+
+		aSquare[to] = moving;
+		aSquare[from] = 0;
+		// the pawn captured en passant is beside us, not on the target
+		const int passedSquare = toSquare(squareX(to),squareY(from));
+		if ( _move.type() == MOVE_EN_PASSANT )
+		{
+			aSquare[passedSquare] = 0;
+		}
+
+		// castling has already checked the squares the king crosses, and the
+		// rook can't block an attack on the king's new square.
+		bool legal;
+		if ( moving == Side<TEAM>::KING )
+		{
+			legal = (isAttackedBy<Side<TEAM>::OPPONENT>(to) == false);
+		}
+		else
+		{
+			legal = (isCheck<TEAM>() == false);
+		}
+
+		// take back the move
+		aSquare[from] = moving;
+		aSquare[to] = captured;
+		if ( _move.type() == MOVE_EN_PASSANT )
+		{
+			aSquare[passedSquare] = Side<Side<TEAM>::OPPONENT>::PAWN;
+		}
+		return legal;
+	}
+	bool isLegal(const Move& _move)
+	{
+		if ( sideToMove == WHITE )
+		{
+			return isLegal<WHITE>(_move);
+		}
+		return isLegal<BLACK>(_move);
+	}
+
+	// count TEAM's legal moves without making any positions. If
+	// _stopAtFirst is set we return as soon as one legal move is found.
+	template <bool TEAM> int countLegalMoves(const bool _stopAtFirst=false)
+	{
+		MoveList moves;
+		generateMoves<TEAM>(moves);
+
+		int nLegal = 0;
+		for (int i=0;i<moves.size();++i)
+		{
+			if ( isLegal<TEAM>(moves(i)) )
+			{
+				++nLegal;
+				if ( _stopAtFirst )
+				{
+					break;
+				}
+			}
+		}
+		return nLegal;
+	}
+	int countLegalMoves(const bool _team)
+	{
+		if ( _team == WHITE )
+		{
+			return countLegalMoves<WHITE>();
+		}
+		return countLegalMoves<BLACK>();
+	}
+	bool hasAnyLegalMove(const bool _team)
+	{
+		if ( _team == WHITE )
+		{
+			return (countLegalMoves<WHITE>(true) != 0);
+		}
+		return (countLegalMoves<BLACK>(true) != 0);
+	}
+
+	// fill the list with the legal moves of the side to move. The attack map
+	// is filled in for TEAM if one is given.
+	template <bool TEAM> void generateLegalMoves(MoveList& _moves, AttackMap* _attacks=0)
+	{
+		MoveList pseudoLegal;
+		generateMoves<TEAM>(pseudoLegal,_attacks);
+
+		for (int i=0;i<pseudoLegal.size();++i)
+		{
+			if ( isLegal<TEAM>(pseudoLegal(i)) )
+			{
+				_moves.push(pseudoLegal(i));
+			}
+		}
+	}
+	void generateLegalMoves(MoveList& _moves)
+	{
+		if ( sideToMove == WHITE )
+		{
+			generateLegalMoves<WHITE>(_moves);
+		}
+		else
+		{
+			generateLegalMoves<BLACK>(_moves);
+		}
+	}
+
+	// the legal move of the side to move from one square to another, or a
+	// null move if there isn't one. Moves read from text or from the
+	// transposition table are checked this way before they are made.
+	Move findMove(const int _from, const int _to)
+	{
+		MoveList moves;
+		generateLegalMoves(moves);
+		for (int i=0;i<moves.size();++i)
+		{
+			if ( moves(i).from() == _from && moves(i).to() == _to )
+			{
+				return moves(i);
+			}
+		}
+		return Move();
+	}
+
+	// sum of material value of TEAM's pieces
+	template <bool TEAM> int getMaterialScore() const
+	{
+		int score = 0;
+		for (int square=0;square<64;++square)
+		{
+			if ( aSquare[square] != 0 && pieceTeam(aSquare[square]) == TEAM )
+			{
+				score += materialValue(aSquare[square]);
+			}
+		}
+		return score;
+	}
+
+	// number of the given piece on the board
+	int countPiece(const unsigned char _piece) const
+	{
+		int count = 0;
+		for (int square=0;square<64;++square)
+		{
+			if ( aSquare[square] == _piece )
+			{
+				++count;
+			}
+		}
+		return count;
+	}
+
+	// number of pieces belonging to the team, including the king
+	int countPieces(const bool _team) const
+	{
+		int count = 0;
+		for (int square=0;square<64;++square)
+		{
+			if ( aSquare[square] != 0 && pieceTeam(aSquare[square]) == _team )
+			{
+				++count;
+			}
+		}
+		return count;
+	}
+};
+
+static_assert(std::is_trivially_copyable<Position>::value, "Position must be trivially copyable");
+static_assert(sizeof(Position) <= 96, "Position should stay small");
@@ -0,0 +1,84 @@
+#include <stdint.h>
+
+// Random numbers from xoshiro256**, which is fast, small and passes the usual
+// statistical tests.
+// A generator is seeded with a seed and a stream number, and each pair gives
+// an unrelated sequence, so a run can hand game or thread k stream k and get
+// the same numbers every time it is run with that seed. split() does the same
+// from a generator's current state.
+// Generators aren't shared between threads. The global one is thread_local.
+
+	// seed used when none is given
+#define RANDOM_DEFAULT_SEED 0x2545F4914F6CDD1DULL
+
+class Random
+{
+	uint64_t state [4];
+
+	public:
+	Random(const uint64_t _seed=RANDOM_DEFAULT_SEED, const uint64_t _stream=0)
+	{
+		seed(_seed,_stream);
+	}
+
+	void seed(const uint64_t _seed, const uint64_t _stream=0)
+	{
+		// splitmix64 fills the state, starting from a mix of the seed and the
+		// stream so nearby seeds and streams are far apart
+		uint64_t x = mix(_seed) ^ mix(_stream+0x9E3779B97F4A7C15ULL);
+		for (int i=0;i<4;++i)
+		{
+			x += 0x9E3779B97F4A7C15ULL;
+			state[i] = mix(x);
+		}
+		// the state must not be all zeros
+		if ( (state[0]|state[1]|state[2]|state[3]) == 0 )
+		{
+			state[0] = 1;
+		}
+	}
+
+	// a new generator for stream _stream, decided by this one's state but
+	// without changing it
+	Random split(const uint64_t _stream) const
+	{
+		return Random(state[0]^rotate(state[1],17)^rotate(state[2],31)^rotate(state[3],47),_stream);
+	}
+
+	uint64_t next()
+	{
+		const uint64_t result = rotate(state[1]*5,7)*9;
+		const uint64_t t = state[1]<<17;
+		state[2] ^= state[0];
+		state[3] ^= state[1];
+		state[1] ^= state[2];
+		state[0] ^= state[3];
+		state[2] ^= t;
+		state[3] = rotate(state[3],45);
+		return result;
+	}
+
+	// a number from 0 to _max inclusive
+	int rand(const int _max)
+	{
+		if ( _max <= 0 )
+		{
+			return 0;
+		}
+		// the high 32 bits scaled to the range, which is fast and unbiased
+		// enough for ranges this small
+		return (int)(((next()>>32)*((uint64_t)_max+1))>>32);
+	}
+
+	private:
+	static uint64_t rotate(const uint64_t _x, const int _bits)
+	{
+		return (_x<<_bits) | (_x>>(64-_bits));
+	}
+	static uint64_t mix(uint64_t _x)
+	{
+		_x = (_x^(_x>>30))*0xBF58476D1CE4E5B9ULL;
+		_x = (_x^(_x>>27))*0x94D049BB133111EBULL;
+		return _x^(_x>>31);
+	}
+};
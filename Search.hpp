@@ -0,0 +1,467 @@
+#include <atomic>
+#include <chrono>
+
+// Alpha-beta search over plain Positions.
+// Board builds a tree of heap allocated substates, which is fine for looking
+// a couple of moves ahead in a game but too slow for searching many positions.
+// Search makes moves on Position copies on the stack instead, and prunes with
+// alpha-beta. Scores are in pawns, from the side to move's point of view.
+// Results are kept in the shared transposition table, and think() searches one
+// ply deeper at a time until a SearchControl tells it to stop. Several threads
+// can think about the same position, sharing what they find through the table.
+
+	// deepest the search can go
+#define MAX_PLY 64
+#define SCORE_INFINITE 30000
+	// nodes between checks of the clock and the node limit
+#define SEARCH_CHECK_NODES 1024
+	// most lines think() can find at once
+#define SEARCH_MAX_LINES 32
+	// window below the line before, in pawns, for each later line
+#define SEARCH_LINE_WINDOW 1
+
+inline long long searchClock()
+{
+	return std::chrono::duration_cast<std::chrono::microseconds>(
+		std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Limits on a search, shared by every thread searching the position. Another
+// thread may stop the search, or move the deadline, while it runs.
+struct SearchControl
+{
+	std::atomic <bool> stop;
+	// searchClock() time to stop at, 0 for none
+	std::atomic <long long> deadline;
+	// 0 for no limit
+	int maxDepth;
+	// a limit on the nodes of every thread together
+	unsigned long long maxNodes;
+	// nodes searched by every thread, each adding its own at every check
+	std::atomic <unsigned long long> nNodes;
+
+	SearchControl()
+	{
+		clear();
+	}
+	void clear()
+	{
+		stop=false;
+		deadline=0;
+		maxDepth=0;
+		maxNodes=0;
+		nNodes=0;
+	}
+};
+
+class Search
+{
+	// hashes of the positions on the current line, for finding repetitions
+	unsigned long long aPathHash [MAX_PLY+1];
+	// network accumulators for the current line, if a network is loaded
+	Nnue::Accumulator aAccumulator [MAX_PLY+1];
+
+	SearchControl* control;
+	// set when the control stopped the search part way through an iteration
+	bool aborted;
+	// root moves which aren't searched, as they are earlier lines
+	Move aExcluded [SEARCH_MAX_LINES];
+	int nExcluded;
+	// nodes already added to the control's count
+	unsigned long long nCounted;
+
+	public:
+	// positions played before the root, may be 0
+	GameHistory* history;
+	// the shared table unless the search is given its own
+	TranspositionTable* table;
+	unsigned long long nNodes;
+	Move bestMove;
+	// depth of the last completed iteration of think()
+	int completedDepth;
+	// the best root move found so far, which other threads can read while
+	// the search runs
+	std::atomic <unsigned short> currentBest;
+
+	// number of lines think() looks for, each with a different first move
+	int multiPv;
+	// the lines found by the last completed iteration, best first
+	Move aLineMove [SEARCH_MAX_LINES];
+	int aLineScore [SEARCH_MAX_LINES];
+	int nLines;
+
+	Search(GameHistory* _history = 0, TranspositionTable* _table = &transpositionTable)
+	{
+		history=_history;
+		table=_table;
+		nNodes=0;
+		nCounted=0;
+		control=0;
+		aborted=false;
+		completedDepth=0;
+		currentBest=0;
+		nExcluded=0;
+		multiPv=1;
+		nLines=0;
+	}
+
+	// search the position to a fixed depth and return its score. The best
+	// move found is left in bestMove.
+	int search(const Position& _position, const int _depth, const int _alpha=-SCORE_INFINITE,
+		const int _beta=SCORE_INFINITE)
+	{
+		Position root = _position;
+		bestMove = Move();
+		aborted = false;
+
+		if ( canUseNetwork(root) )
+		{
+			network.refresh(root,aAccumulator[0]);
+		}
+
+		if ( root.sideToMove == WHITE )
+		{
+			return negamax<WHITE>(root,0,_depth,0,_alpha,_beta);
+		}
+		return negamax<BLACK>(root,0,_depth,0,_alpha,_beta);
+	}
+
+	// iterative deepening from _startDepth until _control stops the search
+	// or its depth limit is reached. _report(depth,score) is called after
+	// each completed depth. Returns the score of the last completed depth,
+	// with its best move in bestMove. The first depth is always completed so
+	// there is a move to play.
+	// With multiPv above 1 each depth finds that many lines. Every line after
+	// the first leaves out the moves already found, and can't score higher
+	// than the line before it, so it is searched with a narrow window just
+	// below that line's score. Only a fail low needs a second search.
+	template <class REPORT> int think(const Position& _position, SearchControl& _control, REPORT _report,
+		const int _startDepth=1)
+	{
+		Move lastBest;
+		int lastScore = 0;
+		completedDepth = 0;
+		nNodes = 0;
+		nCounted = 0;
+		nLines = 0;
+		currentBest = 0;
+		const int maxDepth = (_control.maxDepth > 0 && _control.maxDepth < MAX_PLY) ? _control.maxDepth : MAX_PLY;
+		const int maxLines = (multiPv < 1) ? 1 : (multiPv > SEARCH_MAX_LINES ? SEARCH_MAX_LINES : multiPv);
+
+		for (int depth=_startDepth;depth<=maxDepth;++depth)
+		{
+			control = (completedDepth > 0) ? &_control : 0;
+
+			int aScore [SEARCH_MAX_LINES];
+			int nFound = 0;
+			int firstScore = 0;
+			while ( nFound < maxLines )
+			{
+				nExcluded = nFound;
+
+				int score;
+				if ( nFound == 0 )
+				{
+					score = search(_position,depth);
+					firstScore = score;
+				}
+				else
+				{
+					const int beta = aScore[nFound-1]+1;
+					const int alpha = beta-1-SEARCH_LINE_WINDOW;
+					score = search(_position,depth,alpha,beta);
+					if ( aborted == false && score <= alpha )
+					{
+						score = search(_position,depth,-SCORE_INFINITE,beta);
+					}
+				}
+
+				// a move which beat the previous best before the search was
+				// stopped is still better
+				if ( nFound == 0 && bestMove.isNull() == false )
+				{
+					lastBest = bestMove;
+				}
+				// no moves left to search
+				if ( aborted || bestMove.isNull() )
+				{
+					break;
+				}
+				aExcluded[nFound] = bestMove;
+				aScore[nFound] = score;
+				++nFound;
+			}
+			nExcluded = 0;
+			control = 0;
+
+			if ( aborted )
+			{
+				break;
+			}
+			for (int i=0;i<nFound;++i)
+			{
+				aLineMove[i] = aExcluded[i];
+				aLineScore[i] = aScore[i];
+			}
+			nLines = nFound;
+			bestMove = lastBest;
+
+			const int score = firstScore;
+			lastScore = score;
+			completedDepth = depth;
+			_report(depth,score);
+
+			if ( _control.stop.load(std::memory_order_relaxed) || lastBest.isNull() ||
+				score >= SCORE_CHECKMATE-depth || score <= -SCORE_CHECKMATE+depth )
+			{
+				break;
+			}
+		}
+		bestMove = lastBest;
+		return lastScore;
+	}
+
+	// the principal variation, following the best moves stored in the
+	// transposition table from _firstMove, or from the best move
+	int getPrincipalVariation(const Position& _position, Move* _aMove, const int _maxMoves, Move _firstMove=Move())
+	{
+		Position position = _position;
+		int nMoves = 0;
+		Move move = _firstMove.isNull() ? bestMove : _firstMove;
+		while ( nMoves < _maxMoves && move.isNull() == false && position.findMove(move.from(),move.to()) == move )
+		{
+			_aMove[nMoves++] = move;
+			position.makeMove(move);
+
+			TTEntry entry;
+			if ( table->probe(position.hash,0,entry) == false )
+			{
+				break;
+			}
+			move = entry.move;
+		}
+		return nMoves;
+	}
+
+	private:
+	template <bool TEAM> int negamax(Position& _position, const Position* _parent, const int _depth,
+		const int _ply, int _alpha, const int _beta)
+	{
+		if ( control != 0 && shouldStop() )
+		{
+			aborted = true;
+			return 0;
+		}
+		++nNodes;
+		aPathHash[_ply] = _position.hash;
+
+		const bool useNetwork = canUseNetwork(_position);
+		if ( useNetwork && _parent != 0 )
+		{
+			network.update(aAccumulator[_ply-1],*_parent,_position,aAccumulator[_ply]);
+		}
+
+		if ( _ply > 0 && isDraw(_position,_ply) )
+		{
+			return 0;
+		}
+		// no need to search positions the tablebases know
+		int tablebaseScore;
+		if ( _ply > 0 && getTablebaseScore<TEAM>(_position,_ply,tablebaseScore) )
+		{
+			return tablebaseScore;
+		}
+
+		// a deep enough earlier result can be used as it is, otherwise its
+		// move is tried first
+		TTEntry entry;
+		Move hashMove;
+		if ( table->probe(_position.hash,_ply,entry) )
+		{
+			hashMove = entry.move;
+			if ( _ply > 0 && entry.depth >= _depth &&
+				(entry.bound == TT_EXACT || (entry.bound == TT_LOWER && entry.score >= _beta) ||
+				(entry.bound == TT_UPPER && entry.score <= _alpha)) )
+			{
+				return entry.score;
+			}
+		}
+
+		// the attacks found generating our moves are reused by the evaluation
+		MoveList moves;
+		AttackMap attacks;
+		attacks.clear();
+		_position.generateLegalMoves<TEAM>(moves,&attacks);
+
+		if ( moves.size() == 0 )
+		{
+			// mates found sooner score higher
+			return _position.isCheck<TEAM>() ? -SCORE_CHECKMATE+_ply : 0;
+		}
+		if ( _depth <= 0 || _ply >= MAX_PLY )
+		{
+			return staticScore<TEAM>(_position,attacks,useNetwork,_ply);
+		}
+
+		orderMoves(_position,moves,hashMove);
+		if ( _ply == 0 && nExcluded > 0 )
+		{
+			removeExcluded(moves);
+			if ( moves.size() == 0 )
+			{
+				return _alpha;
+			}
+		}
+
+		const int originalAlpha = _alpha;
+		Move nodeBest;
+		for (int i=0;i<moves.size();++i)
+		{
+			Position child = _position;
+			child.makeMove(moves(i));
+
+			const int score = -negamax<Side<TEAM>::OPPONENT>(child,&_position,_depth-1,_ply+1,-_beta,-_alpha);
+			if ( aborted )
+			{
+				return 0;
+			}
+
+			if ( score > _alpha )
+			{
+				_alpha = score;
+				nodeBest = moves(i);
+				if ( _ply == 0 )
+				{
+					bestMove = moves(i);
+					if ( nExcluded == 0 )
+					{
+						currentBest.store(bestMove.getData(),std::memory_order_relaxed);
+					}
+				}
+				if ( _alpha >= _beta )
+				{
+					break;
+				}
+			}
+		}
+
+		// a root missing some of its moves isn't the real position
+		if ( _ply == 0 && nExcluded > 0 )
+		{
+			return _alpha;
+		}
+		const int bound = (_alpha >= _beta) ? TT_LOWER : (_alpha > originalAlpha) ? TT_EXACT : TT_UPPER;
+		table->store(_position.hash,_ply,nodeBest.isNull() ? hashMove : nodeBest,_alpha,_depth,bound);
+		return _alpha;
+	}
+
+	// the stop flag is checked at every node so a stop is seen at once, the
+	// clock and the node count less often
+	bool shouldStop()
+	{
+		if ( aborted || control->stop.load(std::memory_order_relaxed) )
+		{
+			return true;
+		}
+		if ( (nNodes & (SEARCH_CHECK_NODES-1)) != 0 )
+		{
+			return false;
+		}
+		// add this thread's nodes since the last check to the shared count
+		const unsigned long long added = nNodes-nCounted;
+		const unsigned long long total = control->nNodes.fetch_add(added,std::memory_order_relaxed)+added;
+		nCounted = nNodes;
+		const long long deadline = control->deadline.load(std::memory_order_relaxed);
+		return ( (deadline != 0 && searchClock() >= deadline) ||
+			(control->maxNodes != 0 && total >= control->maxNodes) );
+	}
+
+	// take the earlier lines' first moves out of the root's moves
+	void removeExcluded(MoveList& _moves)
+	{
+		MoveList kept;
+		for (int i=0;i<_moves.size();++i)
+		{
+			bool excluded = false;
+			for (int j=0;j<nExcluded;++j)
+			{
+				if ( _moves(i) == aExcluded[j] )
+				{
+					excluded = true;
+				}
+			}
+			if ( excluded == false )
+			{
+				kept.push(_moves(i));
+			}
+		}
+		_moves = kept;
+	}
+
+	// evaluate a leaf, using the shared evaluation cache
+	template <bool TEAM> int staticScore(Position& _position, AttackMap& _attacks, const bool _useNetwork, const int _ply)
+	{
+		int score;
+		if ( evalCache.probe(_position.hash,TEAM,score) )
+		{
+			return score;
+		}
+		score = _useNetwork ? getNetworkScore<TEAM>(_position,aAccumulator[_ply]) :
+			getHandcraftedScore<TEAM>(_position,_attacks);
+		evalCache.store(_position.hash,TEAM,score);
+		return score;
+	}
+
+	// fifty move rule, or a repetition of an earlier position. As with Board,
+	// a single repetition counts as a draw inside the search.
+	bool isDraw(const Position& _position, const int _ply)
+	{
+		if ( _position.halfmoveClock >= FIFTY_MOVE_PLIES )
+		{
+			return true;
+		}
+		const int halfmoveClock = _position.halfmoveClock;
+		for (int distance=2;distance<=_ply && distance<=halfmoveClock;distance+=2)
+		{
+			if ( aPathHash[_ply-distance] == _position.hash )
+			{
+				return true;
+			}
+		}
+		return ( history != 0 && halfmoveClock > _ply &&
+			history->countMatches(_position.hash,halfmoveClock,_ply+1) > 0 );
+	}
+
+	// try the move from the transposition table first, then captures, the
+	// most valuable victim first and then the least valuable attacker. Good
+	// moves first means more alpha-beta cutoffs.
+	static void orderMoves(const Position& _position, MoveList& _moves, const Move _hashMove)
+	{
+		int aKey [256];
+		for (int i=0;i<_moves.size();++i)
+		{
+			const int victim = materialValue(_position.aSquare[_moves(i).to()]);
+			const int attacker = pieceType(_position.aSquare[_moves(i).from()]);
+			aKey[i] = (victim > 0 || _moves(i).type() == MOVE_PROMOTION) ? victim*16 - attacker + 1000 : 0;
+			if ( _moves(i) == _hashMove )
+			{
+				aKey[i] = SCORE_INFINITE;
+			}
+		}
+		// insertion sort, the lists are short
+		for (int i=1;i<_moves.size();++i)
+		{
+			const Move move = _moves(i);
+			const int key = aKey[i];
+			int j = i-1;
+			while ( j >= 0 && aKey[j] < key )
+			{
+				_moves(j+1) = _moves(j);
+				aKey[j+1] = aKey[j];
+				--j;
+			}
+			_moves(j+1) = move;
+			aKey[j+1] = key;
+		}
+	}
+};
@@ -0,0 +1,221 @@
+#include <functional>
+#include <thread>
+#include <vector>
+
+// A search running in the background.
+// start() copies the position and returns at once. The search runs on its
+// own threads, reports each completed depth through a callback and calls
+// another when it is done, so nothing is printed and no Board is changed.
+// The best move so far can be read at any time, and cancel() stops the
+// search at the next node it visits.
+// Callbacks are made on the search's thread. They may call cancel(), but not
+// wait() or start().
+
+	// the longest principal variation reported
+#define SEARCH_MAX_PV 32
+
+struct SearchLimits
+{
+	// 0 for no limit
+	int depth;
+	unsigned long long nodes;
+	// milliseconds
+	long long time;
+	// keep the result until cancel() or release(), even if the search
+	// finishes first. Used for analysis and pondering.
+	bool infinite;
+	// number of best lines to find, each starting with a different move
+	int lines;
+
+	SearchLimits()
+	{
+		depth=0;
+		nodes=0;
+		time=0;
+		infinite=false;
+		lines=1;
+	}
+};
+
+struct SearchLine
+{
+	int score; // in pawns, for the side to move
+	Move aPv [SEARCH_MAX_PV];
+	int nPv;
+};
+
+struct SearchInfo
+{
+	int depth;
+	unsigned long long nNodes;
+	unsigned long long nodesPerSecond;
+	long long elapsed; // microseconds
+	Move bestMove;
+	// the best lines found, best first. There may be fewer than asked for.
+	SearchLine aLine [SEARCH_MAX_LINES];
+	int nLines;
+};
+
+class SearchJob
+{
+	public:
+	typedef std::function <void(const SearchInfo&)> Callback;
+
+	private:
+	SearchControl control;
+	std::thread thread;
+	std::atomic <bool> running;
+	// set while an infinite search holds its result
+	std::atomic <bool> holding;
+	// the result comes from this search, the others only help it
+	Search main;
+
+	public:
+	SearchJob()
+	{
+		running=false;
+		holding=false;
+	}
+	~SearchJob()
+	{
+		cancel();
+		wait();
+	}
+
+	// search a copy of _position. _history, if given, must not change until
+	// the search is done. _nThreads extra searches share their results
+	// through the transposition table.
+	void start(const Position& _position, const SearchLimits& _limits, GameHistory* _history=0,
+		const int _nThreads=1, Callback _onProgress=Callback(), Callback _onDone=Callback())
+	{
+		cancel();
+		wait();
+
+		control.clear();
+		control.maxDepth = _limits.depth;
+		control.maxNodes = _limits.nodes;
+		if ( _limits.time > 0 )
+		{
+			control.deadline = searchClock()+_limits.time*1000;
+		}
+		holding = _limits.infinite;
+		main.history = _history;
+		main.multiPv = _limits.lines;
+		main.currentBest = 0;
+		running = true;
+		thread = std::thread(&SearchJob::run,this,_position,_history,_nThreads < 1 ? 1 : _nThreads,_onProgress,_onDone);
+	}
+
+	// stop the search as soon as possible. The done callback still follows.
+	void cancel()
+	{
+		control.stop = true;
+		holding = false;
+	}
+
+	// let an infinite search finish, giving a time limit from now in
+	// milliseconds, or 0 to keep searching until its depth or node limit.
+	// cancel() stops it at once.
+	void release(const long long _time=0)
+	{
+		if ( _time > 0 )
+		{
+			control.deadline = searchClock()+_time*1000;
+		}
+		holding = false;
+	}
+
+	// wait for the search and its done callback to finish
+	void wait()
+	{
+		if ( thread.joinable() )
+		{
+			thread.join();
+		}
+	}
+
+	// true until the done callback has returned
+	bool isRunning() const
+	{
+		return running;
+	}
+
+	// the best move found so far, or the result once the search is done
+	Move getBestMove() const
+	{
+		return Move::fromData(main.currentBest.load(std::memory_order_relaxed));
+	}
+
+	private:
+	void run(const Position _root, GameHistory* _history, const int _nThreads, Callback _onProgress, Callback _onDone)
+	{
+		// the extra threads start at different depths so they don't all
+		// search the same positions at once
+		std::vector <std::thread> vHelper;
+		for (int i=1;i<_nThreads;++i)
+		{
+			vHelper.emplace_back([this,_root,_history,i]()
+			{
+				Search helper(_history);
+				helper.think(_root,control,[](const int, const int) {},1+i%2);
+			});
+		}
+
+		const long long start = searchClock();
+		SearchInfo info;
+		info.depth = 0;
+		info.nLines = 0;
+
+		main.think(_root,control,[&](const int _depth, const int)
+		{
+			info.depth = _depth;
+			if ( _onProgress )
+			{
+				fillInfo(main,_root,start,info);
+				_onProgress(info);
+			}
+		});
+
+		while ( holding && control.stop == false )
+		{
+			std::this_thread::sleep_for(std::chrono::microseconds(100));
+		}
+		control.stop = true;
+		for (auto& helper : vHelper)
+		{
+			helper.join();
+		}
+
+		fillInfo(main,_root,start,info);
+		if ( _onDone )
+		{
+			_onDone(info);
+		}
+		running = false;
+	}
+
+	static void fillInfo(Search& _search, const Position& _root, const long long _start, SearchInfo& _info)
+	{
+		_info.nNodes = _search.nNodes;
+		_info.elapsed = searchClock()-_start;
+		_info.nodesPerSecond = _info.elapsed > 0 ? _info.nNodes*1000000/_info.elapsed : 0;
+		_info.bestMove = _search.bestMove;
+
+		// the lines of the last completed depth. If the search stopped before
+		// finishing one there is only the best move.
+		_info.nLines = _search.nLines;
+		for (int i=0;i<_search.nLines;++i)
+		{
+			SearchLine& line = _info.aLine[i];
+			line.score = _search.aLineScore[i];
+			line.nPv = _search.getPrincipalVariation(_root,line.aPv,SEARCH_MAX_PV,
+				i == 0 ? _search.bestMove : _search.aLineMove[i]);
+		}
+		if ( _info.nLines == 0 && _search.bestMove.isNull() == false )
+		{
+			_info.nLines = 1;
+			_info.aLine[0].score = 0;
+			_info.aLine[0].nPv = _search.getPrincipalVariation(_root,_info.aLine[0].aPv,SEARCH_MAX_PV);
+		}
+	}
+};
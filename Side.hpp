@@ -0,0 +1,34 @@
+// Compile-time description of each side.
+// Move generation, attack queries and evaluation are templated on the team,
+// and look up colour-dependent directions, ranks, piece codes and castling
+// rights here so they become constants instead of runtime checks on team.
+
+	// castling rights, stored as bits on the Position
+#define CASTLE_WHITE_KINGSIDE 1
+#define CASTLE_WHITE_QUEENSIDE 2
+#define CASTLE_BLACK_KINGSIDE 4
+#define CASTLE_BLACK_QUEENSIDE 8
+
+template <bool TEAM> struct Side
+{
+	static constexpr bool OPPONENT = !TEAM;
+
+	// direction pawns move in along y
+	static constexpr int FORWARD = (TEAM==WHITE) ? 1 : -1;
+	// rank the king and rooks start on
+	static constexpr int BACK_RANK = (TEAM==WHITE) ? 0 : 7;
+	// rank pawns start on, and may double move from
+	static constexpr int PAWN_RANK = (TEAM==WHITE) ? 1 : 6;
+	// rank pawns promote on
+	static constexpr int PROMOTION_RANK = (TEAM==WHITE) ? 7 : 0;
+
+	static constexpr unsigned char PAWN = (TEAM==WHITE) ? WPAWN : BPAWN;
+	static constexpr unsigned char ROOK = (TEAM==WHITE) ? WROOK : BROOK;
+	static constexpr unsigned char KNIGHT = (TEAM==WHITE) ? WKNIGHT : BKNIGHT;
+	static constexpr unsigned char BISHOP = (TEAM==WHITE) ? WBISHOP : BBISHOP;
+	static constexpr unsigned char QUEEN = (TEAM==WHITE) ? WQUEEN : BQUEEN;
+	static constexpr unsigned char KING = (TEAM==WHITE) ? WKING : BKING;
+
+	static constexpr unsigned char CASTLE_KINGSIDE = (TEAM==WHITE) ? CASTLE_WHITE_KINGSIDE : CASTLE_BLACK_KINGSIDE;
+	static constexpr unsigned char CASTLE_QUEENSIDE = (TEAM==WHITE) ? CASTLE_WHITE_QUEENSIDE : CASTLE_BLACK_QUEENSIDE;
+};
@@ -0,0 +1,956 @@
+#include <atomic>
+#include <filesystem>
+#include <fstream>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#if defined(_WIN32)
+	#include <windows.h>
+#else
+	#include <fcntl.h>
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+	#include <unistd.h>
+#endif
+
+// Endgame tablebases, generated by retrograde analysis.
+// A table holds the exact result of every position with one set of material,
+// such as KRKN: the distance to mate in plies, or a draw. Tables are made
+// locally with "tablebase <material>", which also makes the smaller tables
+// reached by captures and promotions.
+//
+// Generation starts from the checkmates and works backwards. Each pass takes
+// the positions decided the pass before and un-makes moves from them: a
+// position which can move into a loss is a win, and a position whose moves
+// all lead to wins is a loss. Moves which capture or promote leave the table
+// and are looked up in the smaller tables instead. Whatever is undecided at
+// the end is a draw. The passes are split between threads.
+//
+// Positions are indexed by the side to move, the white king and then the
+// square of each other piece. Mirroring the board puts the white king on one
+// of 10 squares (32 with pawns, which can only be mirrored left to right).
+// The file holds each result in as few bits as the longest mate needs, and
+// is memory mapped for probing so tables are shared with the page cache and
+// cost nothing to open.
+//
+// Like the rest of the engine, pawns only promote to queens. En passant,
+// castling and the fifty move rule are ignored.
+
+	// most pieces in a table, including the kings
+#define TB_MAX_PIECES 5
+#define TB_MAGIC 0x54424254
+#define TB_VERSION 1
+#define TB_DIRECTORY "tablebases"
+	// result of a drawn position
+#define TB_DRAW -1
+	// longest distance to mate which can be stored, in plies
+#define TB_MAX_DTM 252
+	// positions taken by a thread at a time while generating
+#define TB_CHUNK 4096
+	// states of a position while generating. A result is the distance to
+	// mate plus 1, so 0 is undecided.
+#define TB_GEN_ILLEGAL 255
+	// a capture or promotion draws, so the position can't be lost
+#define TB_GEN_CANNOT_LOSE 255
+
+namespace Tablebase
+{
+	// mirror a square. Bit 0 flips left to right, bit 1 top to bottom and
+	// bit 2 swaps x and y.
+	inline int transformSquare(int _square, const int _transform)
+	{
+		if ( _transform & 1 )
+		{
+			_square ^= 7;
+		}
+		if ( _transform & 2 )
+		{
+			_square ^= 56;
+		}
+		if ( _transform & 4 )
+		{
+			_square = toSquare(squareY(_square),squareX(_square));
+		}
+		return _square;
+	}
+
+	// the name of some material, with the side with more material first and
+	// the pieces in the order QRBNP. For example KRKN.
+	inline std::string materialCode(const MaterialCount& _material)
+	{
+		static const int ORDER[5] = {QUEEN,ROOK,BISHOP,KNIGHT,PAWN};
+		static const char NAME[5] = {'Q','R','B','N','P'};
+		std::string side[2];
+		for (int team=0;team<2;++team)
+		{
+			side[team] = "K";
+			for (int i=0;i<5;++i)
+			{
+				side[team].append(_material.of(ORDER[i],team),NAME[i]);
+			}
+		}
+		const int whiteValue = _material.material(WHITE);
+		const int blackValue = _material.material(BLACK);
+		if ( whiteValue > blackValue || (whiteValue == blackValue && side[WHITE] >= side[BLACK]) )
+		{
+			return side[WHITE]+side[BLACK];
+		}
+		return side[BLACK]+side[WHITE];
+	}
+
+	// the pieces of a table, and how positions are indexed. The first side in
+	// the code is white.
+	struct Layout
+	{
+		int nPieces;
+		// the white king, the black king, then the other pieces in code order
+		unsigned char piece [TB_MAX_PIECES];
+		bool hasPawns;
+		int nKingSlots;
+		signed char squareSlot [64]; // -1 if the white king is never there
+		unsigned char slotSquare [32];
+		unsigned long long size;
+
+		bool set(const std::string& _code)
+		{
+			nPieces=0;
+			hasPawns=false;
+			if ( _code.size() < 2 || _code.size() > TB_MAX_PIECES || _code[0] != 'K' )
+			{
+				return false;
+			}
+			const size_t blackKing = _code.find('K',1);
+			if ( blackKing == std::string::npos )
+			{
+				return false;
+			}
+
+			piece[nPieces++] = makePiece(KING,WHITE);
+			piece[nPieces++] = makePiece(KING,BLACK);
+			for (size_t i=1;i<_code.size();++i)
+			{
+				if ( i == blackKing )
+				{
+					continue;
+				}
+				const int type = Position::pieceFromChar(_code[i]);
+				if ( type == NO_PIECE || type == KING )
+				{
+					return false;
+				}
+				piece[nPieces++] = makePiece(type,i < blackKing ? WHITE : BLACK);
+				hasPawns |= (type == PAWN);
+			}
+
+			// with pawns the white king is on the left half, otherwise on the
+			// triangle a1-d1-d4.
+			nKingSlots=0;
+			for (int square=0;square<64;++square)
+			{
+				const int x = squareX(square);
+				const int y = squareY(square);
+				squareSlot[square] = -1;
+				if ( x < 4 && (hasPawns || y <= x) )
+				{
+					squareSlot[square] = nKingSlots;
+					slotSquare[nKingSlots++] = square;
+				}
+			}
+
+			size = 2*nKingSlots;
+			for (int i=1;i<nPieces;++i)
+			{
+				size *= 64;
+			}
+			return true;
+		}
+
+		// the position at an index. Returns false if two pieces share a
+		// square or a pawn is on the first or last rank.
+		bool decode(unsigned long long _index, Position& _position) const
+		{
+			int aPieceSquare [TB_MAX_PIECES];
+			for (int i=nPieces-1;i>0;--i)
+			{
+				aPieceSquare[i] = _index % 64;
+				_index /= 64;
+			}
+			aPieceSquare[0] = slotSquare[_index % nKingSlots];
+			_index /= nKingSlots;
+
+			_position.clear();
+			_position.sideToMove = (_index == 0) ? WHITE : BLACK;
+			for (int i=0;i<nPieces;++i)
+			{
+				const int square = aPieceSquare[i];
+				if ( _position.aSquare[square] != 0 ||
+					(pieceType(piece[i]) == PAWN && (squareY(square) == 0 || squareY(square) == 7)) )
+				{
+					return false;
+				}
+				_position.aSquare[square] = piece[i];
+			}
+			_position.hash = _position.computeHash();
+			_position.pawnHash = _position.computePawnHash();
+			_position.materialKey = _position.computeMaterialKey();
+			return true;
+		}
+
+		// index of a position with this material, white being the table's
+		// white. Every mirror image of a position has the same index.
+		unsigned long long encode(const Position& _position) const
+		{
+			const int whiteKing = _position.findKing<WHITE>();
+			int transform = 0;
+			if ( squareX(whiteKing) > 3 )
+			{
+				transform |= 1;
+			}
+			if ( hasPawns == false )
+			{
+				if ( squareY(whiteKing) > 3 )
+				{
+					transform |= 2;
+				}
+				const int king = transformSquare(whiteKing,transform);
+				if ( squareY(king) > squareX(king) )
+				{
+					transform |= 4;
+				}
+				else if ( squareY(king) == squareX(king) )
+				{
+					// on the diagonal both ways round are allowed, take the
+					// lower index
+					const unsigned long long index = encode(_position,transform);
+					const unsigned long long swapped = encode(_position,transform|4);
+					return index < swapped ? index : swapped;
+				}
+			}
+			return encode(_position,transform);
+		}
+
+		private:
+		unsigned long long encode(const Position& _position, const int _transform) const
+		{
+			unsigned char aBoard [64];
+			for (int square=0;square<64;++square)
+			{
+				aBoard[transformSquare(square,_transform)] = _position.aSquare[square];
+			}
+
+			unsigned long long index = (_position.sideToMove == WHITE) ? 0 : 1;
+			int square = 0;
+			for (int i=0;i<nPieces;++i)
+			{
+				// pieces of the same kind are indexed in square order
+				if ( i == 0 || piece[i] != piece[i-1] )
+				{
+					square = 0;
+				}
+				while ( aBoard[square] != piece[i] )
+				{
+					++square;
+				}
+				index = (i == 0) ? index*nKingSlots + squareSlot[square] : index*64 + square;
+				++square;
+			}
+			return index;
+		}
+	};
+
+	struct Header
+	{
+		unsigned int magic;
+		unsigned int version;
+		char code [8];
+		unsigned int bits; // bits per result
+		unsigned int padding;
+		unsigned long long size; // number of results
+	};
+
+	// a read only file mapped into memory
+	class MappedFile
+	{
+	#if defined(_WIN32)
+		HANDLE file;
+		HANDLE mapping;
+	#endif
+		void* data;
+		unsigned long long size;
+
+		public:
+		MappedFile()
+		{
+			data=0;
+			size=0;
+		}
+		~MappedFile()
+		{
+			close();
+		}
+
+		bool open(const std::string& _path)
+		{
+			close();
+		#if defined(_WIN32)
+			file = CreateFileA(_path.c_str(),GENERIC_READ,FILE_SHARE_READ,0,OPEN_EXISTING,FILE_ATTRIBUTE_NORMAL,0);
+			if ( file == INVALID_HANDLE_VALUE )
+			{
+				return false;
+			}
+			LARGE_INTEGER fileSize;
+			GetFileSizeEx(file,&fileSize);
+			size = fileSize.QuadPart;
+			mapping = CreateFileMapping(file,0,PAGE_READONLY,0,0,0);
+			data = mapping ? MapViewOfFile(mapping,FILE_MAP_READ,0,0,0) : 0;
+			if ( data == 0 )
+			{
+				if ( mapping )
+				{
+					CloseHandle(mapping);
+				}
+				CloseHandle(file);
+				size = 0;
+				return false;
+			}
+		#else
+			const int file = ::open(_path.c_str(),O_RDONLY);
+			if ( file == -1 )
+			{
+				return false;
+			}
+			struct stat status;
+			if ( fstat(file,&status) == 0 && status.st_size > 0 )
+			{
+				size = status.st_size;
+				data = mmap(0,size,PROT_READ,MAP_SHARED,file,0);
+				if ( data == MAP_FAILED )
+				{
+					data = 0;
+				}
+			}
+			::close(file);
+			if ( data == 0 )
+			{
+				size = 0;
+				return false;
+			}
+		#endif
+			return true;
+		}
+
+		void close()
+		{
+			if ( data == 0 )
+			{
+				return;
+			}
+		#if defined(_WIN32)
+			UnmapViewOfFile(data);
+			CloseHandle(mapping);
+			CloseHandle(file);
+		#else
+			munmap(data,size);
+		#endif
+			data=0;
+			size=0;
+		}
+
+		const unsigned char* bytes() const
+		{
+			return (const unsigned char*)data;
+		}
+		unsigned long long getSize() const
+		{
+			return size;
+		}
+	};
+
+	// one table, probed from its file
+	class Table
+	{
+		MappedFile file;
+		const unsigned long long* aWord;
+		unsigned int bits;
+		unsigned long long mask;
+
+		public:
+		Layout layout;
+		std::string code;
+
+		bool open(const std::string& _path)
+		{
+			if ( file.open(_path) == false || file.getSize() < sizeof(Header) )
+			{
+				return false;
+			}
+			Header header;
+			memcpy(&header,file.bytes(),sizeof(Header));
+			header.code[7] = 0;
+			code = header.code;
+
+			if ( header.magic != TB_MAGIC || header.version != TB_VERSION || layout.set(code) == false ||
+				header.size != layout.size || header.bits == 0 || header.bits > 8 ||
+				file.getSize() < sizeof(Header) + (header.size*header.bits/64+2)*8 )
+			{
+				file.close();
+				return false;
+			}
+			bits = header.bits;
+			mask = (1ULL << bits)-1;
+			aWord = (const unsigned long long*)(file.bytes()+sizeof(Header));
+			return true;
+		}
+
+		// the stored result: 0 for a draw, otherwise the distance to mate
+		// plus 1
+		unsigned int read(const unsigned long long _index) const
+		{
+			const unsigned long long bit = _index*bits;
+			const unsigned int shift = bit & 63;
+			unsigned long long value = aWord[bit >> 6] >> shift;
+			if ( shift+bits > 64 )
+			{
+				value |= aWord[(bit >> 6)+1] << (64-shift);
+			}
+			return value & mask;
+		}
+	};
+}
+
+// All the tables which have been loaded, looked up by material.
+class Tablebases
+{
+	std::unordered_map <unsigned long long, Tablebase::Table*> mTable;
+	// the white side of the table is black in positions with this key
+	std::unordered_map <unsigned long long, bool> mSwapped;
+	std::vector <Tablebase::Table*> vTable;
+
+	public:
+	int maxPieces;
+
+	Tablebases()
+	{
+		maxPieces=0;
+	}
+	~Tablebases()
+	{
+		for (auto table : vTable)
+		{
+			delete table;
+		}
+	}
+
+	int size() const
+	{
+		return vTable.size();
+	}
+
+	// load every table in a directory. Returns the number loaded.
+	int load(const std::string& _directory)
+	{
+		int nLoaded = 0;
+		std::error_code error;
+		for (const auto& entry : std::filesystem::directory_iterator(_directory,error))
+		{
+			if ( entry.path().extension() == ".tb" && add(entry.path().string()) )
+			{
+				++nLoaded;
+			}
+		}
+		return nLoaded;
+	}
+
+	bool add(const std::string& _path)
+	{
+		Tablebase::Table* table = new Tablebase::Table;
+		if ( table->open(_path) == false || mTable.count(Endgame::signatureKey(table->code,WHITE)) )
+		{
+			delete table;
+			return false;
+		}
+		vTable.push_back(table);
+		mTable[Endgame::signatureKey(table->code,WHITE)] = table;
+		mSwapped[Endgame::signatureKey(table->code,WHITE)] = false;
+		mTable[Endgame::signatureKey(table->code,BLACK)] = table;
+		mSwapped[Endgame::signatureKey(table->code,BLACK)] = true;
+		if ( table->layout.nPieces > maxPieces )
+		{
+			maxPieces = table->layout.nPieces;
+		}
+		return true;
+	}
+
+	// look up a position. Returns false if there's no table for it.
+	// Otherwise _dtm is the distance to mate in plies, which is odd if the
+	// side to move wins and even if it loses, or TB_DRAW.
+	bool probe(const Position& _position, int& _dtm) const
+	{
+		if ( maxPieces == 0 || _position.castling != 0 || _position.enPassant != NO_EN_PASSANT ||
+			pieceTotal(_position.materialKey) > maxPieces )
+		{
+			return false;
+		}
+		// only the kings
+		if ( _position.materialKey == materialBit(WKING)+materialBit(BKING) )
+		{
+			_dtm = TB_DRAW;
+			return true;
+		}
+		auto entry = mTable.find(_position.materialKey);
+		if ( entry == mTable.end() )
+		{
+			return false;
+		}
+
+		const Tablebase::Table& table = *entry->second;
+		unsigned int value;
+		if ( mSwapped.at(_position.materialKey) )
+		{
+			// swap the colours and flip the board to match the table
+			Position swapped;
+			swapped.clear();
+			for (int square=0;square<64;++square)
+			{
+				const unsigned char piece = _position.aSquare[square];
+				swapped.aSquare[square^56] = piece ? makePiece(pieceType(piece),!pieceTeam(piece)) : 0;
+			}
+			swapped.sideToMove = !_position.sideToMove;
+			value = table.read(table.layout.encode(swapped));
+		}
+		else
+		{
+			value = table.read(table.layout.encode(_position));
+		}
+		_dtm = (value == 0) ? TB_DRAW : value-1;
+		return true;
+	}
+
+	// make the table for some material, and any smaller tables it needs
+	// which aren't loaded yet. The file is written to _directory and loaded.
+	bool generate(const std::string& _code, const std::string& _directory, int _nThreads=0);
+
+	private:
+	bool generateTable(const Tablebase::Layout& _layout, const std::string& _code, const std::string& _path, int _nThreads);
+};
+
+namespace Tablebase
+{
+	// run _function(begin,end) over 0.._size, split between threads
+	template <typename FUNCTION> void parallelFor(const unsigned long long _size, const int _nThreads, FUNCTION _function)
+	{
+		std::atomic <unsigned long long> nextChunk(0);
+		auto worker = [&]()
+		{
+			while (true)
+			{
+				const unsigned long long start = nextChunk.fetch_add(TB_CHUNK);
+				if ( start >= _size )
+				{
+					return;
+				}
+				_function(start,(start+TB_CHUNK < _size) ? start+TB_CHUNK : _size);
+			}
+		};
+
+		std::vector <std::thread> vThread;
+		for (int i=1;i<_nThreads;++i)
+		{
+			vThread.emplace_back(worker);
+		}
+		worker();
+		for (auto& thread : vThread)
+		{
+			thread.join();
+		}
+	}
+
+	// the positions which could have moved into this one without capturing
+	// or promoting. Pieces move backwards onto empty squares, pawns
+	// backwards one or two squares.
+	inline int generateUnmoves(const Layout& _layout, const Position& _position, unsigned long long* _aIndex)
+	{
+		const bool mover = !_position.sideToMove;
+		int nIndex = 0;
+
+		for (int from=0;from<64;++from)
+		{
+			const unsigned char piece = _position.aSquare[from];
+			if ( piece == 0 || pieceTeam(piece) != mover )
+			{
+				continue;
+			}
+			const int type = pieceType(piece);
+
+			Bitboard targets = 0;
+			if ( type == KING )
+			{
+				targets = kingAttacks(from);
+			}
+			else if ( type == KNIGHT )
+			{
+				targets = knightAttacks(from);
+			}
+			else if ( type == PAWN )
+			{
+				const int back = (mover == WHITE) ? -8 : 8;
+				const int startRank = (mover == WHITE) ? 1 : 6;
+				const int from1 = from+back;
+				if ( squareY(from1) != 0 && squareY(from1) != 7 && _position.aSquare[from1] == 0 )
+				{
+					targets |= squareBit(from1);
+					if ( squareY(from1+back) == startRank && _position.aSquare[from1+back] == 0 )
+					{
+						targets |= squareBit(from1+back);
+					}
+				}
+			}
+			else
+			{
+				for (int direction=0;direction<8;++direction)
+				{
+					if ( (direction < 4 && type == BISHOP) || (direction >= 4 && type == ROOK) )
+					{
+						continue;
+					}
+					const int step = Tables::DIRECTION_X[direction] + Tables::DIRECTION_Y[direction]*8;
+					int target = from;
+					for (int n=rayLength(from,direction);n>0;--n)
+					{
+						target += step;
+						if ( _position.aSquare[target] != 0 )
+						{
+							break;
+						}
+						targets |= squareBit(target);
+					}
+				}
+			}
+
+			while (targets)
+			{
+				const int to = popSquare(targets);
+				if ( _position.aSquare[to] != 0 )
+				{
+					continue;
+				}
+				Position previous = _position;
+				previous.aSquare[to] = piece;
+				previous.aSquare[from] = 0;
+				previous.sideToMove = mover;
+				// the side which didn't move can't have been left in check
+				if ( previous.isCheck(_position.sideToMove) )
+				{
+					continue;
+				}
+
+				const unsigned long long index = _layout.encode(previous);
+				bool seen = false;
+				for (int i=0;i<nIndex && seen==false;++i)
+				{
+					seen = (_aIndex[i] == index);
+				}
+				if ( seen == false )
+				{
+					_aIndex[nIndex++] = index;
+				}
+			}
+		}
+		return nIndex;
+	}
+}
+
+inline bool Tablebases::generate(const std::string& _code, const std::string& _directory, int _nThreads)
+{
+	Tablebase::Layout layout;
+	if ( layout.set(_code) == false )
+	{
+		return false;
+	}
+	if ( _nThreads <= 0 )
+	{
+		_nThreads = std::thread::hardware_concurrency();
+		if ( _nThreads <= 0 )
+		{
+			_nThreads = 1;
+		}
+	}
+
+	// name the table the standard way, so it is only made once
+	MaterialCount material;
+	material.clear();
+	material.count[0] = 64-layout.nPieces;
+	for (int i=0;i<layout.nPieces;++i)
+	{
+		++material.count[layout.piece[i]];
+	}
+	const std::string code = Tablebase::materialCode(material);
+	if ( mTable.count(material.key()) )
+	{
+		return true;
+	}
+	layout.set(code);
+
+	// first the tables reached by capturing or promoting
+	for (int i=2;i<layout.nPieces;++i)
+	{
+		MaterialCount smaller = material;
+		--smaller.count[layout.piece[i]];
+		++smaller.count[0];
+		if ( smaller.count[0] < 62 && mTable.count(smaller.key()) == 0 &&
+			generate(Tablebase::materialCode(smaller),_directory,_nThreads) == false )
+		{
+			return false;
+		}
+		if ( pieceType(layout.piece[i]) == PAWN )
+		{
+			++smaller.count[makePiece(QUEEN,pieceTeam(layout.piece[i]))];
+			--smaller.count[0];
+			if ( mTable.count(smaller.key()) == 0 &&
+				generate(Tablebase::materialCode(smaller),_directory,_nThreads) == false )
+			{
+				return false;
+			}
+		}
+	}
+
+	std::error_code error;
+	std::filesystem::create_directories(_directory,error);
+	const std::string path = _directory+"/"+code+".tb";
+	if ( add(path) )
+	{
+		return true;
+	}
+	std::cout<<"Generating "<<code<<"\n";
+	return generateTable(layout,code,path,_nThreads) && add(path);
+}
+
+inline bool Tablebases::generateTable(const Tablebase::Layout& _layout, const std::string& _code, const std::string& _path, const int _nThreads)
+{
+	const unsigned long long size = _layout.size;
+	std::atomic <unsigned char> * aValue = new std::atomic <unsigned char> [size];
+	std::atomic <unsigned char> * aCounter = new std::atomic <unsigned char> [size];
+	unsigned char * aPending = new unsigned char [size];
+	// the longest mate found so far, which is how many passes are needed
+	std::atomic <int> longest(0);
+	auto lengthen = [&](const int _dtm)
+	{
+		int current = longest.load();
+		while ( _dtm > current && longest.compare_exchange_weak(current,_dtm) == false )
+		{
+		}
+	};
+
+	// Find the mates, count each position's moves within the table, and
+	// look up where its captures and promotions lead. aPending holds the
+	// best a capture or promotion can do: an odd distance is a win, an even
+	// one is how long the loss can be dragged out.
+	Tablebase::parallelFor(size,_nThreads,[&](const unsigned long long _begin, const unsigned long long _end)
+	{
+		MoveList moves;
+		unsigned long long aChild [256];
+
+		for (unsigned long long index=_begin;index<_end;++index)
+		{
+			aValue[index] = 0;
+			aCounter[index] = 0;
+			aPending[index] = 0;
+
+			Position position;
+			if ( _layout.decode(index,position) == false || _layout.encode(position) != index ||
+				position.isCheck(!position.sideToMove) )
+			{
+				aValue[index] = TB_GEN_ILLEGAL;
+				continue;
+			}
+
+			moves.clear();
+			position.generateLegalMoves(moves);
+			if ( moves.size() == 0 )
+			{
+				if ( position.isCheck(position.sideToMove) )
+				{
+					aValue[index] = 1;
+				}
+				else
+				{
+					aPending[index] = TB_GEN_CANNOT_LOSE;
+				}
+				continue;
+			}
+
+			int nChild = 0;
+			int bestWin = -1;
+			int longestLoss = 0;
+			bool canDraw = false;
+			for (int i=0;i<moves.size();++i)
+			{
+				Position child = position;
+				child.makeMove(moves(i));
+				child.enPassant = NO_EN_PASSANT;
+
+				if ( position.aSquare[moves(i).to()] != 0 || moves(i).type() == MOVE_PROMOTION )
+				{
+					int dtm = TB_DRAW;
+					probe(child,dtm);
+					if ( dtm == TB_DRAW )
+					{
+						canDraw = true;
+					}
+					else if ( dtm % 2 == 0 )
+					{
+						if ( bestWin == -1 || dtm+1 < bestWin )
+						{
+							bestWin = dtm+1;
+						}
+					}
+					else if ( dtm+1 > longestLoss )
+					{
+						longestLoss = dtm+1;
+					}
+					continue;
+				}
+
+				const unsigned long long childIndex = _layout.encode(child);
+				bool seen = false;
+				for (int j=0;j<nChild && seen==false;++j)
+				{
+					seen = (aChild[j] == childIndex);
+				}
+				if ( seen == false )
+				{
+					aChild[nChild++] = childIndex;
+				}
+			}
+
+			if ( bestWin != -1 )
+			{
+				aPending[index] = std::min(bestWin,TB_MAX_DTM-1);
+			}
+			else if ( canDraw )
+			{
+				aPending[index] = TB_GEN_CANNOT_LOSE;
+			}
+			else
+			{
+				aPending[index] = std::min(longestLoss,TB_MAX_DTM);
+			}
+			aCounter[index] = nChild;
+
+			// every move captures or promotes into a lost position
+			if ( nChild == 0 && bestWin == -1 && canDraw == false )
+			{
+				aValue[index] = aPending[index]+1;
+			}
+			if ( aPending[index] != TB_GEN_CANNOT_LOSE )
+			{
+				lengthen(aPending[index]);
+			}
+		}
+	});
+
+	// Work backwards from the positions decided with each distance.
+	for (int dtm=0;dtm<=longest.load() && dtm<=TB_MAX_DTM;++dtm)
+	{
+		Tablebase::parallelFor(size,_nThreads,[&](const unsigned long long _begin, const unsigned long long _end)
+		{
+			unsigned long long aPrevious [256];
+
+			for (unsigned long long index=_begin;index<_end;++index)
+			{
+				// a win by capturing or promoting, if nothing was quicker
+				if ( dtm % 2 == 1 && aPending[index] == dtm && aValue[index].load(std::memory_order_relaxed) == 0 )
+				{
+					aValue[index].store(dtm+1,std::memory_order_relaxed);
+				}
+				if ( aValue[index].load(std::memory_order_relaxed) != dtm+1 )
+				{
+					continue;
+				}
+
+				Position position;
+				_layout.decode(index,position);
+				const int nPrevious = Tablebase::generateUnmoves(_layout,position,aPrevious);
+
+				for (int i=0;i<nPrevious;++i)
+				{
+					std::atomic <unsigned char>& value = aValue[aPrevious[i]];
+					if ( value.load(std::memory_order_relaxed) != 0 )
+					{
+						continue;
+					}
+					if ( dtm % 2 == 0 )
+					{
+						// it can move into a lost position
+						unsigned char undecided = 0;
+						if ( value.compare_exchange_strong(undecided,(unsigned char)std::min(dtm+2,TB_MAX_DTM)) )
+						{
+							lengthen(dtm+1);
+						}
+					}
+					else
+					{
+						const unsigned char pending = aPending[aPrevious[i]];
+						if ( pending == TB_GEN_CANNOT_LOSE || pending % 2 == 1 )
+						{
+							continue;
+						}
+						// the last of its moves has turned out to lose
+						if ( aCounter[aPrevious[i]].fetch_sub(1) == 1 )
+						{
+							const int loss = std::min(std::max(dtm+1,(int)pending),TB_MAX_DTM);
+							value.store(loss+1,std::memory_order_relaxed);
+							lengthen(loss);
+						}
+					}
+				}
+			}
+		});
+	}
+
+	// pack the results into as few bits as the longest mate needs
+	unsigned int maxValue = 0;
+	for (unsigned long long index=0;index<size;++index)
+	{
+		if ( aValue[index] != TB_GEN_ILLEGAL && aValue[index] > maxValue )
+		{
+			maxValue = aValue[index];
+		}
+	}
+	unsigned int bits = 1;
+	while ( (1u << bits) <= maxValue )
+	{
+		++bits;
+	}
+
+	const unsigned long long nWords = size*bits/64+2;
+	std::vector <unsigned long long> vWord (nWords,0);
+	for (unsigned long long index=0;index<size;++index)
+	{
+		const unsigned long long value = (aValue[index] == TB_GEN_ILLEGAL) ? 0 : aValue[index].load();
+		const unsigned long long bit = index*bits;
+		const unsigned int shift = bit & 63;
+		vWord[bit >> 6] |= value << shift;
+		if ( shift+bits > 64 )
+		{
+			vWord[(bit >> 6)+1] |= value >> (64-shift);
+		}
+	}
+	delete [] aValue;
+	delete [] aCounter;
+	delete [] aPending;
+
+	Tablebase::Header header;
+	memset(&header,0,sizeof(header));
+	header.magic = TB_MAGIC;
+	header.version = TB_VERSION;
+	strncpy(header.code,_code.c_str(),7);
+	header.bits = bits;
+	header.size = size;
+
+	std::ofstream file(_path,std::ios::binary);
+	file.write((const char*)&header,sizeof(header));
+	file.write((const char*)vWord.data(),nWords*8);
+	return file.good();
+}
@@ -0,0 +1,209 @@
+// Attack and geometry lookup tables.
+// All tables are built by constexpr functions, so they are baked into the
+// executable and there is no initialisation cost at startup. Move generation
+// reads targets from them instead of bounds checking each offset.
+
+// Tiles are indexed as x + y*8, so bit 0 is (0,0) and bit 63 is (7,7).
+typedef unsigned long long Bitboard;
+
+constexpr int toSquare(const int _x, const int _y)
+{
+	return _x + _y*8;
+}
+constexpr int squareX(const int _square)
+{
+	return _square & 7;
+}
+constexpr int squareY(const int _square)
+{
+	return _square >> 3;
+}
+constexpr Bitboard squareBit(const int _square)
+{
+	return 1ULL << _square;
+}
+
+// return the lowest set square and remove it from the bitboard.
+inline int popSquare(Bitboard& _bitboard)
+{
+#if defined(_MSC_VER)
+	unsigned long square;
+	_BitScanForward64(&square,_bitboard);
+#else
+	const int square = __builtin_ctzll(_bitboard);
+#endif
+	_bitboard &= _bitboard-1;
+	return square;
+}
+
+inline int countSquares(Bitboard _bitboard)
+{
+#if defined(_MSC_VER)
+	return (int)__popcnt64(_bitboard);
+#else
+	return __builtin_popcountll(_bitboard);
+#endif
+}
+
+namespace Tables
+{
+	// Sliding directions: 4 straight lines then 4 diagonals.
+	constexpr int DIRECTION_X[8] = {0,0,-1,1,-1,1,-1,1};
+	constexpr int DIRECTION_Y[8] = {-1,1,0,0,-1,-1,1,1};
+
+	constexpr bool onBoard(const int _x, const int _y)
+	{
+		return (_x<8 && _x>=0 && _y<8 && _y>=0);
+	}
+
+	constexpr int absolute(const int _value)
+	{
+		return _value < 0 ? -_value : _value;
+	}
+
+	struct AttackTables
+	{
+		Bitboard knight [64];
+		Bitboard king [64];
+		// pawn attacks, indexed by team (BLACK=0, WHITE=1) then square.
+		Bitboard pawn [2][64];
+		// number of steps from a square to the edge in each direction.
+		unsigned char rayLength [64][8];
+	};
+
+	struct GeometryTables
+	{
+		// squares strictly between two squares on a shared line or diagonal
+		Bitboard between [64][64];
+		// the full line or diagonal through two squares, edge to edge
+		Bitboard line [64][64];
+		// king distance (number of king steps) between two squares
+		unsigned char distance [64][64];
+	};
+
+	constexpr Bitboard offsetBit(const int _x, const int _y)
+	{
+		return onBoard(_x,_y) ? squareBit(toSquare(_x,_y)) : 0ULL;
+	}
+
+	constexpr AttackTables buildAttackTables()
+	{
+		const int knightX[8] = {-2,-2,2,2,1,-1,1,-1};
+		const int knightY[8] = {1,-1,1,-1,2,2,-2,-2};
+
+		AttackTables t {};
+		for (int square=0;square<64;++square)
+		{
+			const int x = squareX(square);
+			const int y = squareY(square);
+
+			for (int i=0;i<8;++i)
+			{
+				t.knight[square] |= offsetBit(x+knightX[i],y+knightY[i]);
+				t.king[square] |= offsetBit(x+DIRECTION_X[i],y+DIRECTION_Y[i]);
+
+				int steps = 0;
+				while (onBoard(x+DIRECTION_X[i]*(steps+1),y+DIRECTION_Y[i]*(steps+1)))
+				{
+					++steps;
+				}
+				t.rayLength[square][i] = steps;
+			}
+			t.pawn[1][square] = offsetBit(x-1,y+1) | offsetBit(x+1,y+1);
+			t.pawn[0][square] = offsetBit(x-1,y-1) | offsetBit(x+1,y-1);
+		}
+		return t;
+	}
+
+	constexpr GeometryTables buildGeometryTables()
+	{
+		GeometryTables t {};
+		for (int from=0;from<64;++from)
+		{
+			const int x = squareX(from);
+			const int y = squareY(from);
+
+			for (int to=0;to<64;++to)
+			{
+				const int dx = absolute(squareX(to)-x);
+				const int dy = absolute(squareY(to)-y);
+				t.distance[from][to] = dx > dy ? dx : dy;
+			}
+
+			// walk out along each direction. Every square reached shares a
+			// line with the start square.
+			for (int i=0;i<8;++i)
+			{
+				// the full line is this ray plus the opposite ray
+				Bitboard fullLine = squareBit(from);
+				for (int sign=-1;sign<=1;sign+=2)
+				{
+					int x2 = x+DIRECTION_X[i]*sign;
+					int y2 = y+DIRECTION_Y[i]*sign;
+					while (onBoard(x2,y2))
+					{
+						fullLine |= squareBit(toSquare(x2,y2));
+						x2+=DIRECTION_X[i]*sign;
+						y2+=DIRECTION_Y[i]*sign;
+					}
+				}
+
+				Bitboard passed = 0;
+				int x2 = x+DIRECTION_X[i];
+				int y2 = y+DIRECTION_Y[i];
+				while (onBoard(x2,y2))
+				{
+					const int to = toSquare(x2,y2);
+					t.between[from][to] = passed;
+					t.line[from][to] = fullLine;
+					passed |= squareBit(to);
+					x2+=DIRECTION_X[i];
+					y2+=DIRECTION_Y[i];
+				}
+			}
+		}
+		return t;
+	}
+
+	constexpr AttackTables ATTACK = buildAttackTables();
+	constexpr GeometryTables GEOMETRY = buildGeometryTables();
+}
+
+// shorthand lookups
+constexpr Bitboard knightAttacks(const int _square)
+{
+	return Tables::ATTACK.knight[_square];
+}
+constexpr Bitboard kingAttacks(const int _square)
+{
+	return Tables::ATTACK.king[_square];
+}
+// squares attacked by a pawn of _team standing on _square
+constexpr Bitboard pawnAttacks(const bool _team, const int _square)
+{
+	return Tables::ATTACK.pawn[_team][_square];
+}
+constexpr int rayLength(const int _square, const int _direction)
+{
+	return Tables::ATTACK.rayLength[_square][_direction];
+}
+constexpr Bitboard betweenSquares(const int _from, const int _to)
+{
+	return Tables::GEOMETRY.between[_from][_to];
+}
+constexpr Bitboard lineThrough(const int _from, const int _to)
+{
+	return Tables::GEOMETRY.line[_from][_to];
+}
+constexpr int squareDistance(const int _from, const int _to)
+{
+	return Tables::GEOMETRY.distance[_from][_to];
+}
+
+// sanity checks, evaluated by the compiler
+static_assert(knightAttacks(toSquare(0,0)) == (squareBit(toSquare(1,2)) | squareBit(toSquare(2,1))), "knight table");
+static_assert(kingAttacks(toSquare(7,7)) == (squareBit(toSquare(6,7)) | squareBit(toSquare(6,6)) | squareBit(toSquare(7,6))), "king table");
+static_assert(pawnAttacks(WHITE,toSquare(0,1)) == squareBit(toSquare(1,2)), "pawn table");
+static_assert(betweenSquares(toSquare(0,0),toSquare(3,3)) == (squareBit(toSquare(1,1)) | squareBit(toSquare(2,2))), "between table");
+static_assert(betweenSquares(toSquare(0,0),toSquare(1,2)) == 0, "between table");
+static_assert(squareDistance(toSquare(0,0),toSquare(7,3)) == 7, "distance table");
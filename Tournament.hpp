@@ -0,0 +1,524 @@
+#include <cmath>
+#include <mutex>
+
+// Self-play matches between two kinds of player, for measuring whether a
+// change makes the engine stronger.
+// Games are played in parallel, each thread taking the next game when it
+// finishes one. Every game has its own players, positions, history, random
+// numbers and transposition tables, so games don't affect each other. The
+// evaluation cache is still shared, but only holds scores which are the same
+// whichever game finds them.
+// Games are played in pairs from the same random opening, with the colours
+// swapped, so neither player gets a better set of openings.
+
+	// random plies played from the start position before a game begins
+#define MATCH_OPENING_MIN_PLIES 2
+#define MATCH_OPENING_MAX_PLIES 8
+	// games this long are drawn
+#define MATCH_MAX_PLIES 400
+	// megabytes for each searching player's own transposition table
+#define MATCH_TABLE_MB 1
+	// print the score after this many games
+#define MATCH_REPORT_EVERY 100
+
+	// player types
+#define PLAYER_RANDOM 0
+#define PLAYER_GREEDY 1
+#define PLAYER_DEPTH 2
+#define PLAYER_ALPHABETA 3
+
+// the kind of player, written as random, greedy, depth=<plies> or
+// alphabeta=<nodes per move>
+struct PlayerSpec
+{
+	int type;
+	unsigned long long amount;
+	std::string name;
+
+	bool parse(const std::string& _text)
+	{
+		name = _text;
+		const size_t equals = _text.find('=');
+		const std::string type_name = _text.substr(0,equals);
+		amount = (equals == std::string::npos) ? 0 : strtoull(_text.c_str()+equals+1,0,10);
+
+		if ( type_name == "random" ) { type = PLAYER_RANDOM; }
+		else if ( type_name == "greedy" ) { type = PLAYER_GREEDY; }
+		else if ( type_name == "depth" ) { type = PLAYER_DEPTH; }
+		else if ( type_name == "alphabeta" ) { type = PLAYER_ALPHABETA; }
+		else
+		{
+			return false;
+		}
+		return ( (type != PLAYER_DEPTH && type != PLAYER_ALPHABETA) || amount > 0 );
+	}
+};
+
+// one player in one game
+class MatchPlayer
+{
+	PlayerSpec spec;
+	TranspositionTable* table;
+	Search* search;
+
+	public:
+	// searched nodes and the time spent searching them, in microseconds
+	unsigned long long nNodes;
+	long long searchTime;
+	// the score in pawns, depth and time in microseconds of the last search
+	int lastScore;
+	int lastDepth;
+	long long lastTime;
+
+	MatchPlayer(const PlayerSpec& _spec, GameHistory* _history)
+	{
+		spec = _spec;
+		table = 0;
+		search = 0;
+		if ( spec.type == PLAYER_DEPTH || spec.type == PLAYER_ALPHABETA )
+		{
+			table = new TranspositionTable(MATCH_TABLE_MB);
+			search = new Search(_history,table);
+		}
+		nNodes = 0;
+		searchTime = 0;
+		lastScore = GAME_RECORD_NO_SCORE;
+		lastDepth = 0;
+		lastTime = 0;
+	}
+	bool searches() const
+	{
+		return search != 0;
+	}
+	~MatchPlayer()
+	{
+		delete search;
+		delete table;
+	}
+
+	// the move to play. The position has at least one legal move.
+	Move choose(Position& _position, Random& _random)
+	{
+		MoveList moves;
+		_position.generateLegalMoves(moves);
+
+		if ( spec.type == PLAYER_RANDOM )
+		{
+			return moves(_random.rand(moves.size()-1));
+		}
+		if ( spec.type == PLAYER_GREEDY )
+		{
+			return greedy(_position,moves,_random);
+		}
+
+		const long long start = searchClock();
+		if ( spec.type == PLAYER_DEPTH )
+		{
+			search->nNodes = 0;
+			lastScore = search->search(_position,(int)spec.amount);
+			lastDepth = (int)spec.amount;
+		}
+		else
+		{
+			SearchControl control;
+			control.maxNodes = spec.amount;
+			lastScore = search->think(_position,control,[](const int, const int) {});
+			lastDepth = search->completedDepth;
+		}
+		lastTime = searchClock()-start;
+		searchTime += lastTime;
+		nNodes += search->nNodes;
+		return search->bestMove.isNull() ? moves(0) : search->bestMove;
+	}
+
+	private:
+	// the move which leaves the best evaluation, choosing at random between
+	// equal moves
+	static Move greedy(Position& _position, MoveList& _moves, Random& _random)
+	{
+		const bool team = _position.sideToMove;
+		MoveList best;
+		int bestScore = 0;
+		for (int i=0;i<_moves.size();++i)
+		{
+			Position child = _position;
+			child.makeMove(_moves(i));
+			const int score = evaluate(child,team);
+			if ( best.size() == 0 || score > bestScore )
+			{
+				best.clear();
+				bestScore = score;
+			}
+			if ( score == bestScore )
+			{
+				best.push(_moves(i));
+			}
+		}
+		return best(_random.rand(best.size()-1));
+	}
+};
+
+struct GameResult
+{
+	// 1 if the first player won, -1 if they lost, 0 for a draw
+	int score;
+	int nPlies;
+	unsigned long long nNodes;
+	long long searchTime;
+};
+
+// a game from a random opening. The first player has white if
+// _firstIsWhite. _opening chooses the opening and _random the random choices
+// made during the game. The game is recorded in _record if it is given.
+inline GameResult playMatchGame(const PlayerSpec& _first, const PlayerSpec& _second, const bool _firstIsWhite,
+	Random _opening, Random _random, GameRecord* _record=0)
+{
+	GameHistory history;
+	history.clear();
+	MatchPlayer first(_first,&history);
+	MatchPlayer second(_second,&history);
+
+	Position position;
+	position.reset();
+	const int openingPlies = MATCH_OPENING_MIN_PLIES + _opening.rand(MATCH_OPENING_MAX_PLIES-MATCH_OPENING_MIN_PLIES);
+	for (int ply=0;ply<openingPlies;++ply)
+	{
+		MoveList moves;
+		position.generateLegalMoves(moves);
+		if ( moves.size() == 0 )
+		{
+			break;
+		}
+		history.push(position.hash);
+		position.makeMove(moves(_opening.rand(moves.size()-1)));
+	}
+	if ( _record != 0 )
+	{
+		_record->begin(position,(_firstIsWhite ? _first : _second).name,(_firstIsWhite ? _second : _first).name,
+			first.searches() || second.searches());
+	}
+
+	GameResult result;
+	result.score = 0;
+	result.nPlies = 0;
+	int outcome = GAME_UNFINISHED;
+	while (true)
+	{
+		outcome = adjudicate(position,history);
+		if ( outcome != GAME_UNFINISHED )
+		{
+			break;
+		}
+		if ( result.nPlies >= MATCH_MAX_PLIES )
+		{
+			outcome = GAME_DRAW;
+			break;
+		}
+
+		const bool firstToMove = (position.sideToMove == WHITE) == _firstIsWhite;
+		MatchPlayer& player = firstToMove ? first : second;
+		const Move move = player.choose(position,_random);
+		if ( _record != 0 )
+		{
+			_record->addMove(move,player.searches() ? player.lastScore : GAME_RECORD_NO_SCORE,player.lastDepth,
+				player.lastTime/1000);
+		}
+		history.push(position.hash);
+		position.makeMove(move);
+		++result.nPlies;
+	}
+	if ( outcome != GAME_DRAW )
+	{
+		result.score = ((outcome == GAME_WHITE_WINS) == _firstIsWhite) ? 1 : -1;
+	}
+	if ( _record != 0 )
+	{
+		_record->finish(outcome);
+	}
+
+	result.nNodes = first.nNodes+second.nNodes;
+	result.searchTime = first.searchTime+second.searchTime;
+	return result;
+}
+
+// wins, draws and losses of the first player, and the Elo difference they
+// suggest
+struct MatchScore
+{
+	int nWins;
+	int nDraws;
+	int nLosses;
+
+	int nGames() const
+	{
+		return nWins+nDraws+nLosses;
+	}
+	// the first player's average score per game, from 0 to 1
+	double fraction() const
+	{
+		return nGames() == 0 ? 0.5 : (nWins+nDraws*0.5)/nGames();
+	}
+	static double eloFromFraction(const double _fraction)
+	{
+		if ( _fraction <= 0 )
+		{
+			return -INFINITY;
+		}
+		if ( _fraction >= 1 )
+		{
+			return INFINITY;
+		}
+		return -400*std::log10(1/_fraction-1);
+	}
+	double elo() const
+	{
+		return eloFromFraction(fraction());
+	}
+	// half the width of the 95% confidence interval, from the variance of
+	// the score of each game
+	double eloError() const
+	{
+		const int n = nGames();
+		if ( n == 0 )
+		{
+			return INFINITY;
+		}
+		const double mean = fraction();
+		const double variance = (nWins*(1-mean)*(1-mean) + nDraws*(0.5-mean)*(0.5-mean) + nLosses*mean*mean)/n;
+		const double error = 1.96*std::sqrt(variance/n);
+		if ( mean-error <= 0 || mean+error >= 1 )
+		{
+			return INFINITY;
+		}
+		return (eloFromFraction(mean+error)-eloFromFraction(mean-error))/2;
+	}
+	std::string toString() const
+	{
+		char text [128];
+		snprintf(text,sizeof(text),"+%d =%d -%d, Elo %.1f +/- %.1f",nWins,nDraws,nLosses,elo(),eloError());
+		return text;
+	}
+};
+
+	// default error rates of a sequential test
+#define SPRT_ALPHA 0.05
+#define SPRT_BETA 0.05
+	// added to each pentanomial count, so the first few pairs don't look
+	// more certain than they are
+#define SPRT_PRIOR 0.5
+
+// A sequential probability ratio test, deciding between the hypotheses that
+// the first player is elo0 or elo1 stronger than the second, with false
+// positive rate alpha and false negative rate beta. The match stops as soon
+// as the log likelihood ratio leaves its bounds.
+// Games of a pair are from the same opening, so they aren't independent.
+// Instead the test counts the five possible scores of a pair, 0 to 2 in half
+// points (the pentanomial), and uses the variance of those. The ratio is the
+// usual normal approximation for logistic Elo.
+struct Sprt
+{
+	double elo0;
+	double elo1;
+	double alpha;
+	double beta;
+	// pairs scoring 0, 0.5, 1, 1.5 and 2 points
+	int aPairs [5];
+
+	Sprt(const double _elo0=0, const double _elo1=5, const double _alpha=SPRT_ALPHA, const double _beta=SPRT_BETA)
+	{
+		elo0=_elo0;
+		elo1=_elo1;
+		alpha=_alpha;
+		beta=_beta;
+		for (int i=0;i<5;++i)
+		{
+			aPairs[i]=0;
+		}
+	}
+
+	// _score is the first player's score in each game of the pair, 1 for a
+	// win, 0 for a draw and -1 for a loss
+	void addPair(const int _score1, const int _score2)
+	{
+		++aPairs[_score1+_score2+2];
+	}
+	int nPairs() const
+	{
+		return aPairs[0]+aPairs[1]+aPairs[2]+aPairs[3]+aPairs[4];
+	}
+
+	double lowerBound() const
+	{
+		return std::log(beta/(1-alpha));
+	}
+	double upperBound() const
+	{
+		return std::log((1-beta)/alpha);
+	}
+
+	double llr() const
+	{
+		const int n = nPairs();
+		if ( n == 0 )
+		{
+			return 0;
+		}
+		double total = 0;
+		double mean = 0;
+		for (int i=0;i<5;++i)
+		{
+			total += aPairs[i]+SPRT_PRIOR;
+			mean += (aPairs[i]+SPRT_PRIOR)*i/4.0;
+		}
+		mean /= total;
+		double variance = 0;
+		for (int i=0;i<5;++i)
+		{
+			variance += (aPairs[i]+SPRT_PRIOR)*(i/4.0-mean)*(i/4.0-mean);
+		}
+		variance /= total;
+
+		const double score0 = expectedScore(elo0);
+		const double score1 = expectedScore(elo1);
+		return n*(score1-score0)*(2*mean-score0-score1)/(2*variance);
+	}
+
+	// 1 if elo1 is accepted, -1 if elo0 is, 0 if the test goes on
+	int decision() const
+	{
+		const double ratio = llr();
+		return ratio >= upperBound() ? 1 : (ratio <= lowerBound() ? -1 : 0);
+	}
+
+	std::string toString() const
+	{
+		char text [160];
+		snprintf(text,sizeof(text),"LLR %.2f (%.2f, %.2f) [%.1f, %.1f], pairs %d %d %d %d %d",
+			llr(),lowerBound(),upperBound(),elo0,elo1,aPairs[0],aPairs[1],aPairs[2],aPairs[3],aPairs[4]);
+		return text;
+	}
+
+	private:
+	static double expectedScore(const double _elo)
+	{
+		return 1/(1+std::pow(10,-_elo/400));
+	}
+};
+
+// play _nGames games between two players on _nThreads threads, printing the
+// result. _nThreads 0 uses every core. Given a Sprt, _nGames is the most to
+// play and the match stops once the test is decided. Given a writer, every
+// game is recorded.
+inline MatchScore playMatch(const PlayerSpec& _first, const PlayerSpec& _second, int _nGames, int _nThreads=0,
+	const uint64_t _seed=1, Sprt* _sprt=0, GameRecordWriter* _writer=0)
+{
+	if ( _nThreads <= 0 )
+	{
+		_nThreads = std::thread::hardware_concurrency();
+		if ( _nThreads <= 0 )
+		{
+			_nThreads = 1;
+		}
+	}
+	// whole pairs
+	_nGames += _nGames%2;
+
+	std::vector <GameResult> vResult(_nGames);
+	std::vector <char> vFinished(_nGames,0);
+	std::atomic <int> nextGame(0);
+	std::atomic <bool> decided(false);
+	std::mutex reportMutex;
+	MatchScore running = {0,0,0};
+
+	// both games of a pair get the same opening. Each game's numbers depend
+	// only on the seed and the game, not on which thread plays it or when.
+	const Random openings(_seed,0);
+	const Random games(_seed,1);
+
+	const long long start = searchClock();
+	auto worker = [&]()
+	{
+		while ( decided == false )
+		{
+			const int game = nextGame.fetch_add(1);
+			if ( game >= _nGames )
+			{
+				return;
+			}
+			GameRecord record;
+			const GameResult result = playMatchGame(_first,_second,game%2 == 0,openings.split(game/2),games.split(game),
+				_writer != 0 ? &record : 0);
+			if ( _writer != 0 )
+			{
+				_writer->write(record);
+			}
+
+			std::lock_guard <std::mutex> lock(reportMutex);
+			vResult[game] = result;
+			vFinished[game] = 1;
+			++(result.score > 0 ? running.nWins : result.score < 0 ? running.nLosses : running.nDraws);
+			if ( running.nGames() % MATCH_REPORT_EVERY == 0 )
+			{
+				std::cout<<"Games "<<running.nGames()<<": "<<running.toString();
+				if ( _sprt != 0 )
+				{
+					std::cout<<", "<<_sprt->toString();
+				}
+				std::cout<<"\n";
+			}
+
+			const int other = game^1;
+			if ( _sprt != 0 && decided == false && vFinished[other] )
+			{
+				_sprt->addPair(result.score,vResult[other].score);
+				if ( _sprt->decision() != 0 )
+				{
+					decided = true;
+				}
+			}
+		}
+	};
+
+	std::vector <std::thread> vThread;
+	for (int i=0;i<_nThreads;++i)
+	{
+		vThread.emplace_back(worker);
+	}
+	for (auto& thread : vThread)
+	{
+		thread.join();
+	}
+	const long long elapsed = searchClock()-start;
+
+	unsigned long long nNodes = 0;
+	long long searchTime = 0;
+	long long nPlies = 0;
+	for (int i=0;i<_nGames;++i)
+	{
+		if ( vFinished[i] )
+		{
+			nNodes += vResult[i].nNodes;
+			searchTime += vResult[i].searchTime;
+			nPlies += vResult[i].nPlies;
+		}
+	}
+	const int nPlayed = running.nGames();
+
+	std::cout<<_first.name<<" vs "<<_second.name<<": "<<running.toString()<<"\n";
+	std::cout<<"Score "<<running.fraction()*100<<"% over "<<nPlayed<<" games in "<<elapsed/1000000.0<<" seconds\n";
+	if ( nPlayed > 0 )
+	{
+		std::cout<<"Average game length "<<(double)nPlies/nPlayed<<" plies\n";
+	}
+	if ( searchTime > 0 )
+	{
+		std::cout<<"Average search speed "<<(unsigned long long)(nNodes*1000000.0/searchTime)<<" nodes per second per thread\n";
+	}
+	if ( _sprt != 0 )
+	{
+		const int decision = _sprt->decision();
+		std::cout<<"SPRT "<<_sprt->toString()<<": "<<(decision > 0 ? "H1 accepted" : decision < 0 ? "H0 accepted" :
+			"no decision")<<"\n";
+	}
+	return running;
+}
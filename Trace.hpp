@@ -0,0 +1,63 @@
+// A breakdown of the handcrafted evaluation into terms, for tuning.
+// Most of the evaluation is a sum of weights multiplied by counts, such as
+// the number of isolated pawns. Evaluating with an EvalTrace records the
+// counts, white's minus black's, so the tuner can score a position with new
+// weights without evaluating it again.
+
+enum eTerm
+{
+	// material, in pawns
+	TERM_PAWN=0,
+	TERM_KNIGHT,
+	TERM_BISHOP,
+	TERM_ROOK,
+	TERM_QUEEN,
+	// imbalance
+	TERM_BISHOP_PAIR,
+	TERM_KNIGHT_PAWNS,
+	TERM_ROOK_PAWNS,
+	// positional, counted from the attack map
+	TERM_MOBILITY,
+	TERM_KING_ZONE,
+	TERM_SPACE,
+	TERM_HANGING,
+	// pawn structure. Passed pawns by rank, counted from the pawn's own side.
+	TERM_DOUBLED,
+	TERM_ISOLATED,
+	TERM_BACKWARD,
+	TERM_PASSED_RANK_2,
+	TERM_PASSED_RANK_3,
+	TERM_PASSED_RANK_4,
+	TERM_PASSED_RANK_5,
+	TERM_PASSED_RANK_6,
+	TERM_PASSED_RANK_7,
+	TERM_SHIELD_NEAR,
+	TERM_SHIELD_FAR,
+	N_TERMS
+};
+
+struct EvalTrace
+{
+	short coefficient [N_TERMS];
+
+	void clear()
+	{
+		memset(coefficient,0,sizeof(coefficient));
+	}
+	// _count of a term for _team
+	void add(const int _term, const bool _team, const int _count)
+	{
+		coefficient[_term] += (_team == WHITE) ? _count : -_count;
+	}
+};
+
+// names of the terms, for printing tuned weights
+const char* const TERM_NAME [N_TERMS] =
+{
+	"pawn","knight","bishop","rook","queen",
+	"bishop pair","knight per pawn","rook per pawn",
+	"mobility","king zone attack","space","hanging",
+	"doubled pawn","isolated pawn","backward pawn",
+	"passed rank 2","passed rank 3","passed rank 4","passed rank 5","passed rank 6","passed rank 7",
+	"shield near","shield far"
+};
@@ -0,0 +1,226 @@
+#include <fstream>
+#include <mutex>
+
+// Labelled positions for training the network, made by self-play.
+// Threads play games with a searching player, each game from a few random
+// moves so they differ. Quiet positions are kept with the search's score, and
+// once the game ends, its result. Positions aren't kept when the side to move
+// is in check, the move chosen is a capture or promotion, or the score is a
+// mate or very large, as those don't show what the evaluation should learn.
+// Each position is packed into 32 bytes, so a file is a plain array which
+// can be memory mapped, indexed directly and shuffled by swapping records.
+// Threads fill their own buffers and only lock to append a full one.
+
+	// random plies at the start of each game
+#define TRAINING_RANDOM_PLIES 8
+	// positions with larger scores, in pawns, aren't kept
+#define TRAINING_MAX_SCORE 20
+	// positions a thread collects before writing them
+#define TRAINING_CHUNK 4096
+	// print progress after this many positions
+#define TRAINING_REPORT_EVERY 100000
+
+// A position with its labels. Pieces are listed as 4 bit codes (see
+// Piece.hpp), two to a byte, in the order of the squares in occupied.
+struct PackedPosition
+{
+	unsigned long long occupied;
+	unsigned char aPiece [16];
+	short score; // centipawns, for the side to move
+	signed char result; // for the side to move: 1 won, 0 drawn, -1 lost
+	unsigned char flags; // bit 0 white to move, bits 1 to 4 castling rights
+	signed char enPassant;
+	unsigned char halfmoveClock;
+	unsigned short ply; // plies since the start of the game
+
+	// _score is in pawns. Positions have at most 32 pieces.
+	void pack(const Position& _position, const int _score, const int _result, const int _ply)
+	{
+		memset(this,0,sizeof(PackedPosition));
+		int nPieces = 0;
+		for (int square=0;square<64;++square)
+		{
+			const unsigned char piece = _position.aSquare[square];
+			if ( piece != 0 && nPieces < 32 )
+			{
+				occupied |= 1ULL << square;
+				aPiece[nPieces/2] |= piece << (4*(nPieces%2));
+				++nPieces;
+			}
+		}
+		score = (short)(_score*100);
+		result = (signed char)_result;
+		flags = (_position.sideToMove == WHITE ? 1 : 0) | (_position.castling << 1);
+		enPassant = _position.enPassant;
+		halfmoveClock = _position.halfmoveClock;
+		ply = (unsigned short)(_ply < 65535 ? _ply : 65535);
+	}
+
+	void unpack(Position& _position) const
+	{
+		_position.clear();
+		int nPieces = 0;
+		for (int square=0;square<64;++square)
+		{
+			if ( occupied & (1ULL << square) )
+			{
+				_position.aSquare[square] = (aPiece[nPieces/2] >> (4*(nPieces%2))) & 15;
+				++nPieces;
+			}
+		}
+		_position.sideToMove = (flags & 1) ? WHITE : BLACK;
+		_position.castling = flags >> 1;
+		_position.enPassant = enPassant;
+		_position.halfmoveClock = halfmoveClock;
+		_position.hash = _position.computeHash();
+		_position.pawnHash = _position.computePawnHash();
+		_position.materialKey = _position.computeMaterialKey();
+	}
+};
+static_assert(sizeof(PackedPosition) == 32, "PackedPosition must be 32 bytes");
+
+// the positions of one game, waiting for its result
+struct TrainingGame
+{
+	PackedPosition aPosition [MATCH_MAX_PLIES];
+	int nPositions;
+};
+
+// play self-play games on _nThreads threads until _nPositions positions have
+// been appended to _path. _player must search. _nThreads 0 uses every core.
+// Returns the number of positions written.
+inline unsigned long long generateTrainingData(const std::string& _path, const unsigned long long _nPositions,
+	const PlayerSpec& _player, int _nThreads=0, const uint64_t _seed=1)
+{
+	if ( _player.type != PLAYER_DEPTH && _player.type != PLAYER_ALPHABETA )
+	{
+		return 0;
+	}
+	if ( _nThreads <= 0 )
+	{
+		_nThreads = std::thread::hardware_concurrency();
+		if ( _nThreads <= 0 )
+		{
+			_nThreads = 1;
+		}
+	}
+
+	std::ofstream file(_path,std::ios::binary|std::ios::app);
+	if ( file.is_open() == false )
+	{
+		return 0;
+	}
+	std::mutex fileMutex;
+	std::atomic <unsigned long long> nWritten(0);
+	std::atomic <unsigned long long> nextGame(0);
+	std::atomic <bool> done(false);
+	const Random games(_seed,2);
+	const long long start = searchClock();
+
+	auto worker = [&]()
+	{
+		std::vector <PackedPosition> vChunk;
+		vChunk.reserve(TRAINING_CHUNK+MATCH_MAX_PLIES);
+		TrainingGame* game = new TrainingGame;
+
+		// append the chunk, keeping no more than the positions still wanted
+		auto flush = [&]()
+		{
+			std::lock_guard <std::mutex> lock(fileMutex);
+			const unsigned long long before = nWritten;
+			const unsigned long long wanted = _nPositions-before;
+			const size_t count = vChunk.size() < wanted ? vChunk.size() : (size_t)wanted;
+			file.write((const char*)vChunk.data(),count*sizeof(PackedPosition));
+			const unsigned long long after = before+count;
+			nWritten = after;
+			if ( after/TRAINING_REPORT_EVERY != before/TRAINING_REPORT_EVERY || after == _nPositions )
+			{
+				const double seconds = (searchClock()-start)/1000000.0;
+				std::cout<<after<<" positions, "<<(unsigned long long)(after/(seconds > 0 ? seconds : 1))<<
+					" per second\n";
+			}
+			if ( after >= _nPositions )
+			{
+				done = true;
+			}
+			vChunk.clear();
+		};
+
+		while ( done == false )
+		{
+			Random random = games.split(nextGame.fetch_add(1));
+			GameHistory history;
+			history.clear();
+			MatchPlayer player(_player,&history);
+			Position position;
+			position.reset();
+			game->nPositions = 0;
+
+			int outcome = GAME_UNFINISHED;
+			for (int ply=0;done == false;++ply)
+			{
+				outcome = adjudicate(position,history);
+				if ( outcome != GAME_UNFINISHED )
+				{
+					break;
+				}
+				if ( ply >= MATCH_MAX_PLIES )
+				{
+					outcome = GAME_DRAW;
+					break;
+				}
+
+				Move move;
+				if ( ply < TRAINING_RANDOM_PLIES )
+				{
+					MoveList moves;
+					position.generateLegalMoves(moves);
+					move = moves(random.rand(moves.size()-1));
+				}
+				else
+				{
+					move = player.choose(position,random);
+					const bool quiet = position.isCheck(position.sideToMove) == false &&
+						position.aSquare[move.to()] == 0 && move.type() != MOVE_EN_PASSANT &&
+						move.type() != MOVE_PROMOTION;
+					if ( quiet && player.lastScore <= TRAINING_MAX_SCORE && player.lastScore >= -TRAINING_MAX_SCORE )
+					{
+						game->aPosition[game->nPositions++].pack(position,player.lastScore,0,ply);
+					}
+				}
+				history.push(position.hash);
+				position.makeMove(move);
+			}
+			if ( done )
+			{
+				break;
+			}
+
+			// the result for the side to move in each position
+			for (int i=0;i<game->nPositions;++i)
+			{
+				PackedPosition& packed = game->aPosition[i];
+				const bool whiteToMove = (packed.flags & 1) != 0;
+				packed.result = outcome == GAME_DRAW ? 0 : (((outcome == GAME_WHITE_WINS) == whiteToMove) ? 1 : -1);
+				vChunk.push_back(packed);
+			}
+			// near the end a thread may already have enough
+			if ( vChunk.size() >= TRAINING_CHUNK || vChunk.size() >= _nPositions-nWritten )
+			{
+				flush();
+			}
+		}
+		delete game;
+	};
+
+	std::vector <std::thread> vThread;
+	for (int i=0;i<_nThreads;++i)
+	{
+		vThread.emplace_back(worker);
+	}
+	for (auto& thread : vThread)
+	{
+		thread.join();
+	}
+	return nWritten;
+}
@@ -0,0 +1,146 @@
+#include <atomic>
+
+// Transposition table for Search.
+// Stores the result of searching each position: the best move, the score,
+// the depth it was searched to and whether the score is exact or only a
+// bound. Iterative deepening searches the same positions again one ply
+// deeper, and the stored best move is tried first, which gives most of the
+// alpha-beta cutoffs.
+// Like EvalCache the table is shared between threads without locks. Each
+// entry is two 64 bit words, the data and the key xored with the data. An
+// entry torn by two threads writing at once fails the key check.
+
+	// default size in megabytes
+#define TT_DEFAULT_MB 16
+
+	// bound types
+#define TT_EXACT 0
+#define TT_LOWER 1 // the score is at least this
+#define TT_UPPER 2 // the score is at most this
+
+	// scores beyond this are mates, which are stored relative to the position
+	// rather than the root
+#define SCORE_MATE_BOUND (SCORE_CHECKMATE/2)
+
+struct TTEntry
+{
+	Move move;
+	int score;
+	int depth;
+	int bound;
+};
+
+class TranspositionTable
+{
+	struct Slot
+	{
+		std::atomic <unsigned long long> check;
+		std::atomic <unsigned long long> data;
+	};
+	Slot* aSlot;
+	unsigned long long mask;
+
+	public:
+	TranspositionTable(const int _megabytes = TT_DEFAULT_MB)
+	{
+		aSlot=0;
+		resize(_megabytes);
+	}
+	~TranspositionTable()
+	{
+		delete [] aSlot;
+	}
+
+	// resize the table, rounding down to a power of 2 entries. This clears it,
+	// and must not be called while a search is using it.
+	void resize(const int _megabytes)
+	{
+		const unsigned long long nSlots = (unsigned long long)(_megabytes > 0 ? _megabytes : 1)*1024*1024/sizeof(Slot);
+		unsigned long long size = 1;
+		while ( size*2 <= nSlots )
+		{
+			size*=2;
+		}
+
+		delete [] aSlot;
+		aSlot = new Slot [size];
+		mask = size-1;
+		clear();
+	}
+
+	void clear()
+	{
+		for (unsigned long long i=0;i<=mask;++i)
+		{
+			aSlot[i].check.store(0,std::memory_order_relaxed);
+			aSlot[i].data.store(0,std::memory_order_relaxed);
+		}
+	}
+
+	// look up a position. _ply is its distance from the root, for mate scores.
+	bool probe(const unsigned long long _hash, const int _ply, TTEntry& _entry) const
+	{
+		const Slot& slot = aSlot[_hash & mask];
+		const unsigned long long data = slot.data.load(std::memory_order_relaxed);
+		if ( (slot.check.load(std::memory_order_relaxed) ^ data) != _hash || data == 0 )
+		{
+			return false;
+		}
+		_entry = unpack(data);
+		if ( _entry.score > SCORE_MATE_BOUND )
+		{
+			_entry.score -= _ply;
+		}
+		else if ( _entry.score < -SCORE_MATE_BOUND )
+		{
+			_entry.score += _ply;
+		}
+		return true;
+	}
+
+	// store a result. A different position always replaces the slot, the
+	// same position only if it was searched at least as deep.
+	void store(const unsigned long long _hash, const int _ply, const Move _move, int _score,
+		const int _depth, const int _bound)
+	{
+		Slot& slot = aSlot[_hash & mask];
+		const unsigned long long oldData = slot.data.load(std::memory_order_relaxed);
+		if ( (slot.check.load(std::memory_order_relaxed) ^ oldData) == _hash && unpack(oldData).depth > _depth )
+		{
+			return;
+		}
+
+		if ( _score > SCORE_MATE_BOUND )
+		{
+			_score += _ply;
+		}
+		else if ( _score < -SCORE_MATE_BOUND )
+		{
+			_score -= _ply;
+		}
+		// depth is stored plus one so an entry is never all zero
+		const unsigned long long data = (unsigned long long)_move.getData() |
+			((unsigned long long)(unsigned short)(short)_score << 16) |
+			((unsigned long long)(unsigned char)(_depth+1) << 32) |
+			((unsigned long long)_bound << 40);
+		slot.data.store(data,std::memory_order_relaxed);
+		slot.check.store(_hash ^ data,std::memory_order_relaxed);
+	}
+
+	// the size in megabytes
+	int megabytes() const
+	{
+		return (int)((mask+1)*sizeof(Slot)/(1024*1024));
+	}
+
+	private:
+	static TTEntry unpack(const unsigned long long _data)
+	{
+		TTEntry entry;
+		entry.move = Move(_data & 63,(_data >> 6) & 63,(_data >> 12) & 15);
+		entry.score = (short)(_data >> 16);
+		entry.depth = (int)((_data >> 32) & 255)-1;
+		entry.bound = (_data >> 40) & 3;
+		return entry;
+	}
+};
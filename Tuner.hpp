@@ -0,0 +1,398 @@
+#include <cmath>
+#include <fstream>
+
+// Tuning the handcrafted evaluation weights on positions with known results.
+// Each position is evaluated once with an EvalTrace, which leaves a count for
+// each term. The evaluation is close to the sum of each count multiplied by
+// its weight, so the tuner can score every position with new weights without
+// evaluating it again. The weights are fitted so that a sigmoid of the score
+// predicts the game results, by full batch gradient descent with Adam.
+// The counts are kept as one dense row of shorts per position, and each
+// thread sums the gradient over its own part of the rows.
+
+	// counts per row, N_TERMS rounded up so rows are evenly aligned
+#define TUNER_STRIDE 24
+	// lines read from the file and traced at a time
+#define TUNER_READ_CHUNK 65536
+#define TUNER_LEARNING_RATE 0.05
+#define TUNER_REPORT_EVERY 100
+
+static_assert(N_TERMS <= TUNER_STRIDE, "TUNER_STRIDE must hold every term");
+
+class Tuner
+{
+	int nThreads;
+
+	// TUNER_STRIDE counts for each position, and the result from white's
+	// point of view: 1 for a win, 0.5 for a draw and 0 for a loss
+	std::vector <short> vCoefficient;
+	std::vector <float> vResult;
+
+	// the weights as written in the defines, and what one unit of each
+	// weight is worth in pawns
+	double weight [TUNER_STRIDE];
+	double defaultWeight [TUNER_STRIDE];
+	double unit [TUNER_STRIDE];
+
+	// how sharply the score converts to an expected result
+	double k;
+
+	public:
+	Tuner(int _nThreads=0)
+	{
+		nThreads = _nThreads;
+		if ( nThreads <= 0 )
+		{
+			nThreads = std::thread::hardware_concurrency();
+			if ( nThreads <= 0 )
+			{
+				nThreads = 1;
+			}
+		}
+		k = 1;
+
+		for (int i=0;i<TUNER_STRIDE;++i)
+		{
+			defaultWeight[i] = 0;
+			unit[i] = 0;
+		}
+		for (int type=PAWN;type<KING;++type)
+		{
+			setDefault(TERM_PAWN+type-PAWN,PIECE_VALUE[type],1);
+		}
+		// imbalance and positional terms are in tenths, and the phase scaled
+		// terms are also divided by the maximum phase
+		const double tenth = 1.0/POSITIONAL_DIVISOR;
+		const double phased = tenth/MATERIAL_PHASE_MAX;
+		setDefault(TERM_BISHOP_PAIR,MATERIAL_BISHOP_PAIR,tenth);
+		setDefault(TERM_KNIGHT_PAWNS,MATERIAL_KNIGHT_PAWN,tenth/MATERIAL_IMBALANCE_DIVISOR);
+		setDefault(TERM_ROOK_PAWNS,MATERIAL_ROOK_PAWN,tenth/MATERIAL_IMBALANCE_DIVISOR);
+		setDefault(TERM_MOBILITY,1,tenth);
+		setDefault(TERM_KING_ZONE,KING_ZONE_ATTACK,phased);
+		setDefault(TERM_SPACE,SPACE_WEIGHT,phased);
+		setDefault(TERM_HANGING,HANGING_SHARE,tenth);
+
+		const double pawnTenth = 1.0/PAWN_STRUCTURE_DIVISOR;
+		setDefault(TERM_DOUBLED,-PAWN_DOUBLED,pawnTenth);
+		setDefault(TERM_ISOLATED,-PAWN_ISOLATED,pawnTenth);
+		setDefault(TERM_BACKWARD,-PAWN_BACKWARD,pawnTenth);
+		for (int rank=1;rank<7;++rank)
+		{
+			setDefault(TERM_PASSED_RANK_2+rank-1,PawnMasks::PASSED_BONUS[rank],pawnTenth);
+		}
+		setDefault(TERM_SHIELD_NEAR,PAWN_SHIELD_NEAR,pawnTenth);
+		setDefault(TERM_SHIELD_FAR,PAWN_SHIELD_FAR,pawnTenth);
+
+		for (int i=0;i<TUNER_STRIDE;++i)
+		{
+			weight[i] = defaultWeight[i];
+		}
+	}
+
+	size_t size() const
+	{
+		return vResult.size();
+	}
+
+	// read a file with a FEN and a result on each line. Positions the
+	// evaluation doesn't score with its weights are skipped: the side to move
+	// in check, known endgames and material which scales the score down.
+	// Returns the number of positions added.
+	size_t load(const std::string& _path)
+	{
+		std::ifstream file(_path);
+		if ( !file )
+		{
+			return 0;
+		}
+		const size_t nStart = size();
+
+		std::vector <std::string> vLine;
+		std::vector <short> vChunkCoefficient;
+		std::vector <float> vChunkResult;
+		std::vector <char> vKeep;
+		std::string line;
+
+		while (true)
+		{
+			vLine.clear();
+			while ( vLine.size() < TUNER_READ_CHUNK && std::getline(file,line) )
+			{
+				vLine.push_back(line);
+			}
+			if ( vLine.empty() )
+			{
+				break;
+			}
+			const size_t nLines = vLine.size();
+			vChunkCoefficient.assign(nLines*TUNER_STRIDE,0);
+			vChunkResult.assign(nLines,0);
+			vKeep.assign(nLines,0);
+
+			forEachSlice(nLines,[&](const int, const size_t _start, const size_t _end)
+			{
+				for (size_t i=_start;i<_end;++i)
+				{
+					Position position;
+					vKeep[i] = parseLine(vLine[i],position,vChunkResult[i]) &&
+						trace(position,&vChunkCoefficient[i*TUNER_STRIDE]);
+				}
+			});
+
+			// keep the positions in file order
+			for (size_t i=0;i<nLines;++i)
+			{
+				if ( vKeep[i] )
+				{
+					vCoefficient.insert(vCoefficient.end(),vChunkCoefficient.begin()+i*TUNER_STRIDE,
+						vChunkCoefficient.begin()+(i+1)*TUNER_STRIDE);
+					vResult.push_back(vChunkResult[i]);
+				}
+			}
+		}
+		return size()-nStart;
+	}
+
+	// mean squared error of the predicted results
+	double error(const double _k) const
+	{
+		float effective [TUNER_STRIDE];
+		getEffective(effective);
+
+		std::vector <double> vSum(nThreads,0);
+		forEachSlice(size(),[&](const int _thread, const size_t _start, const size_t _end)
+		{
+			double sum = 0;
+			for (size_t i=_start;i<_end;++i)
+			{
+				const double difference = vResult[i]-sigmoid(_k,score(i,effective));
+				sum += difference*difference;
+			}
+			vSum[_thread] = sum;
+		});
+
+		double total = 0;
+		for (double sum : vSum)
+		{
+			total += sum;
+		}
+		return size() > 0 ? total/size() : 0;
+	}
+	double error() const
+	{
+		return error(k);
+	}
+
+	// find the k which best fits the current weights, searching in smaller
+	// steps around the best found so far. The weights are then tuned with k
+	// fixed.
+	double fitK()
+	{
+		double best = error(k);
+		double step = 0.5;
+		for (int round=0;round<6;++round)
+		{
+			const double centre = k;
+			for (int i=-5;i<=5;++i)
+			{
+				const double candidate = centre+i*step;
+				if ( candidate <= 0 || i == 0 )
+				{
+					continue;
+				}
+				const double candidateError = error(candidate);
+				if ( candidateError < best )
+				{
+					best = candidateError;
+					k = candidate;
+				}
+			}
+			step /= 5;
+		}
+		return k;
+	}
+
+	// full batch gradient descent with Adam. Each weight is tuned in the
+	// units of its define.
+	void tune(const int _iterations, const double _learningRate=TUNER_LEARNING_RATE)
+	{
+		const double beta1 = 0.9;
+		const double beta2 = 0.999;
+		const double epsilon = 1e-8;
+		double momentum [TUNER_STRIDE] = {0};
+		double velocity [TUNER_STRIDE] = {0};
+
+		std::vector <double> vGradient(nThreads*TUNER_STRIDE);
+
+		for (int iteration=1;iteration<=_iterations;++iteration)
+		{
+			float effective [TUNER_STRIDE];
+			getEffective(effective);
+			std::fill(vGradient.begin(),vGradient.end(),0);
+
+			forEachSlice(size(),[&](const int _thread, const size_t _start, const size_t _end)
+			{
+				float gradient [TUNER_STRIDE] = {0};
+				for (size_t i=_start;i<_end;++i)
+				{
+					// derivative of the squared error by the score
+					const float predicted = sigmoid(k,score(i,effective));
+					const float slope = (predicted-vResult[i])*predicted*(1-predicted);
+					const short* row = &vCoefficient[i*TUNER_STRIDE];
+					for (int j=0;j<TUNER_STRIDE;++j)
+					{
+						gradient[j] += slope*row[j];
+					}
+				}
+				for (int j=0;j<TUNER_STRIDE;++j)
+				{
+					vGradient[_thread*TUNER_STRIDE+j] = gradient[j];
+				}
+			});
+
+			for (int j=0;j<N_TERMS;++j)
+			{
+				double gradient = 0;
+				for (int thread=0;thread<nThreads;++thread)
+				{
+					gradient += vGradient[thread*TUNER_STRIDE+j];
+				}
+				gradient *= 2*k*unit[j]/size();
+
+				momentum[j] = beta1*momentum[j] + (1-beta1)*gradient;
+				velocity[j] = beta2*velocity[j] + (1-beta2)*gradient*gradient;
+				const double correctedMomentum = momentum[j]/(1-std::pow(beta1,iteration));
+				const double correctedVelocity = velocity[j]/(1-std::pow(beta2,iteration));
+				weight[j] -= _learningRate*correctedMomentum/(std::sqrt(correctedVelocity)+epsilon);
+			}
+
+			if ( iteration % TUNER_REPORT_EVERY == 0 || iteration == _iterations )
+			{
+				std::cout<<"Iteration "<<iteration<<", error "<<error()<<"\n";
+			}
+		}
+	}
+
+	// the tuned weights next to the current ones. Penalties are negative.
+	void print() const
+	{
+		for (int i=0;i<N_TERMS;++i)
+		{
+			std::cout<<TERM_NAME[i]<<"\t"<<defaultWeight[i]<<"\t"<<weight[i]<<"\n";
+		}
+	}
+
+	private:
+	void setDefault(const int _term, const double _weight, const double _unit)
+	{
+		defaultWeight[_term] = _weight;
+		unit[_term] = _unit;
+	}
+
+	// what one count of each term is worth in pawns with the current weights
+	void getEffective(float* _effective) const
+	{
+		for (int i=0;i<TUNER_STRIDE;++i)
+		{
+			_effective[i] = weight[i]*unit[i];
+		}
+	}
+
+	float score(const size_t _index, const float* _effective) const
+	{
+		const short* row = &vCoefficient[_index*TUNER_STRIDE];
+		float score = 0;
+		for (int j=0;j<TUNER_STRIDE;++j)
+		{
+			score += row[j]*_effective[j];
+		}
+		return score;
+	}
+
+	static float sigmoid(const double _k, const float _score)
+	{
+		return 1/(1+std::exp(-_k*_score));
+	}
+
+	// run _function on an equal part of _n rows on each thread
+	template <class FUNCTION> void forEachSlice(const size_t _n, const FUNCTION& _function) const
+	{
+		if ( nThreads == 1 )
+		{
+			_function(0,0,_n);
+			return;
+		}
+		std::vector <std::thread> vThread;
+		for (int thread=0;thread<nThreads;++thread)
+		{
+			const size_t start = _n*thread/nThreads;
+			const size_t end = _n*(thread+1)/nThreads;
+			vThread.emplace_back(_function,thread,start,end);
+		}
+		for (auto& thread : vThread)
+		{
+			thread.join();
+		}
+	}
+
+	// the result is written as 1-0, 0-1 or 1/2-1/2, or as a number such as
+	// [0.5], after the FEN
+	static bool parseLine(const std::string& _line, Position& _position, float& _result)
+	{
+		size_t end;
+		if ( (end = _line.find("1/2-1/2")) != std::string::npos )
+		{
+			_result = 0.5;
+		}
+		else if ( (end = _line.find("1-0")) != std::string::npos )
+		{
+			_result = 1;
+		}
+		else if ( (end = _line.find("0-1")) != std::string::npos )
+		{
+			_result = 0;
+		}
+		else if ( (end = _line.find('[')) != std::string::npos )
+		{
+			_result = atof(_line.c_str()+end+1);
+		}
+		else
+		{
+			return false;
+		}
+		return _result >= 0 && _result <= 1 && _position.setFen(_line.substr(0,end));
+	}
+
+	// record the counts for a position, or return false if it shouldn't be
+	// used
+	static bool trace(Position& _position, short* _row)
+	{
+		if ( _position.findKing<WHITE>() == -1 || _position.findKing<BLACK>() == -1 ||
+			_position.isCheck(_position.sideToMove) )
+		{
+			return false;
+		}
+		int score;
+		if ( getEndgameScore<WHITE>(_position,score) )
+		{
+			return false;
+		}
+		const MaterialEntry material = materialTable.probe(_position.materialKey);
+		if ( material.scale[WHITE] != MATERIAL_SCALE_NORMAL || material.scale[BLACK] != MATERIAL_SCALE_NORMAL ||
+			(material.flags & MATERIAL_SINGLE_BISHOPS) )
+		{
+			return false;
+		}
+
+		EvalTrace trace;
+		trace.clear();
+		AttackMap attacks;
+		attacks.clear();
+		getHandcraftedScore<WHITE>(_position,attacks,&trace);
+		for (int i=0;i<N_TERMS;++i)
+		{
+			_row[i] = trace.coefficient[i];
+		}
+		return true;
+	}
+};
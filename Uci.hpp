@@ -0,0 +1,312 @@
+#include <mutex>
+#include <sstream>
+
+// Universal Chess Interface front end, so the engine can be run by chess GUIs
+// and match runners. Commands are read from std::cin on the calling thread
+// while a SearchJob runs in the background, so stop, ponderhit and isready
+// are answered during a search. The search checks the stop flag at every
+// node, so bestmove follows a stop almost at once.
+
+#define UCI_NAME "BigThink"
+#define UCI_AUTHOR "Ryan Babij"
+#define UCI_MAX_THREADS 64
+#define UCI_MAX_HASH_MB 65536
+	// milliseconds kept back for communication when on a clock
+#define UCI_MOVE_OVERHEAD 20
+	// moves the remaining time is shared between when the GUI doesn't say
+#define UCI_MOVES_TO_GO 30
+	// the longest principal variation printed
+#define UCI_MAX_PV 32
+
+class Uci
+{
+	Position position;
+	// positions before the current one, for finding repetitions
+	GameHistory history;
+
+	SearchJob job;
+	int nThreads;
+	int multiPv;
+	std::mutex outputMutex;
+
+	// time allowed for a move being pondered, in milliseconds. The clock
+	// starts at ponderhit.
+	long long ponderBudget;
+
+	public:
+	Uci()
+	{
+		position.reset();
+		history.clear();
+		nThreads=1;
+		multiPv=1;
+		ponderBudget=0;
+	}
+
+	// read commands until quit or the end of the input
+	int run()
+	{
+		std::string line;
+		while (std::getline(std::cin,line))
+		{
+			std::istringstream tokens(line);
+			std::string command;
+			tokens>>command;
+
+			if ( command == "uci" )
+			{
+				send("id name " UCI_NAME);
+				send("id author " UCI_AUTHOR);
+				send("option name Hash type spin default "+std::to_string(TT_DEFAULT_MB)+" min 1 max "+
+					std::to_string(UCI_MAX_HASH_MB));
+				send("option name Threads type spin default 1 min 1 max "+std::to_string(UCI_MAX_THREADS));
+				send("option name Ponder type check default false");
+				send("option name MultiPV type spin default 1 min 1 max "+std::to_string(SEARCH_MAX_LINES));
+				send("uciok");
+			}
+			else if ( command == "isready" )
+			{
+				send("readyok");
+			}
+			else if ( command == "setoption" )
+			{
+				stopSearch();
+				setOption(tokens);
+			}
+			else if ( command == "ucinewgame" )
+			{
+				stopSearch();
+				transpositionTable.clear();
+				evalCache.clear();
+			}
+			else if ( command == "position" )
+			{
+				stopSearch();
+				setPosition(tokens);
+			}
+			else if ( command == "go" )
+			{
+				stopSearch();
+				go(tokens);
+			}
+			else if ( command == "stop" )
+			{
+				stopSearch();
+			}
+			else if ( command == "ponderhit" )
+			{
+				ponderHit();
+			}
+			else if ( command == "quit" )
+			{
+				break;
+			}
+		}
+		stopSearch();
+		return 0;
+	}
+
+	private:
+	void send(const std::string& _line)
+	{
+		std::lock_guard <std::mutex> lock(outputMutex);
+		std::cout<<_line<<std::endl;
+	}
+
+	// setoption name <name> value <value>
+	void setOption(std::istringstream& _tokens)
+	{
+		std::string word, name, value;
+		_tokens>>word>>name>>word>>value;
+
+		if ( name == "Hash" )
+		{
+			const int megabytes = atoi(value.c_str());
+			transpositionTable.resize(megabytes < 1 ? 1 : (megabytes > UCI_MAX_HASH_MB ? UCI_MAX_HASH_MB : megabytes));
+		}
+		else if ( name == "MultiPV" )
+		{
+			const int lines = atoi(value.c_str());
+			multiPv = lines < 1 ? 1 : (lines > SEARCH_MAX_LINES ? SEARCH_MAX_LINES : lines);
+		}
+		else if ( name == "Threads" )
+		{
+			const int threads = atoi(value.c_str());
+			nThreads = threads < 1 ? 1 : (threads > UCI_MAX_THREADS ? UCI_MAX_THREADS : threads);
+		}
+	}
+
+	// position [startpos | fen <fen>] [moves <move>...]
+	void setPosition(std::istringstream& _tokens)
+	{
+		std::string word;
+		_tokens>>word;
+		if ( word == "fen" )
+		{
+			std::string fen;
+			while ( _tokens>>word && word != "moves" )
+			{
+				fen += word+" ";
+			}
+			if ( position.setFen(fen) == false )
+			{
+				send("info string invalid fen "+fen);
+				position.reset();
+			}
+		}
+		else
+		{
+			position.reset();
+			_tokens>>word;
+		}
+		history.clear();
+
+		if ( word != "moves" )
+		{
+			return;
+		}
+		while ( _tokens>>word )
+		{
+			const Move move = parseMove(word);
+			if ( move.isNull() )
+			{
+				send("info string illegal move "+word);
+				return;
+			}
+			history.push(position.hash);
+			position.makeMove(move);
+		}
+	}
+
+	// a move in coordinate notation. Any promotion is to a queen.
+	Move parseMove(const std::string& _text)
+	{
+		if ( _text.size() < 4 || Tables::onBoard(_text[0]-'a',_text[1]-'1') == false ||
+			Tables::onBoard(_text[2]-'a',_text[3]-'1') == false )
+		{
+			return Move();
+		}
+		return position.findMove(toSquare(_text[0]-'a',_text[1]-'1'),toSquare(_text[2]-'a',_text[3]-'1'));
+	}
+
+	// go [wtime w] [btime b] [winc w] [binc b] [movestogo n] [movetime t]
+	// [depth d] [nodes n] [infinite] [ponder]
+	void go(std::istringstream& _tokens)
+	{
+		long long time[2] = {0,0};
+		long long increment[2] = {0,0};
+		long long moveTime = 0;
+		int movesToGo = UCI_MOVES_TO_GO;
+		bool ponder = false;
+		SearchLimits limits;
+
+		std::string word;
+		while ( _tokens>>word )
+		{
+			if ( word == "wtime" ) { _tokens>>time[WHITE]; }
+			else if ( word == "btime" ) { _tokens>>time[BLACK]; }
+			else if ( word == "winc" ) { _tokens>>increment[WHITE]; }
+			else if ( word == "binc" ) { _tokens>>increment[BLACK]; }
+			else if ( word == "movestogo" ) { _tokens>>movesToGo; }
+			else if ( word == "movetime" ) { _tokens>>moveTime; }
+			else if ( word == "depth" ) { _tokens>>limits.depth; }
+			else if ( word == "nodes" ) { _tokens>>limits.nodes; }
+			else if ( word == "infinite" ) { limits.infinite = true; }
+			else if ( word == "ponder" ) { ponder = true; }
+		}
+
+		// budget in milliseconds, 0 for no time limit
+		long long budget = 0;
+		if ( moveTime > 0 )
+		{
+			budget = moveTime-UCI_MOVE_OVERHEAD;
+		}
+		else if ( time[position.sideToMove] > 0 )
+		{
+			const long long remaining = time[position.sideToMove];
+			budget = remaining/(movesToGo > 0 ? movesToGo : 1) + increment[position.sideToMove]*3/4;
+			if ( budget > remaining-UCI_MOVE_OVERHEAD )
+			{
+				budget = remaining-UCI_MOVE_OVERHEAD;
+			}
+		}
+		if ( (moveTime > 0 || time[position.sideToMove] > 0) && budget < 1 )
+		{
+			budget = 1;
+		}
+
+		// a pondering search has no time limit until ponderhit, and bestmove
+		// can't be sent until the GUI says which move was played
+		ponderBudget = budget;
+		if ( ponder )
+		{
+			limits.infinite = true;
+		}
+		else if ( limits.infinite == false )
+		{
+			limits.time = budget;
+		}
+
+		limits.lines = multiPv;
+
+		job.start(position,limits,&history,nThreads,[this](const SearchInfo& _info)
+		{
+			for (int line=0;line<_info.nLines;++line)
+			{
+				const SearchLine& searchLine = _info.aLine[line];
+				std::string info = "info depth "+std::to_string(_info.depth)+" multipv "+std::to_string(line+1)+
+					" score "+scoreText(searchLine.score)+" nodes "+std::to_string(_info.nNodes)+
+					" nps "+std::to_string(_info.nodesPerSecond)+" time "+std::to_string(_info.elapsed/1000)+" pv";
+				for (int i=0;i<searchLine.nPv;++i)
+				{
+					info += " "+searchLine.aPv[i].toString();
+				}
+				send(info);
+			}
+		},
+		[this](const SearchInfo& _info)
+		{
+			if ( _info.bestMove.isNull() )
+			{
+				send("bestmove 0000");
+				return;
+			}
+			const SearchLine& best = _info.aLine[0];
+			send("bestmove "+_info.bestMove.toString()+(_info.nLines > 0 && best.nPv >= 2 ? " ponder "+best.aPv[1].toString() : ""));
+		});
+	}
+
+	// the move being pondered was played, so start the clock if there is
+	// one. Without a clock the search goes on to its depth or node limit.
+	void ponderHit()
+	{
+		if ( ponderBudget > 0 )
+		{
+			job.release(ponderBudget);
+		}
+		else
+		{
+			job.release();
+		}
+	}
+
+	void stopSearch()
+	{
+		job.cancel();
+		job.wait();
+	}
+
+	// centipawns, or moves to mate
+	static std::string scoreText(const int _score)
+	{
+		if ( _score > SCORE_MATE_BOUND )
+		{
+			return "mate "+std::to_string((SCORE_CHECKMATE-_score+1)/2);
+		}
+		if ( _score < -SCORE_MATE_BOUND )
+		{
+			return "mate -"+std::to_string((SCORE_CHECKMATE+_score)/2);
+		}
+		return "cp "+std::to_string(_score*100);
+	}
+};
@@ -0,0 +1,65 @@
+// Zobrist keys for hashing positions.
+// The keys are generated at compile time with splitmix64 from a fixed seed,
+// so hashes are the same on every run and there is no startup cost.
+
+namespace Zobrist
+{
+	struct Keys
+	{
+		// indexed by piece (see pieceIndex) then square
+		unsigned long long piece [12][64];
+		// one key per castling right bit (see CASTLE_WHITE_KINGSIDE etc.)
+		unsigned long long castling [4];
+		// file of a pawn which can be captured en passant
+		unsigned long long enPassant [8];
+		unsigned long long blackToMove;
+	};
+
+	constexpr unsigned long long splitMix(unsigned long long& _state)
+	{
+		_state += 0x9E3779B97F4A7C15ULL;
+		unsigned long long z = _state;
+		z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+		z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+		return z ^ (z >> 31);
+	}
+
+	constexpr Keys buildKeys()
+	{
+		Keys k {};
+		unsigned long long state = 0x42696754ULL;
+		for (int i=0;i<12;++i)
+		{
+			for (int square=0;square<64;++square)
+			{
+				k.piece[i][square] = splitMix(state);
+			}
+		}
+		for (int i=0;i<4;++i)
+		{
+			k.castling[i] = splitMix(state);
+		}
+		for (int i=0;i<8;++i)
+		{
+			k.enPassant[i] = splitMix(state);
+		}
+		k.blackToMove = splitMix(state);
+		return k;
+	}
+
+	constexpr Keys KEYS = buildKeys();
+
+	// combined key for a set of castling rights
+	constexpr unsigned long long castlingKey(const unsigned char _rights)
+	{
+		unsigned long long key = 0;
+		for (int i=0;i<4;++i)
+		{
+			if ( _rights & (1 << i) )
+			{
+				key ^= KEYS.castling[i];
+			}
+		}
+		return key;
+	}
+}